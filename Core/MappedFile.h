@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// No D3D on this file, it only uses the OS file mapping
+
+namespace FrameDX12
+{
+	// Read only mapping of a whole file
+	// The pages are loaded by the OS on first access, so nothing is read until the data is used, and there's no copy to a user buffer
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+		MappedFile(const MappedFile&) = delete;
+		~MappedFile();
+
+		// Returns false if the file can't be opened or mapped. Empty files open fine, with a null data pointer
+		bool Open(const std::string& path);
+		void Close();
+
+		bool IsOpen() const { return mIsOpen; }
+		const char* GetData() const { return mData; }
+		size_t GetSize() const { return mSize; }
+	private:
+		const char* mData = nullptr;
+		size_t mSize = 0;
+		bool mIsOpen = false;
+#ifdef _WIN32
+		void* mFile = nullptr;
+		void* mMapping = nullptr;
+#endif
+	};
+}
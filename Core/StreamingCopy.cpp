@@ -0,0 +1,99 @@
+#include "StreamingCopy.h"
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX_FUNCTION
+#else
+#define AVX_FUNCTION __attribute__((target("avx")))
+#endif
+
+using namespace FrameDX12;
+
+namespace
+{
+	constexpr size_t kLineSize = 64;
+
+	// Under this the setup isn't worth it, and a small memcpy writes whole lines anyway
+	constexpr size_t kMinStreamingSize = 256;
+
+	bool HasAVX()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6; // OSXSAVE, and XMM and YMM state enabled
+		return os_saves_ymm && (info[2] & (1 << 28));
+#else
+		return __builtin_cpu_supports("avx");
+#endif
+	}
+	const bool sHasAVX = HasAVX();
+
+	void StreamLinesSSE2(uint8_t* destination, const uint8_t* source, size_t lines)
+	{
+		for (size_t idx = 0; idx < lines; idx++, destination += kLineSize, source += kLineSize)
+		{
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 16));
+			__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 32));
+			__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 48));
+			_mm_stream_si128(reinterpret_cast<__m128i*>(destination), a);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(destination + 16), b);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(destination + 32), c);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(destination + 48), d);
+		}
+	}
+
+	AVX_FUNCTION void StreamLinesAVX(uint8_t* destination, const uint8_t* source, size_t lines)
+	{
+		for (size_t idx = 0; idx < lines; idx++, destination += kLineSize, source += kLineSize)
+		{
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source));
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + 32));
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(destination), a);
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(destination + 32), b);
+		}
+		_mm256_zeroupper();
+	}
+}
+
+void FrameDX12::StreamingCopyNoFence(void* destination, const void* source, size_t size_in_bytes)
+{
+	auto dst = static_cast<uint8_t*>(destination);
+	auto src = static_cast<const uint8_t*>(source);
+
+	if (size_in_bytes < kMinStreamingSize)
+	{
+		memcpy(dst, src, size_in_bytes);
+		return;
+	}
+
+	// Head up to the first line boundary of the destination
+	size_t head = (kLineSize - reinterpret_cast<uintptr_t>(dst) % kLineSize) % kLineSize;
+	memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	size_in_bytes -= head;
+
+	size_t lines = size_in_bytes / kLineSize;
+	if (sHasAVX)
+		StreamLinesAVX(dst, src, lines);
+	else
+		StreamLinesSSE2(dst, src, lines);
+
+	size_t body = lines * kLineSize;
+	memcpy(dst + body, src + body, size_in_bytes - body);
+}
+
+void FrameDX12::StreamingFence()
+{
+	_mm_sfence();
+}
+
+void FrameDX12::StreamingCopy(void* destination, const void* source, size_t size_in_bytes)
+{
+	StreamingCopyNoFence(destination, source, size_in_bytes);
+	StreamingFence();
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+
+// No D3D on this file, it's only CPU code
+
+namespace FrameDX12
+{
+	// Copies to write combined memory, like mapped upload heaps, using non temporal stores
+	// memcpy can end up doing partial line writes or reading the destination, and both are really slow on write combined memory
+	// This writes whole 64 byte lines with streaming stores (AVX if the CPU has it, SSE2 if not), the unaligned head and tail with
+	//  plain stores, and ends with a store fence so the data is visible before the GPU work that reads it is submitted
+	// Never read the destination, it's not in the cache after this
+	// Not worth it for small copies like single constants, where the fence costs more than the copy (see StreamingCopyBenchmark)
+	void StreamingCopy(void* destination, const void* source, size_t size_in_bytes);
+
+	// Same, but for several copies in a row, with a single fence at the end. Call StreamingFence after the last one
+	void StreamingCopyNoFence(void* destination, const void* source, size_t size_in_bytes);
+	void StreamingFence();
+}
@@ -24,11 +24,15 @@
 #include <concurrent_vector.h>
 #include <future>
 #include <unordered_map>
+#include <deque>
 #include <algorithm>
 #include <execution>
 #include "enumerate.h"
 #include "zip.h"
 #include <mutex>
+#include <condition_variable>
+#include <span>
+#include <array>
 #include "pix3.h"
 
 template<typename T>
@@ -4,6 +4,8 @@
 
 using namespace FrameDX12;
 
+thread_local uint64_t CommandGraph::sRecordingEpoch = 0;
+
 /*void CommandNode::Execute(Device* DevicePtr)
 {
 	// Fetch the command list
@@ -58,15 +60,18 @@ void CommandGraph::InternalNode::Execute(CommandGraph* graph)
 */
 
 CommandGraph::CommandGraph(size_t num_workers, QueueType type, Device* device_ptr) :
+	mDevice(device_ptr),
 	mType(type),
 	mWorkerFinishedEvents(num_workers),
 	mStartWorkEvents(num_workers),
 	mCloseWorkers(false),
-	mCommandLists(num_workers)
+	mCommandLists(num_workers),
+	mStateTrackers(num_workers),
+	mFixupCommandLists(num_workers)
 {
 	//mStartWorkEvent = CreateEvent(NULL,FALSE,FALSE,NULL);
 
-	mRawCommandLists = new ID3D12CommandList * [num_workers];
+	mRawCommandLists = new ID3D12CommandList * [num_workers * 2];
 	for (size_t worker_id = 0; worker_id < num_workers; worker_id++)
 	{
 		// Create the allocator
@@ -86,7 +91,21 @@ CommandGraph::CommandGraph(size_t num_workers, QueueType type, Device* device_pt
 			nullptr, // TODO : Do something with this!
 			IID_PPV_ARGS(cl.GetAddressOf())), LogCategory::Error);
 		cl->Close();
-		mRawCommandLists[worker_id] = cl.Get();
+
+		// Same for the fix-up list
+		auto& fixup_alloc = mFixupAllocators.emplace_back([&](uint8_t)
+		{
+			Microsoft::WRL::ComPtr<ID3D12CommandAllocator> new_alloc;
+			LogCheck(device_ptr->GetDevice()->CreateCommandAllocator((D3D12_COMMAND_LIST_TYPE)type, IID_PPV_ARGS(new_alloc.GetAddressOf())), LogCategory::Error);
+			return new_alloc;
+		});
+		LogCheck(device_ptr->GetDevice()->CreateCommandList(
+			0,
+			(D3D12_COMMAND_LIST_TYPE)type,
+			(*fixup_alloc).Get(),
+			nullptr,
+			IID_PPV_ARGS(mFixupCommandLists[worker_id].GetAddressOf())), LogCategory::Error);
+		mFixupCommandLists[worker_id]->Close();
 
 		mWorkerFinishedEvents[worker_id] = CreateEvent(NULL, FALSE, FALSE, NULL);
 		mStartWorkEvents[worker_id] = CreateEvent(NULL, FALSE, FALSE, NULL);
@@ -100,6 +119,10 @@ CommandGraph::CommandGraph(size_t num_workers, QueueType type, Device* device_pt
 				if (mCloseWorkers)
 					break;
 
+				// The list was reset before starting the work
+				NotifyCommandListReset();
+				ResourceStateTracker::SetCurrent(mCommandLists[worker_id].Get(), &mStateTrackers[worker_id]);
+
 				Node* current_node = nullptr;
 				while (true)
 				{
@@ -226,7 +249,6 @@ uint64_t CommandGraph::Execute(Device* device, ID3D12PipelineState* initial_stat
 
 	// TODO : Support nodes with dependencies from different queues, for now they need to be on the same queue
 	//		  Having different queues means you are forced to do a ExecuteCommandLists and put a fence
-	ID3D12CommandQueue * queue = device->GetQueue(mType);
 
 	for (size_t i = 0; i < mNodesCount; ++i) mNodes[i].num_ready_dependencies = 0;
 
@@ -238,7 +260,10 @@ uint64_t CommandGraph::Execute(Device* device, ID3D12PipelineState* initial_stat
 	}
 
 	for (size_t i = 0;i < mCommandLists.size();++i)
+	{
 		mCommandAllocators[i]->Reset();
+		mFixupAllocators[i]->Reset();
+	}
 
 	while (mWorkQueueSize > 0)
 	{
@@ -252,11 +277,39 @@ uint64_t CommandGraph::Execute(Device* device, ID3D12PipelineState* initial_stat
 		
 		WaitForMultipleObjects(mWorkerFinishedEvents.size(), mWorkerFinishedEvents.data(), true, INFINITE);
 
+		// The tables requested while recording need to be on the shader visible heap before the GPU reads them
+		device->FlushDescriptorCopies();
+
+		// The evicted resources used by the lists need to be resident before they execute
+		device->GetResidencyManager().PrepareSubmit();
+
 		// Need to call execute between levels, otherwise you won't get the correct dependencies
 		// Suppose node C depends on A and B
 		// You add A to cl0, B to cl1, then C to cl0
 		// If you try to execute cl0 and cl1 at the same time, you aren't respecting dependencies
-		queue->ExecuteCommandLists(mCommandLists.size(), mRawCommandLists);
+		{
+			// The global states are resolved in submission order, so hold the lock until the lists are on the queue
+			std::scoped_lock submit_lock(ResourceStateTracker::GetSubmitLock());
+
+			UINT lists_count = 0;
+			for (size_t i = 0; i < mCommandLists.size(); ++i)
+			{
+				mFixupBarriers.clear();
+				mStateTrackers[i].Resolve(mFixupBarriers, mType == QueueType::Copy);
+				if (!mFixupBarriers.empty())
+				{
+					// A list can be reset again as soon as it was submitted, the allocator is the one that needs to wait
+					auto& fixup_cl = mFixupCommandLists[i];
+					fixup_cl->Reset((*mFixupAllocators[i]).Get(), nullptr);
+					fixup_cl->ResourceBarrier(mFixupBarriers.size(), mFixupBarriers.data());
+					fixup_cl->Close();
+					mRawCommandLists[lists_count++] = fixup_cl.Get();
+				}
+				mRawCommandLists[lists_count++] = mCommandLists[i].Get();
+			}
+
+			device->ExecuteCommandLists(mType, lists_count, mRawCommandLists);
+		}
 
 		mWorkQueueSize = 0;
 		for (Node* node : mNextWorkQueue)
@@ -269,7 +322,8 @@ uint64_t CommandGraph::Execute(Device* device, ID3D12PipelineState* initial_stat
 	}
 
 	// Signal the fence
-	return device->SignalQueueWork(mType);
+	mLastExecution = device->SignalQueueWork(mType);
+	return mLastExecution;
 }
 
 CommandGraph::~CommandGraph()
@@ -278,6 +332,9 @@ CommandGraph::~CommandGraph()
 	for (HANDLE event : mStartWorkEvents) SetEvent(event);
 	for (auto& thread : mWorkers) thread.join();
 
+	// The last executions can still be running
+	mDevice->DeferRelease(mType, mLastExecution, std::make_tuple(std::move(mCommandLists), std::move(mCommandAllocators), std::move(mFixupCommandLists), std::move(mFixupAllocators)));
+
 	delete[] mNodes;
 	delete[] mWorkQueue;
 	delete[] mRawCommandLists;
@@ -2,6 +2,7 @@
 #include "../Core/stdafx.h"
 #include "Device.h"
 #include "../Resource/BufferedResource.h"
+#include "../Resource/ResourceStateTracker.h"
 
 namespace FrameDX12
 {
@@ -96,14 +97,31 @@ Setup --> RenderObjects ----> PostPro --> Present
 		//
 		// Side note: Repeats are executed counting down from the biggest index.
 		uint64_t Execute(Device * device, ID3D12PipelineState* initial_state = nullptr);
+
+		// Changes every time the command list of the calling worker is reset, so code that caches state set on a command list
+		//  (like bound buffers) knows when to drop it. Different for each thread
+		// If you record outside of a graph, call NotifyCommandListReset after resetting your list
+		static uint64_t GetRecordingEpoch() { return sRecordingEpoch; }
+		static void NotifyCommandListReset() { ++sRecordingEpoch; }
 	private:
+		static thread_local uint64_t sRecordingEpoch;
+
+		Device* mDevice;
 		QueueType mType;
+		uint64_t mLastExecution = 0; // Fence value of the last Execute, the lists and allocators are in use until then
 
 		// One per worker
-		ID3D12CommandList** mRawCommandLists; // Non-owner array of pointers to the CLs
+		ID3D12CommandList** mRawCommandLists; // Non-owner array of pointers to the CLs submitted on a level, with room for the fix-up lists
 		std::vector<DXCommmandList> mCommandLists; // Don't need to buffer command lists as you reset them at the start of Execute
 		std::vector<BufferedResource<DXCommandAllocator>> mCommandAllocators; // Need to be buffered as you may not be waiting between executes
 
+		// The states each worker list needs at its start are only known after recording it, so the barriers to get there
+		//  are recorded on a fix-up list that's submitted right before it
+		std::vector<ResourceStateTracker> mStateTrackers;
+		std::vector<DXCommmandList> mFixupCommandLists;
+		std::vector<BufferedResource<DXCommandAllocator>> mFixupAllocators;
+		std::vector<D3D12_RESOURCE_BARRIER> mFixupBarriers;
+
 		struct Node
 		{
 			std::string name; // used for the pix events
@@ -6,8 +6,34 @@
 
 using namespace FrameDX12;
 
-Device::Device(Window* window_ptr, int adapter_index) 
-	: mPSOPool(this)
+Device::Device(Window* window_ptr, int adapter_index, bool enable_bindless) 
+	: mViewCache(this)
+	, mBindlessEnabled(enable_bindless)
+	, mPSOPool(this)
+	, mResidencyManager(kResourceBufferCount,
+		[this]()
+		{
+			ResidencyManager::Budget budget = { UINT64_MAX, 0 };
+			DXGI_QUERY_VIDEO_MEMORY_INFO info;
+			if (mAdapter && mAdapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info) == S_OK)
+			{
+				budget.budget = info.Budget;
+				budget.usage = info.CurrentUsage;
+			}
+			return budget;
+		},
+		[this](const std::vector<void*>& objects)
+		{
+			ThrowIfFailed(mD3DDevice->Evict(objects.size(), reinterpret_cast<ID3D12Pageable* const*>(objects.data())));
+		},
+		[this](const std::vector<void*>& objects)
+		{
+			// Can fail if there's no memory left even after evicting, the lists that use the objects would fault
+			LogCheck(mD3DDevice->MakeResident(objects.size(), reinterpret_cast<ID3D12Pageable* const*>(objects.data())), LogCategory::Error);
+		})
+	, mPlacedResourceAllocator(this)
+	, mStreamingUploader(this)
+	, mFrameConstants(this)
 {
 	using namespace std;
 
@@ -71,6 +97,9 @@ Device::Device(Window* window_ptr, int adapter_index)
 		factory->EnumAdapters(adapter_index, &adapter);
 	}
 
+	// Needed to query the memory budget
+	adapter->QueryInterface(IID_PPV_ARGS(&mAdapter));
+
 	// Create the device
 	// Try first with feature level 12.1
 	D3D_FEATURE_LEVEL level = D3D_FEATURE_LEVEL_12_1;
@@ -128,13 +157,22 @@ Device::Device(Window* window_ptr, int adapter_index)
 	ThrowIfFailed(mD3DDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mCopyQueue)));
 
 	// Create fences
-	for (auto& [fence, last_work_id, sync_event] : mFences)
+	for (auto& [fence, last_work_id, release_wait_id, sync_event] : mFences)
 	{
 		last_work_id = 0;
 		ThrowIfFailed(mD3DDevice->CreateFence(last_work_id, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
 		sync_event = CreateEventEx(nullptr, FALSE, FALSE, EVENT_ALL_ACCESS);
 	}
 
+	// The upload rings only allocate on first use
+	mUploadRings[QueueTypeToIndex(QueueType::Graphics)].Initialize(this, QueueType::Graphics, kUploadRingSize);
+	mUploadRings[QueueTypeToIndex(QueueType::Compute)].Initialize(this, QueueType::Compute, kUploadRingSize);
+	mUploadRings[QueueTypeToIndex(QueueType::Copy)].Initialize(this, QueueType::Copy, kUploadRingSize);
+
+	mReadbackRings[QueueTypeToIndex(QueueType::Graphics)].Initialize(this, QueueType::Graphics, kReadbackRingSize);
+	mReadbackRings[QueueTypeToIndex(QueueType::Compute)].Initialize(this, QueueType::Compute, kReadbackRingSize);
+	mReadbackRings[QueueTypeToIndex(QueueType::Copy)].Initialize(this, QueueType::Copy, kReadbackRingSize);
+
 	// Describe and create the swap chain.
 	DXGI_SWAP_CHAIN_DESC swapChainDesc = {};
 	swapChainDesc.BufferCount = kResourceBufferCount;
@@ -172,11 +210,14 @@ Device::Device(Window* window_ptr, int adapter_index)
 	}
 
 	// Create descriptor vectors
+	// The views are created on CPU only heaps, and copied to the shader visible ones when building tables
+	// The sizes for the CPU only pools are page sizes, they grow as needed. Check DescriptorPool::GetStats to tune them
 	{
 		D3D12_DESCRIPTOR_HEAP_TYPE type;
 
 		type = D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER;
-		mDescriptorPools[type].Initialize(this, type, true, 256);
+		mDescriptorPools[type].Initialize(this, type, false, 256);
+		GetShaderVisibleHeap(type).Initialize(this, type, D3D12_MAX_SHADER_VISIBLE_SAMPLER_HEAP_SIZE);
 
 		type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
 		mDescriptorPools[type].Initialize(this, type, false, 512);
@@ -185,16 +226,147 @@ Device::Device(Window* window_ptr, int adapter_index)
 		mDescriptorPools[type].Initialize(this, type, false, 256);
 
 		type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-		mDescriptorPools[type].Initialize(this, type, true, 65536);
+		mDescriptorPools[type].Initialize(this, type, false, 4096);
+		UINT bindless_size = mBindlessEnabled ? kBindlessCapacity : 0;
+		GetShaderVisibleHeap(type).Initialize(this, type, bindless_size + 65536, bindless_size);
+	}
+}
+
+void Device::SetDescriptorHeaps(ID3D12GraphicsCommandList* cl)
+{
+	ID3D12DescriptorHeap* heaps[] = { mShaderVisibleHeaps[0].GetHeap(), mShaderVisibleHeaps[1].GetHeap() };
+	cl->SetDescriptorHeaps(_countof(heaps), heaps);
+}
+
+void Device::FlushDescriptorCopies()
+{
+	for (auto& heap : mShaderVisibleHeaps)
+		heap.FlushCopies();
+}
+
+void Device::AdvanceFrame()
+{
+	mStreamingUploader.Pump();
+
+	// Deferred releases wait for the next signal of the queues they were used on, which an idle queue wouldn't get
+	// Same for the work of the frame that ends, the buffered copies of its index wait for it below
+	for (QueueType queue : { QueueType::Graphics, QueueType::Compute, QueueType::Copy })
+	{
+		auto& fence = mFences[QueueTypeToIndex(queue)];
+		if (fence.last_work_id < fence.release_wait_id)
+			SignalQueueWork(queue);
+	}
+
+	for (int idx = 0; idx < DeferredReleaseQueue::kQueueCount; idx++)
+		mFrameFences[sCurrentResourceBufferIndex].values[idx] = mFences[idx].last_work_id;
+
+	++mFrameNumber;
+	sCurrentResourceBufferIndex = (sCurrentResourceBufferIndex + 1) % kResourceBufferCount;
+
+	// The CPU is about to write the copies of this index again (buffered resources, frame constants), so the GPU needs to be done with
+	//  the frame that used them kResourceBufferCount frames ago. Only blocks if the CPU gets that far ahead
+	for (QueueType queue : { QueueType::Graphics, QueueType::Compute, QueueType::Copy })
+		WaitForWork(queue, mFrameFences[sCurrentResourceBufferIndex].values[QueueTypeToIndex(queue)]);
+
+	for (auto& heap : mShaderVisibleHeaps)
+		heap.AdvanceFrame(mFrameNumber);
+
+	mFrameConstants.AdvanceFrame(mFrameNumber);
+
+	mResidencyManager.AdvanceFrame(mFrameNumber);
+
+	// Polling the fences is cheap, no need to wait for anything
+	DeferredReleaseQueue::FenceValues completed;
+	for (int idx = 0; idx < DeferredReleaseQueue::kQueueCount; idx++)
+		completed.values[idx] = mFences[idx].fence->GetCompletedValue();
+	mDeferredReleases.Drain(completed);
+}
+
+Device::~Device()
+{
+	for (QueueType queue : { QueueType::Graphics, QueueType::Compute, QueueType::Copy })
+		WaitForQueue(queue);
+
+	DeferredReleaseQueue::FenceValues completed;
+	for (int idx = 0; idx < DeferredReleaseQueue::kQueueCount; idx++)
+		completed.values[idx] = UINT64_MAX;
+	mDeferredReleases.Drain(completed);
+
+	mReleaseImmediately = true;
+}
+
+void Device::ExecuteCommandLists(QueueType queue, UINT count, ID3D12CommandList* const* lists)
+{
+	int idx = QueueTypeToIndex(queue);
+	{
+		// The global states are resolved in submission order. Graph lists were already resolved by the graph, which holds the lock
+		std::scoped_lock submit_lock(ResourceStateTracker::GetSubmitLock());
+
+		size_t fixups_count = 0;
+		mSubmitLists.clear();
+		for (UINT i = 0; i < count; i++)
+		{
+			mFixupBarriers.clear();
+			if (ResourceStateTracker::ResolveList(lists[i], mFixupBarriers, queue == QueueType::Copy) && !mFixupBarriers.empty())
+			{
+				mSubmitLists.push_back(RecordFixupList(queue));
+				fixups_count++;
+			}
+			mSubmitLists.push_back(lists[i]);
+		}
+
+		GetQueue(queue)->ExecuteCommandLists((UINT)mSubmitLists.size(), mSubmitLists.data());
+		ResourceStateTracker::FinishSubmit();
+
+		// The new fix-up lists are the last ones
+		uint64_t fence_value = RequestNextSignal(idx);
+		for (auto fixup = mFixupLists[idx].rbegin(); fixup != mFixupLists[idx].rbegin() + fixups_count; ++fixup)
+			fixup->fence_value = fence_value;
 	}
+
+	// After submitting, so if another thread signals in between the allocations just wait for the signal after that one
+	mUploadRings[idx].Submit(lists, count);
+	mReadbackRings[idx].Submit(lists, count);
+	RequestNextSignal(idx);
+}
+
+ID3D12CommandList* Device::RecordFixupList(QueueType queue)
+{
+	auto& fixup_lists = mFixupLists[QueueTypeToIndex(queue)];
+
+	FixupList fixup;
+	uint64_t front_fence = fixup_lists.empty() ? 0 : fixup_lists.front().fence_value;
+	if (front_fence != 0 && front_fence <= GetCompletedWork(queue))
+	{
+		fixup = std::move(fixup_lists.front());
+		fixup_lists.pop_front();
+		ThrowIfFailed(fixup.allocator->Reset());
+		ThrowIfFailed(fixup.list->Reset(fixup.allocator.Get(), nullptr));
+	}
+	else
+	{
+		ThrowIfFailed(mD3DDevice->CreateCommandAllocator((D3D12_COMMAND_LIST_TYPE)queue, IID_PPV_ARGS(fixup.allocator.GetAddressOf())));
+		ThrowIfFailed(mD3DDevice->CreateCommandList(0, (D3D12_COMMAND_LIST_TYPE)queue, fixup.allocator.Get(), nullptr, IID_PPV_ARGS(fixup.list.GetAddressOf())));
+	}
+
+	fixup.list->ResourceBarrier((UINT)mFixupBarriers.size(), mFixupBarriers.data());
+	ThrowIfFailed(fixup.list->Close());
+	fixup.fence_value = 0;
+
+	return fixup_lists.emplace_back(std::move(fixup)).list.Get();
 }
 
 uint64_t Device::SignalQueueWork(QueueType queue)
 {
 	auto& fence = mFences[QueueTypeToIndex(queue)];
-	++fence.last_work_id;
-	ThrowIfFailed(GetQueue(queue)->Signal(fence.fence.Get(), fence.last_work_id));
-	return fence.last_work_id;
+	uint64_t work_id = ++fence.last_work_id;
+	ThrowIfFailed(GetQueue(queue)->Signal(fence.fence.Get(), work_id));
+
+	// Everything staged by the lists submitted until now belongs to work before this signal
+	mUploadRings[QueueTypeToIndex(queue)].CloseBatch(work_id);
+	mReadbackRings[QueueTypeToIndex(queue)].CloseBatch(work_id);
+
+	return work_id;
 }
 
 void Device::WaitForQueue(QueueType queue)
@@ -207,12 +379,23 @@ void Device::WaitForQueue(QueueType queue)
 	}
 }
 
-void Device::WaitForWork(QueueType queue, uint64_t id)
+uint64_t Device::GetCompletedWork(QueueType queue)
+{
+	return mFences[QueueTypeToIndex(queue)].fence->GetCompletedValue();
+}
+
+void Device::QueueWaitForWork(QueueType queue, QueueType work_queue, uint64_t id)
+{
+	ThrowIfFailed(GetQueue(queue)->Wait(mFences[QueueTypeToIndex(work_queue)].fence.Get(), id));
+}
+
+void Device::WaitForWork(QueueType queue, uint64_t id, HANDLE event)
 {
 	auto& fence = mFences[QueueTypeToIndex(queue)];
 	if (fence.fence->GetCompletedValue() < id)
 	{
-		ThrowIfFailed(fence.fence->SetEventOnCompletion(id, fence.sync_event));
-		WaitForSingleObject(fence.sync_event, INFINITE);
+		if (!event) event = fence.sync_event;
+		ThrowIfFailed(fence.fence->SetEventOnCompletion(id, event));
+		WaitForSingleObject(event, INFINITE);
 	}
 }
\ No newline at end of file
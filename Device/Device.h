@@ -1,7 +1,18 @@
 #pragma once
 #include "../Core/stdafx.h"
 #include "../Resource/DescriptorPool.h"
+#include "../Resource/ShaderVisibleHeap.h"
+#include "../Resource/ViewCache.h"
+#include "../Resource/UploadRing.h"
+#include "../Resource/ReadbackRing.h"
+#include "../Resource/DeferredReleaseQueue.h"
+#include "../Resource/StreamingUploader.h"
+#include "../Resource/FrameConstantAllocator.h"
+#include "../Resource/ResidencyManager.h"
+#include "../Resource/PlacedResourceAllocator.h"
 #include "../Resource/PipelineStateObjectPool.h"
+#include "../Resource/ResourceStateTracker.h"
+#include "../Resource/BufferedResource.h"
 
 namespace FrameDX12
 {
@@ -18,7 +29,10 @@ namespace FrameDX12
 		// Constructs the device
 		// window_ptr - The pointer to the window for which to create the swapchain. If null no swapchain will be created.
 		// adapter_index - The index of the adapter to use. If -1 all adapters will be listed and the user will be asked to choose one.
-		Device(class Window* window_ptr, int adapter_index = 0);
+		// enable_bindless - If true, every SRV and UAV created through CommitedResource is also published to the bindless range of the CBV_SRV_UAV heap
+		Device(class Window* window_ptr, int adapter_index = 0, bool enable_bindless = false);
+		// Waits for all the queues, so the objects waiting on the deferred release queue can be destroyed
+		~Device();
 
 		// Gets a weak (raw) pointer to the device
 		ID3D12Device* GetDevice() const { return mD3DDevice.Get(); }
@@ -99,25 +113,154 @@ namespace FrameDX12
 			}
 		}
 
+		// Submits the lists to the queue. Use it instead of calling ExecuteCommandLists on the queue directly, so the upload and readback
+		//  rings know which of their allocations were submitted, and tag them with the next signal of the queue (AdvanceFrame signals it if nothing else does)
+		// Lists recorded outside a graph get their transitions resolved here, with a fix-up list submitted right before each one that needs it
+		void ExecuteCommandLists(QueueType queue, UINT count, ID3D12CommandList* const* lists);
+
 		// Signals the fence of the queue and increases the value
 		// Returns the fence value (functions as a workload id)
 		uint64_t SignalQueueWork(QueueType queue);
 
 		// Waits for a specific id (fence value) on the queue
 		// It will also wait for all prior work
-		void WaitForWork(QueueType queue, uint64_t id);
+		// Threads that can wait at the same time as others need to pass their own event
+		void WaitForWork(QueueType queue, uint64_t id, HANDLE event = nullptr);
 
 		// Waits for the queue to finish
 		void WaitForQueue(QueueType queue);
 
+		// Returns the last id (fence value) that the queue finished
+		uint64_t GetCompletedWork(QueueType queue);
+
+		// Makes the queue wait on the GPU for a specific id (fence value) of another queue. The CPU doesn't wait
+		void QueueWaitForWork(QueueType queue, QueueType work_queue, uint64_t id);
+
+		// Keeps the object alive until the queue reaches the fence value, then destroys it
+		// The objects are destroyed from AdvanceFrame. Thread safe
+		template<typename T>
+		void DeferRelease(QueueType queue, uint64_t fence_value, T&& object)
+		{
+			if (mReleaseImmediately)
+				return ReleaseNow(std::forward<T>(object));
+
+			DeferredReleaseQueue::FenceValues fences;
+			fences.values[QueueTypeToIndex(queue)] = fence_value;
+			mDeferredReleases.Enqueue(fences, std::forward<T>(object));
+		}
+
+		// Same, but waits for the next signal of each queue on the mask (see GetQueueBit)
+		// That covers the work submitted so far and command lists that used the object and are recorded but not submitted yet
+		// AdvanceFrame signals the queues nothing else signaled, so idle queues don't keep the object alive
+		template<typename T>
+		void DeferRelease(uint32_t queue_mask, T&& object)
+		{
+			if (mReleaseImmediately)
+				return ReleaseNow(std::forward<T>(object));
+
+			DeferredReleaseQueue::FenceValues fences;
+			for (int idx = 0; idx < DeferredReleaseQueue::kQueueCount; idx++)
+			{
+				if (queue_mask & (1u << idx))
+					fences.values[idx] = RequestNextSignal(idx);
+			}
+			mDeferredReleases.Enqueue(fences, std::forward<T>(object));
+		}
+
+		// Same, for objects that don't know the queues they were used on. Waits for the next signal of every queue, as any of them
+		//  can have a list that used the object recorded but not submitted yet
+		template<typename T>
+		void DeferRelease(T&& object)
+		{
+			DeferRelease(kAllQueues, std::forward<T>(object));
+		}
+
+		uint32_t GetQueueBit(QueueType queue) const { return 1u << QueueTypeToIndex(queue); }
+		static constexpr uint32_t kAllQueues = (1u << DeferredReleaseQueue::kQueueCount) - 1;
+
+		// Returns the ring used to stage uploads recorded on command lists of the queue
+		UploadRing& GetUploadRing(QueueType queue) { return mUploadRings[QueueTypeToIndex(queue)]; }
+		static constexpr uint64_t kUploadRingSize = 64 * 1024 * 1024;
+
+		// Returns the ring used to copy data back to the CPU on lists of that queue
+		ReadbackRing& GetReadbackRing(QueueType queue) { return mReadbackRings[QueueTypeToIndex(queue)]; }
+		static constexpr uint64_t kReadbackRingSize = 32 * 1024 * 1024;
+
 		// Returns a reference to the descriptor pool
+		// All the pools are CPU only (staging), views are written here and copied to the shader visible heaps when building tables
 		DescriptorPool& GetDescriptorPool(D3D12_DESCRIPTOR_HEAP_TYPE type)
 		{
 			return mDescriptorPools[type];
 		}
 
+		// Returns a reference to the shader visible heap. Only CBV_SRV_UAV and SAMPLER have one
+		ShaderVisibleHeap& GetShaderVisibleHeap(D3D12_DESCRIPTOR_HEAP_TYPE type)
+		{
+			return mShaderVisibleHeaps[type == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0];
+		}
+
+		// Returns a table on the shader visible heap with copies of the descriptors
+		// All descriptors must be of the same type. See ShaderVisibleHeap::GetTable
+		CD3DX12_GPU_DESCRIPTOR_HANDLE GetDescriptorTable(std::initializer_list<Descriptor> descriptors)
+		{
+			return GetShaderVisibleHeap(descriptors.begin()->GetType()).GetTable(descriptors);
+		}
+
+		// Bindless mode. See ShaderVisibleHeap::PublishBindless
+		// The range has kBindlessCapacity entries. SRVs and UAVs share it, so declare both unbounded arrays starting at offset 0 of the table
+		static constexpr UINT kBindlessCapacity = 65536;
+		bool IsBindlessEnabled() const { return mBindlessEnabled; }
+		CD3DX12_GPU_DESCRIPTOR_HANDLE GetBindlessTable() { return GetShaderVisibleHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV).GetBindlessTable(); }
+
+		// Returns the manager that keeps the DEFAULT heap memory under the budget of the adapter local segment
+		// Use ResidencyManager::SetBudget to set a lower limit, for example when running many instances on the same GPU
+		ResidencyManager& GetResidencyManager() { return mResidencyManager; }
+
+		// Returns the uploader that streams data on the copy queue. AdvanceFrame pumps it
+		StreamingUploader& GetStreamingUploader() { return mStreamingUploader; }
+
+		// Returns the allocator for constants that only live for the current frame, to bind as root CBVs. AdvanceFrame resets it
+		FrameConstantAllocator& GetFrameConstants() { return mFrameConstants; }
+
+		// Returns the allocator that places the resources created by CommitedResource on shared heaps
+		PlacedResourceAllocator& GetPlacedResourceAllocator() { return mPlacedResourceAllocator; }
+
+		// Returns the cache used to deduplicate the SRVs and UAVs created by CommitedResource
+		ViewCache& GetViewCache() { return mViewCache; }
+
+		// Sets the shader visible heaps on the command list
+		void SetDescriptorHeaps(ID3D12GraphicsCommandList* cl);
+
+		// Copies all the pending descriptor tables to the shader visible heaps
+		// CommandGraph::Execute calls this before submitting, you only need it if you execute command lists yourself
+		void FlushDescriptorCopies();
+
+		// Advances the resource buffer index and does the per frame bookkeeping of the device, like destroying the objects on the deferred release queue
+		// Call it after presenting, instead of changing sCurrentResourceBufferIndex directly
+		// Waits until the GPU finished the frame that last used the new index, kResourceBufferCount frames ago, so the buffered copies can be written
+		void AdvanceFrame();
+
+		// Number of times AdvanceFrame was called
+		uint64_t GetFrameNumber() const { return mFrameNumber; }
+
 		ID3D12PipelineState* GetPSO(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { return mPSOPool.GetPSO(desc); }
 	private:
+		template<typename T>
+		static void ReleaseNow(T&& object)
+		{
+			std::decay_t<T> released(std::forward<T>(object));
+		}
+
+		// Returns the next fence value of the queue, and makes sure AdvanceFrame signals it if nothing else does
+		uint64_t RequestNextSignal(int queue_index)
+		{
+			auto& fence = mFences[queue_index];
+			uint64_t value = fence.last_work_id + 1;
+			uint64_t requested = fence.release_wait_id;
+			while (requested < value && !fence.release_wait_id.compare_exchange_weak(requested, value));
+			return value;
+		}
+
 		int QueueTypeToIndex(QueueType type) const
 		{
 			if (type == QueueType::Graphics)
@@ -132,6 +275,7 @@ namespace FrameDX12
 
 		ComPtr<ID3D12Device> mD3DDevice;
 		int mDeviceVersion;
+		ComPtr<IDXGIAdapter3> mAdapter; // Null if the adapter can't report its memory budget
 
 		ComPtr<ID3D12CommandQueue> mGraphicsQueue;
 		ComPtr<ID3D12CommandQueue> mComputeQueue;
@@ -140,15 +284,49 @@ namespace FrameDX12
 		struct
 		{
 			ComPtr<ID3D12Fence> fence;
-			uint64_t last_work_id;
+			std::atomic<uint64_t> last_work_id; // Read by DeferRelease from any thread
+			std::atomic<uint64_t> release_wait_id = 0; // Highest value a deferred release waits for
 			HANDLE sync_event;
 		} mFences[3];
 
+		// Fix-up lists of the lists submitted through ExecuteCommandLists, reused once the GPU is done with them
+		struct FixupList
+		{
+			ComPtr<ID3D12CommandAllocator> allocator;
+			ComPtr<ID3D12GraphicsCommandList> list;
+			uint64_t fence_value; // 0 while being submitted
+		};
+		std::deque<FixupList> mFixupLists[3];
+		std::vector<ID3D12CommandList*> mSubmitLists; // Scratch, guarded by the submit lock
+		std::vector<D3D12_RESOURCE_BARRIER> mFixupBarriers; // Same
+		ID3D12CommandList* RecordFixupList(QueueType queue);
+
+		// Fence values of each queue at the end of the last frame that used each resource buffer index
+		DeferredReleaseQueue::FenceValues mFrameFences[kResourceBufferCount];
+
+		UploadRing mUploadRings[3];
+		ReadbackRing mReadbackRings[3];
+
 		ComPtr<IDXGISwapChain> mSwapChain;
 		int mSwapChainVersion;
 
 		DescriptorPool mDescriptorPools[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
+		ShaderVisibleHeap mShaderVisibleHeaps[2];
+		ViewCache mViewCache; // Needs to be destroyed before the heaps, as it holds descriptors
+
+		uint64_t mFrameNumber = 0;
+		bool mBindlessEnabled;
 
 		PipelineStateObjectPool mPSOPool;
+		ResidencyManager mResidencyManager; // Before the allocator, as releasing its heaps unregisters them
+		PlacedResourceAllocator mPlacedResourceAllocator;
+		StreamingUploader mStreamingUploader;
+		FrameConstantAllocator mFrameConstants;
+
+		// Last, so it's destroyed first. The objects on it can have descriptors and heap ranges
+		// The destructor empties it after waiting for the GPU, and from there on objects are released right away, as the
+		//  members destroyed later can still release things (the view cache holds descriptors)
+		DeferredReleaseQueue mDeferredReleases;
+		bool mReleaseImmediately = false;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "BindlessIndex.h"
+#include "BufferedResource.h"
+#include "ShaderVisibleHeap.h"
+#include "../Device/Device.h"
+
+using namespace FrameDX12;
+
+BindlessIndex::BindlessIndex() :
+	  mRefCount(nullptr)
+	, mHeap(nullptr)
+	, mIndex(BindlessIndexAllocator::kInvalidIndex)
+{
+}
+
+BindlessIndex::~BindlessIndex()
+{
+	ReleaseReference();
+}
+
+BindlessIndex::BindlessIndex(const BindlessIndex& other) :
+	  mRefCount(other.mRefCount)
+	, mHeap(other.mHeap)
+	, mIndex(other.mIndex)
+{
+	if (mRefCount) (*mRefCount)++;
+}
+
+BindlessIndex& BindlessIndex::operator=(const BindlessIndex& rhs)
+{
+	if (this != &rhs)
+	{
+		ReleaseReference();
+
+		mRefCount = rhs.mRefCount;
+		mHeap = rhs.mHeap;
+		mIndex = rhs.mIndex;
+
+		if (mRefCount) (*mRefCount)++;
+	}
+
+	return *this;
+}
+
+BindlessIndex::BindlessIndex(BindlessIndex&& other) :
+	  mRefCount(std::exchange(other.mRefCount, nullptr))
+	, mHeap(std::exchange(other.mHeap, nullptr))
+	, mIndex(std::exchange(other.mIndex, BindlessIndexAllocator::kInvalidIndex))
+{
+}
+
+BindlessIndex& BindlessIndex::operator=(BindlessIndex&& rhs)
+{
+	if (this != &rhs)
+	{
+		ReleaseReference();
+
+		mRefCount = std::exchange(rhs.mRefCount, nullptr);
+		mHeap = std::exchange(rhs.mHeap, nullptr);
+		mIndex = std::exchange(rhs.mIndex, BindlessIndexAllocator::kInvalidIndex);
+	}
+
+	return *this;
+}
+
+void BindlessIndex::ReleaseReference()
+{
+	if (mRefCount != nullptr && mRefCount->fetch_sub(1) == 1)
+	{
+		// Command lists in flight can still read the index
+		if (mHeap) mHeap->mDevicePtr->DeferRelease(RetiredIndex(mHeap, mIndex));
+		delete mRefCount;
+	}
+
+	mRefCount = nullptr;
+	mHeap = nullptr;
+	mIndex = BindlessIndexAllocator::kInvalidIndex;
+}
+
+BindlessIndex::RetiredIndex::~RetiredIndex()
+{
+	if (heap) ReturnIndex(heap, index);
+}
+
+void BindlessIndex::ReturnIndex(ShaderVisibleHeap* heap, uint32_t index)
+{
+	heap->mBindlessIndexes.Release(index);
+}
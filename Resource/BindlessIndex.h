@@ -0,0 +1,46 @@
+#pragma once
+#include "../Core/stdafx.h"
+#include "BindlessIndexAllocator.h"
+
+namespace FrameDX12
+{
+	class ShaderVisibleHeap;
+
+	// Reference counted index on the bindless range of a shader visible heap
+	// Same semantics as Descriptor, the index is released when the last copy is destroyed, through the device deferred release queue
+	class BindlessIndex
+	{
+		friend class ShaderVisibleHeap;
+	public:
+		BindlessIndex();
+		~BindlessIndex();
+		BindlessIndex(const BindlessIndex&);
+		BindlessIndex& operator=(const BindlessIndex&);
+
+		BindlessIndex(BindlessIndex&&);
+		BindlessIndex& operator=(BindlessIndex&&);
+
+		// The index to pass to the shaders
+		uint32_t operator*() const { return mIndex; }
+
+		bool IsValid() const { return mHeap != nullptr && mIndex != BindlessIndexAllocator::kInvalidIndex; }
+	private:
+		void ReleaseReference();
+
+		// Returns the index to the heap when destroyed, which the deferred release queue does once the GPU is done with it
+		struct RetiredIndex
+		{
+			RetiredIndex(ShaderVisibleHeap* heap, uint32_t index) : heap(heap), index(index) {}
+			RetiredIndex(RetiredIndex&& other) : heap(std::exchange(other.heap, nullptr)), index(other.index) {}
+			~RetiredIndex();
+
+			ShaderVisibleHeap* heap;
+			uint32_t index;
+		};
+		static void ReturnIndex(ShaderVisibleHeap* heap, uint32_t index);
+
+		std::atomic_int* mRefCount;
+		ShaderVisibleHeap* mHeap;
+		uint32_t mIndex;
+	};
+}
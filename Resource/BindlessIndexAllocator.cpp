@@ -0,0 +1,44 @@
+#include "BindlessIndexAllocator.h"
+
+using namespace FrameDX12;
+
+void BindlessIndexAllocator::Initialize(uint32_t capacity)
+{
+	mCapacity = capacity;
+	mTop = 0;
+	mUsedCount = 0;
+	mFreeIndexes.clear();
+}
+
+uint32_t BindlessIndexAllocator::Allocate()
+{
+	std::scoped_lock lock(mLock);
+
+	uint32_t index;
+	if (!mFreeIndexes.empty())
+	{
+		index = mFreeIndexes.back();
+		mFreeIndexes.pop_back();
+	}
+	else if (mTop < mCapacity)
+	{
+		index = mTop++;
+	}
+	else
+	{
+		return kInvalidIndex;
+	}
+
+	++mUsedCount;
+	return index;
+}
+
+void BindlessIndexAllocator::Release(uint32_t index)
+{
+	if (index == kInvalidIndex)
+		return;
+
+	std::scoped_lock lock(mLock);
+	mFreeIndexes.push_back(index);
+	--mUsedCount;
+}
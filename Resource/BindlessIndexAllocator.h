@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+// No D3D on this file, it's only the bookkeeping of the indexes
+
+namespace FrameDX12
+{
+	// Manages the indexes of the bindless range of a shader visible heap
+	// It doesn't touch the GPU at all, it only does the bookkeeping of the indexes. Released indexes are reused right away, so only
+	//  release them once the GPU is done (BindlessIndex does it through the device deferred release queue)
+	// Thread safe
+	class BindlessIndexAllocator
+	{
+	public:
+		static constexpr uint32_t kInvalidIndex = ~0u;
+
+		void Initialize(uint32_t capacity);
+
+		// Returns kInvalidIndex if the range is full
+		uint32_t Allocate();
+		void Release(uint32_t index);
+
+		uint32_t GetCapacity() const { return mCapacity; }
+		// Number of indexes in use
+		uint32_t GetUsedCount() const { return mUsedCount; }
+	private:
+		std::mutex mLock;
+		std::vector<uint32_t> mFreeIndexes;
+		uint32_t mTop = 0;
+		uint32_t mCapacity = 0;
+		std::atomic<uint32_t> mUsedCount = 0;
+	};
+}
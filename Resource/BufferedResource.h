@@ -56,4 +56,84 @@ namespace FrameDX12
 	protected:
 		Type mResource[kResourceBufferCount];
 	};
+
+	// Bookkeeping for mapped data that has a copy per buffered frame, where the CPU only writes the copy of the current frame
+	// That copy was last read by the GPU kResourceBufferCount frames ago, so writing it never needs to wait
+	// Units (elements, pages) written on a frame are stale on the other copies, which get them from the latest CPU data when their frame comes
+	// Thread safe
+	class BufferedCopiesTracker
+	{
+	public:
+		void Initialize(size_t units_count)
+		{
+			for (uint8_t copy = 0; copy < kResourceBufferCount; copy++)
+			{
+				mStale[copy].assign(units_count, false);
+				mStaleCount[copy] = 0;
+			}
+			mSyncedFrame = ~0ull;
+		}
+
+		static uint8_t GetCurrentCopy() { return sCurrentResourceBufferIndex % kResourceBufferCount; }
+
+		// Brings the copy of the current frame up to date, calling write(copy, unit) for each stale unit
+		// Only takes the lock the first time it's called on a frame
+		template<typename WriteFunction>
+		void Sync(uint64_t frame_number, WriteFunction&& write)
+		{
+			if (mSyncedFrame.load(std::memory_order_acquire) == frame_number)
+				return;
+
+			std::scoped_lock lock(mLock);
+			SyncLocked(frame_number, write);
+		}
+
+		// Same, but returns with the lock taken, to write the current copy and call MarkWritten
+		template<typename WriteFunction>
+		std::unique_lock<std::mutex> SyncAndLock(uint64_t frame_number, WriteFunction&& write)
+		{
+			std::unique_lock lock(mLock);
+			SyncLocked(frame_number, write);
+			return lock;
+		}
+
+		// Marks the unit as stale on the copies of the other frames. Call it with the lock of SyncAndLock, after writing the current copy
+		void MarkWritten(size_t unit)
+		{
+			uint8_t current = GetCurrentCopy();
+			for (uint8_t copy = 0; copy < kResourceBufferCount; copy++)
+			{
+				if (copy != current && !mStale[copy][unit])
+				{
+					mStale[copy][unit] = true;
+					++mStaleCount[copy];
+				}
+			}
+		}
+	private:
+		template<typename WriteFunction>
+		void SyncLocked(uint64_t frame_number, WriteFunction& write)
+		{
+			if (mSyncedFrame.load(std::memory_order_relaxed) == frame_number)
+				return;
+
+			uint8_t copy = GetCurrentCopy();
+			for (size_t unit = 0; mStaleCount[copy] > 0 && unit < mStale[copy].size(); unit++)
+			{
+				if (mStale[copy][unit])
+				{
+					write(copy, unit);
+					mStale[copy][unit] = false;
+					--mStaleCount[copy];
+				}
+			}
+
+			mSyncedFrame.store(frame_number, std::memory_order_release);
+		}
+
+		std::mutex mLock;
+		std::vector<bool> mStale[kResourceBufferCount];
+		size_t mStaleCount[kResourceBufferCount] = {};
+		std::atomic<uint64_t> mSyncedFrame = ~0ull;
+	};
 }
\ No newline at end of file
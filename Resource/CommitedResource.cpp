@@ -1,11 +1,10 @@
 #include "CommitedResource.h"
 #include "../Device/Device.h"
 #include "../Core/Log.h"
+#include "../Core/StreamingCopy.h"
 
 using namespace FrameDX12;
 
-thread_local std::vector<ComPtr<ID3D12Resource>> CommitedResource::mTempUploadResources;
-
 void CommitedResource::Create(	Device* device, 
 								CD3DX12_RESOURCE_DESC description,
 								D3D12_RESOURCE_STATES initial_states,
@@ -13,17 +12,77 @@ void CommitedResource::Create(	Device* device,
 								D3D12_HEAP_TYPE heap_type,
 								D3D12_HEAP_FLAGS heap_flags)
 {
+	// Creating again over an old resource
+	ReleaseResource();
+
 	mDevice = device;
-	mStates = initial_states;
-	
-	auto heap_props = CD3DX12_HEAP_PROPERTIES(heap_type);
-	ThrowIfFailed(mDevice->GetDevice()->CreateCommittedResource(
-		&heap_props,
-		heap_flags,
-		&description,
-		initial_states,
-		clear_value,
-		IID_PPV_ARGS(&mResource)));
+	mDescription = description;
+	mHeapType = heap_type;
+
+	if (heap_flags != D3D12_HEAP_FLAG_NONE ||
+		!mDevice->GetPlacedResourceAllocator().CreateResource(description, heap_type, initial_states, clear_value, mResource, mPlacement))
+	{
+		auto heap_props = CD3DX12_HEAP_PROPERTIES(heap_type);
+		ThrowIfFailed(mDevice->GetDevice()->CreateCommittedResource(
+			&heap_props,
+			heap_flags,
+			&description,
+			initial_states,
+			clear_value,
+			IID_PPV_ARGS(&mResource)));
+	}
+
+	// Placed resources are evicted with their heap. Only the video memory is budgeted
+	if (mPlacement.IsValid())
+	{
+		mResidency = mPlacement.GetResidency();
+	}
+	else if (heap_type == D3D12_HEAP_TYPE_DEFAULT)
+	{
+		uint64_t size = mDevice->GetDevice()->GetResourceAllocationInfo(0, 1, &description).SizeInBytes;
+		mResidency = mDevice->GetResidencyManager().Register(static_cast<ID3D12Pageable*>(mResource.Get()), size);
+	}
+
+	uint32_t subresources_count = description.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ? 1 : description.Subresources(mDevice->GetDevice());
+	mStates = std::make_unique<ResourceStates>(mResource.Get(), subresources_count, initial_states);
+	mStates->stateless = description.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER || (description.Flags & D3D12_RESOURCE_FLAG_ALLOW_SIMULTANEOUS_ACCESS);
+	mStates->needs_discard = mPlacement.IsValid() && (description.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL));
+}
+
+CommitedResource::~CommitedResource()
+{
+	ReleaseResource();
+}
+
+void CommitedResource::ReleaseResource()
+{
+	if (!mDevice || !mResource)
+		return;
+
+	// The cache holds references to the views too, so take them out and release them with the resource. Otherwise whichever
+	//  copy goes last decides when the descriptors and bindless indexes are reused
+	auto views = mDevice->GetViewCache().Evict(mResource.Get());
+
+	if (!mPlacement.IsValid())
+		mDevice->GetResidencyManager().Unregister(mResidency);
+	mResidency = nullptr;
+
+	// The pair destroys the resource before freeing the heap range
+	// The views and bindless indexes wait for the same queues, so none of them is reused while a list can still read it
+	// Resources never used on a list only wait for the queues that are busy
+	auto resource = std::make_pair(std::move(mPlacement), std::move(mResource));
+	auto resource_views = std::make_tuple(std::move(views), std::move(mSRVIndex), std::move(mUAVIndex));
+	uint32_t used_queues = mStates->used_queues;
+	if (used_queues)
+	{
+		mDevice->DeferRelease(used_queues, std::move(resource));
+		mDevice->DeferRelease(used_queues, std::move(resource_views));
+	}
+	else
+	{
+		mDevice->DeferRelease(std::move(resource));
+		mDevice->DeferRelease(std::move(resource_views));
+	}
 }
 
 void CommitedResource::CreateDSV()
@@ -45,22 +104,64 @@ void CommitedResource::CreateCBV()
 
 void CommitedResource::CreateSRV(D3D12_SHADER_RESOURCE_VIEW_DESC* desc_ptr)
 {
-	mSRV = mDevice->GetDescriptorPool(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV).GetNextDescriptor();
-	mDevice->GetDevice()->CreateShaderResourceView(mResource.Get(), desc_ptr, *mSRV);
+	auto view = mDevice->GetViewCache().GetSRV(mResource.Get(), desc_ptr);
+	mSRV = view.descriptor;
+	mSRVIndex = view.bindless_index;
 }
 
 void CommitedResource::CreateUAV(D3D12_UNORDERED_ACCESS_VIEW_DESC* desc_ptr, ComPtr<ID3D12Resource> counter)
 {
-	mUAV = mDevice->GetDescriptorPool(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV).GetNextDescriptor();
-	mDevice->GetDevice()->CreateUnorderedAccessView(mResource.Get(), counter.Get(), desc_ptr, *mUAV);
+	auto view = mDevice->GetViewCache().GetUAV(mResource.Get(), counter.Get(), desc_ptr);
+	mUAV = view.descriptor;
+	mUAVIndex = view.bindless_index;
+}
+
+void CommitedResource::CopyFromMemory(ID3D12GraphicsCommandList* cl, const void* data, size_t size_in_bytes, D3D12_RESOURCE_STATES new_states, uint64_t destination_offset)
+{
+	LogAssert(mDescription.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER, LogCategory::Error);
+
+	Transition(cl, D3D12_RESOURCE_STATE_COPY_DEST);
+
+	// QueueType uses the same values as the command list types
+	auto allocation = mDevice->GetUploadRing((QueueType)cl->GetType()).Allocate(cl, size_in_bytes);
+	StreamingCopy(allocation.cpu_ptr, data, size_in_bytes);
+	cl->CopyBufferRegion(mResource.Get(), destination_offset, allocation.resource, allocation.offset, size_in_bytes);
+
+	Transition(cl, new_states);
+}
+
+ReadbackFuture CommitedResource::ReadbackBuffer(ID3D12GraphicsCommandList* cl, uint64_t offset, uint64_t size_in_bytes)
+{
+	LogAssert(mDescription.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER, LogCategory::Error);
+
+	// Upload heap resources can't leave GENERIC_READ, and it already allows copying from them
+	if (mHeapType != D3D12_HEAP_TYPE_UPLOAD)
+		Transition(cl, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	else
+		MarkUsed(cl);
+
+	return mDevice->GetReadbackRing((QueueType)cl->GetType()).ReadBuffer(cl, mResource.Get(), offset, size_in_bytes);
+}
+
+ReadbackFuture CommitedResource::ReadbackTexture(ID3D12GraphicsCommandList* cl, UINT subresource)
+{
+	Transition(cl, D3D12_RESOURCE_STATE_COPY_SOURCE, subresource);
+
+	return mDevice->GetReadbackRing((QueueType)cl->GetType()).ReadTexture(cl, mResource.Get(), subresource);
 }
 
-void CommitedResource::Transition(ID3D12GraphicsCommandList* cl, D3D12_RESOURCE_STATES new_states)
+void CommitedResource::Transition(ID3D12GraphicsCommandList* cl, D3D12_RESOURCE_STATES new_states, UINT subresource)
 {
-	if (mStates != new_states)
+	MarkUsed(cl);
+
+	// Placed render targets and depth buffers start with whatever the heap had, which is not a valid content for them
+	// Only direct lists can discard them
+	if (mStates->needs_discard && cl->GetType() == D3D12_COMMAND_LIST_TYPE_DIRECT && mStates->needs_discard.exchange(false))
 	{
-		CD3DX12_RESOURCE_BARRIER transitions[] = { CD3DX12_RESOURCE_BARRIER::Transition(mResource.Get(), mStates, new_states) };
-		cl->ResourceBarrier(1, transitions);
-		mStates = new_states;
+		bool depth = mDescription.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+		ResourceStateTracker::Transition(cl, *mStates, depth ? D3D12_RESOURCE_STATE_DEPTH_WRITE : D3D12_RESOURCE_STATE_RENDER_TARGET);
+		cl->DiscardResource(mResource.Get(), nullptr);
 	}
+
+	ResourceStateTracker::Transition(cl, *mStates, new_states, subresource);
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 #include "DescriptorPool.h"
+#include "BindlessIndex.h"
+#include "PlacedResourceAllocator.h"
+#include "ResourceStateTracker.h"
 #include "../Device/Device.h"
 #include "../Core/Log.h"
 
@@ -8,9 +11,19 @@ namespace FrameDX12
 	class CommitedResource
 	{
 	public:
+		CommitedResource() = default;
+		CommitedResource(const CommitedResource&) = delete; // It may own a range of a heap
+		CommitedResource(CommitedResource&&) = default;
+		CommitedResource& operator=(const CommitedResource&) = delete;
+		CommitedResource& operator=(CommitedResource&&) = default;
+		// Evicts the views of the resource from the device view cache
+		// The resource itself is released through the device deferred release queue, as the GPU can still be using it
+		~CommitedResource();
+
 		// TODO : Store the clear value and provide a Clear function that takes a CL and calls Clear with that value
 
 		// By default the resource is created on the COPY_DEST state, to be filled
+		// Resources without heap flags are placed on the shared heaps of the device PlacedResourceAllocator when they fit, otherwise they are committed
 		void Create(Device* device,
 					CD3DX12_RESOURCE_DESC description,
 					D3D12_RESOURCE_STATES initial_states = D3D12_RESOURCE_STATE_COPY_DEST,
@@ -21,56 +34,23 @@ namespace FrameDX12
 		void CreateDSV();
 		void CreateCBV();
 
+		// SRVs and UAVs are deduplicated through the device ViewCache, so creating the same view twice returns the same descriptor
+		// If the device has bindless enabled the SRV and UAV are also published to the bindless range, see GetSRVIndex and GetUAVIndex
 		// Note : 1) It's ok to pass an rvalue pointer as desc, 2) some resources REQUIRE a desc to be provided
 		void CreateSRV(D3D12_SHADER_RESOURCE_VIEW_DESC* desc = nullptr);
 		// Note : 1) It's ok to pass an rvalue pointer as desc, 2) some resources REQUIRE a desc to be provided
 		void CreateUAV(D3D12_UNORDERED_ACCESS_VIEW_DESC * desc, ComPtr<ID3D12Resource> counter = nullptr);
 
 		// Fills the resource from a provided CPU buffer
+		// The data is copied to the upload ring of the command list queue, so the buffer can be freed after this returns
 		// Note that this only adds the command to the list, you need to sync before using the resource
+		// Only for buffers
+		void CopyFromMemory(ID3D12GraphicsCommandList* cl, const void* data, size_t size_in_bytes, D3D12_RESOURCE_STATES new_states, uint64_t destination_offset = 0);
+
 		template<typename T>
 		void FillFromBuffer(ID3D12GraphicsCommandList* cl, T* buffer, size_t buffer_size, D3D12_RESOURCE_STATES new_states)
 		{
-			Transition(cl, D3D12_RESOURCE_STATE_COPY_DEST);
-
-			D3D12_SUBRESOURCE_DATA data_desc = {};
-			data_desc.pData = buffer;
-			data_desc.RowPitch = buffer_size * sizeof(T);
-			data_desc.SlicePitch = data_desc.RowPitch;
-
-			// Try to find a temp resource big enough or create it if it doesn't exist
-			// TODO : Check when we can delete them, not easy as they need to be alive by the time Close is called
-			// TODO 2 : Making it threadlocal for now, but it could most likely be shared across threads
-			// TODO 3 : You CAN'T reuse the same buffer on the same CL, you need to either use different buffers or do an Execute.
-			//			 FIND A *NICE* WAY TO REUSE STUFF!
-			ComPtr<ID3D12Resource> upload_resource;
-			/*for (auto& resource : mTempUploadResources)
-			{
-				if (resource->GetDesc().Width >= data_desc.RowPitch)
-				{
-					upload_resource = resource;
-					break;
-				}
-			}*/
-
-			if (!upload_resource)
-			{
-				auto heap_prop = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-				auto buff_desc = CD3DX12_RESOURCE_DESC::Buffer(data_desc.RowPitch);
-
-				ThrowIfFailed(mDevice->GetDevice()->CreateCommittedResource(
-					&heap_prop,
-					D3D12_HEAP_FLAG_NONE,
-					&buff_desc,
-					D3D12_RESOURCE_STATE_GENERIC_READ,
-					nullptr,
-					IID_PPV_ARGS(&upload_resource)));
-				mTempUploadResources.push_back(upload_resource);
-			}
-
-			UpdateSubresources<1>(cl, mResource.Get(), upload_resource.Get(), 0, 0, 1, &data_desc);
-
-			Transition(cl, new_states);
+			CopyFromMemory(cl, buffer, buffer_size * sizeof(T), new_states);
 		}
 
 		template<typename T>
@@ -79,24 +59,62 @@ namespace FrameDX12
 			FillFromBuffer(cl, buffer.data(), buffer.size(), new_states);
 		}
 
-		void Transition(ID3D12GraphicsCommandList* cl, D3D12_RESOURCE_STATES new_states);
+		// Copies a range of the buffer back to the CPU through the readback ring of the list queue. The future resolves when the GPU is done
+		// The resource is moved to COPY_SOURCE, unless it's on an upload heap. Only for buffers
+		ReadbackFuture ReadbackBuffer(ID3D12GraphicsCommandList* cl, uint64_t offset, uint64_t size_in_bytes);
+		// Same for a subresource of a texture. Use the footprint of the data to find the rows
+		ReadbackFuture ReadbackTexture(ID3D12GraphicsCommandList* cl, UINT subresource = 0);
+
+		// States are tracked per subresource through the ResourceStateTracker of the list, so it's safe to call from parallel workers of a CommandGraph
+		// Also marks the resource as used for the ResidencyManager
+		// The first Transition of a placed render target or depth buffer on a direct list discards it. If it's used on other lists first,
+		//  clear it or copy over all of it before anything else
+		void Transition(ID3D12GraphicsCommandList* cl, D3D12_RESOURCE_STATES new_states, UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+
+		// Tells the device ResidencyManager that the lists being recorded use the resource, so it's not evicted (or it's made resident again)
+		// Transition and the view getters already call it. Only needed for resources reached in other ways, like a bindless index stored on a buffer
+		void MarkUsed() const
+		{
+			if (mResidency) mDevice->GetResidencyManager().MarkUsed(mResidency);
+		}
+
+		// Same, and also remembers the queue of the list, so releasing the resource waits for that queue even if it's idle by then
+		void MarkUsed(ID3D12GraphicsCommandList* cl) const
+		{
+			MarkUsed();
+			// QueueType uses the same values as the command list types
+			mStates->used_queues |= mDevice->GetQueueBit((QueueType)cl->GetType());
+		}
+
+		Descriptor GetDSV() const { MarkUsed(); return mDSV; }
+		Descriptor GetSRV() const { MarkUsed(); return mSRV; }
+		Descriptor GetCBV() const { MarkUsed(); return mCBV; }
+		Descriptor GetUAV() const { MarkUsed(); return mUAV; }
 
-		Descriptor GetDSV() const { return mDSV; }
-		Descriptor GetSRV() const { return mSRV; }
-		Descriptor GetCBV() const { return mCBV; }
-		Descriptor GetUAV() const { return mUAV; }
+		// Indexes on the bindless range. Only valid if the device has bindless enabled
+		uint32_t GetSRVIndex() const { return *mSRVIndex; }
+		uint32_t GetUAVIndex() const { return *mUAVIndex; }
 
 		const CD3DX12_RESOURCE_DESC& GetDesc() const { return mDescription; }
+		// Global states, for code that batches the transitions of many resources (see ResourceStateTracker)
+		ResourceStates& GetStates() const { return *mStates; }
+		Device* GetDevice() const { return mDevice; }
 		ID3D12Resource* operator->() { return mResource.Get(); }
+		ID3D12Resource* Get() const { return mResource.Get(); }
 	protected:
-		static thread_local std::vector<ComPtr<ID3D12Resource>> mTempUploadResources;
+		// Hands the resource and its heap range to the deferred release queue
+		void ReleaseResource();
 
-		Device* mDevice;
+		Device* mDevice = nullptr;
 
+		PlacedAllocation mPlacement; // Needs to be released after the resource
 		ComPtr<ID3D12Resource> mResource;
-		D3D12_RESOURCE_STATES mStates;
+		std::unique_ptr<ResourceStates> mStates; // On the heap, so moving the resource doesn't break the trackers
+		ResidencyManager::Object* mResidency = nullptr; // The heap one for placed resources, otherwise owned by the resource
 		CD3DX12_RESOURCE_DESC mDescription;
+		D3D12_HEAP_TYPE mHeapType = D3D12_HEAP_TYPE_DEFAULT;
 
 		Descriptor mDSV, mSRV, mCBV, mUAV;
+		BindlessIndex mSRVIndex, mUAVIndex;
 	};
 }
\ No newline at end of file
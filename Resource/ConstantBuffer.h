@@ -2,11 +2,14 @@
 #include "../Core/stdafx.h"
 #include "../Device/Device.h"
 #include "CommitedResource.h"
+#include "BufferedResource.h"
 
 namespace FrameDX12
 {
 	// Constant buffer of the specified type that remains mapped for updates
 	// There's an optional Count creation parameter to create an array of CBs that use the same underlying resource
+	// The resource has a copy of the array per buffered frame, and the CPU only writes the copy of the current frame, so Update never
+	//  races with the GPU reading older frames. The views and addresses returned are the ones of the current frame copy
 	template<typename DataT>
 	class ConstantBuffer
 	{
@@ -14,31 +17,83 @@ namespace FrameDX12
 	public:
 		void Create(Device * device, size_t count = 1)
 		{
-			mResource.Create(device, CD3DX12_RESOURCE_DESC::Buffer(sizeof(DataT) * count), D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, D3D12_HEAP_TYPE_UPLOAD);
+			mDevice = device;
+			mCount = count;
+			mData.resize(count);
+			mCopies.Initialize(count);
+
+			mResource.Create(device, CD3DX12_RESOURCE_DESC::Buffer(sizeof(DataT) * count * kResourceBufferCount), D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, D3D12_HEAP_TYPE_UPLOAD);
 			CD3DX12_RANGE readRange(0, 0);        // We do not intend to read from this resource on the CPU.
 			mResource->Map(0, &readRange, reinterpret_cast<void**>(&mMappedMem));
 
-			mViews.resize(count);
-			for (size_t idx = 0; idx < count;++idx)
+			mViews.Construct([&](uint8_t copy)
 			{
-				mViews[idx] = device->GetDescriptorPool(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV).GetNextDescriptor();
+				std::vector<Descriptor> views(count);
+				for (size_t idx = 0; idx < count; ++idx)
+				{
+					views[idx] = device->GetDescriptorPool(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV).GetNextDescriptor();
+
+					D3D12_CONSTANT_BUFFER_VIEW_DESC desc = {};
+					desc.SizeInBytes = sizeof(DataT);
+					desc.BufferLocation = GetCopyAddress(copy, idx);
 
-				D3D12_CONSTANT_BUFFER_VIEW_DESC desc = {};
-				desc.SizeInBytes = sizeof(DataT);
-				desc.BufferLocation = mResource->GetGPUVirtualAddress() + idx * sizeof(DataT);
+					device->GetDevice()->CreateConstantBufferView(&desc, *views[idx]);
+				}
+				return views;
+			});
+		}
+
+		Descriptor GetView(size_t index = 0)
+		{
+			Sync();
+			mResource.MarkUsed();
+			return (*mViews)[index];
+		}
 
-				device->GetDevice()->CreateConstantBufferView(&desc, *mViews[idx]);
-			}
+		// For root CBVs
+		D3D12_GPU_VIRTUAL_ADDRESS GetGPUAddress(size_t index = 0)
+		{
+			Sync();
+			mResource.MarkUsed();
+			return GetCopyAddress(BufferedCopiesTracker::GetCurrentCopy(), index);
 		}
 
-		Descriptor GetView(size_t index = 0) const { return mViews[index]; }
 		void Update(const DataT& new_data, size_t index = 0)
 		{
-			memcpy(mMappedMem + index, &new_data, sizeof(DataT));
+			auto lock = mCopies.SyncAndLock(mDevice->GetFrameNumber(), WriteFunction());
+
+			mData[index] = new_data;
+			// A plain copy, constants are too small for StreamingCopy to pay off and its fence per call costs more than the copy
+			memcpy(mMappedMem + BufferedCopiesTracker::GetCurrentCopy() * mCount + index, &new_data, sizeof(DataT));
+			mCopies.MarkWritten(index);
 		}
 	private:
+		D3D12_GPU_VIRTUAL_ADDRESS GetCopyAddress(uint8_t copy, size_t index) const
+		{
+			return mResource.Get()->GetGPUVirtualAddress() + (copy * mCount + index) * sizeof(DataT);
+		}
+
+		// The copy of the current frame gets the elements updated on other frames
+		void Sync()
+		{
+			mCopies.Sync(mDevice->GetFrameNumber(), WriteFunction());
+		}
+
+		auto WriteFunction()
+		{
+			return [this](uint8_t copy, size_t index)
+			{
+				memcpy(mMappedMem + copy * mCount + index, &mData[index], sizeof(DataT));
+			};
+		}
+
+		Device* mDevice = nullptr;
 		CommitedResource mResource;
-		std::vector<Descriptor> mViews;
+		BufferedResource<std::vector<Descriptor>> mViews;
+		size_t mCount = 0;
+
+		std::vector<DataT> mData; // Latest values, the copies of other frames get them from here
+		BufferedCopiesTracker mCopies;
 
 		// Write only memory
 		DataT* mMappedMem;
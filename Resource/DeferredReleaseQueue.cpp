@@ -0,0 +1,57 @@
+#include "DeferredReleaseQueue.h"
+
+using namespace FrameDX12;
+
+DeferredReleaseQueue::~DeferredReleaseQueue()
+{
+	Node* node = mHead.exchange(nullptr);
+	while (node)
+	{
+		Node* next = node->next;
+		delete node;
+		node = next;
+	}
+
+	for (Node* waiting : mWaiting)
+		delete waiting;
+}
+
+void DeferredReleaseQueue::Push(Node* node)
+{
+	++mPendingCount;
+
+	node->next = mHead.load(std::memory_order_relaxed);
+	while (!mHead.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed));
+}
+
+size_t DeferredReleaseQueue::Drain(const FenceValues& completed)
+{
+	std::scoped_lock lock(mDrainLock);
+
+	// Only the drain pops, so taking the whole stack at once avoids the ABA problem
+	for (Node* node = mHead.exchange(nullptr, std::memory_order_acquire); node; node = node->next)
+		mWaiting.push_back(node);
+
+	size_t released = 0;
+	size_t kept = 0;
+	for (Node* node : mWaiting)
+	{
+		bool done = true;
+		for (int queue = 0; queue < kQueueCount; queue++)
+			done &= node->fences.values[queue] <= completed.values[queue];
+
+		if (done)
+		{
+			delete node;
+			++released;
+		}
+		else
+		{
+			mWaiting[kept++] = node;
+		}
+	}
+	mWaiting.resize(kept);
+
+	mPendingCount -= released;
+	return released;
+}
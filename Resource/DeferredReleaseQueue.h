@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+// No D3D on this file, the queues are just indexes and the fences just values, so it can be used against fake fences
+
+namespace FrameDX12
+{
+	// Keeps objects alive until the GPU is done with them, and destroys them after
+	// Each object is tagged with a fence value per queue, and it's destroyed once all of them completed
+	// Any object works, what "release" means is up to its destructor (ComPtr, PlacedAllocation, a descriptor index, etc)
+	// Enqueue is lock free so any thread can retire objects. Drain is meant to be called once per frame
+	class DeferredReleaseQueue
+	{
+	public:
+		static constexpr int kQueueCount = 3;
+
+		// Zero means the queue is not used
+		struct FenceValues
+		{
+			uint64_t values[kQueueCount] = {};
+		};
+
+		DeferredReleaseQueue() = default;
+		DeferredReleaseQueue(const DeferredReleaseQueue&) = delete;
+		DeferredReleaseQueue& operator=(const DeferredReleaseQueue&) = delete;
+		// Destroys everything still queued, the owner needs to make sure the GPU is done before
+		~DeferredReleaseQueue();
+
+		template<typename T>
+		void Enqueue(const FenceValues& fences, T&& object)
+		{
+			Push(new TypedNode<std::decay_t<T>>(fences, std::forward<T>(object)));
+		}
+
+		// Destroys the objects whose fences are all completed
+		// Returns the number of objects destroyed
+		size_t Drain(const FenceValues& completed);
+
+		// Objects waiting to be destroyed
+		size_t GetPendingCount() const { return mPendingCount; }
+	private:
+		struct Node
+		{
+			Node(const FenceValues& fences) : fences(fences) {}
+			virtual ~Node() = default;
+
+			Node* next = nullptr;
+			FenceValues fences;
+		};
+
+		template<typename T>
+		struct TypedNode : Node
+		{
+			TypedNode(const FenceValues& fences, T&& object) : Node(fences), object(std::move(object)) {}
+			TypedNode(const FenceValues& fences, const T& object) : Node(fences), object(object) {}
+
+			T object;
+		};
+
+		void Push(Node* node);
+
+		std::atomic<Node*> mHead = nullptr; // Lock free stack the producers push to. Drain takes it whole
+		std::atomic<size_t> mPendingCount = 0;
+
+		std::mutex mDrainLock;
+		std::vector<Node*> mWaiting; // Taken from the stack but not completed yet
+	};
+}
@@ -4,33 +4,79 @@
 
 using namespace FrameDX12;
 
-void DescriptorPool::Initialize(class Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, bool is_shader_visible, UINT size)
+std::atomic<uint64_t> DescriptorPool::sNextDescriptorId = 0;
+
+void DescriptorPool::Initialize(class Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, bool is_shader_visible, UINT page_size)
 {
 	mDevicePtr = device;
+	mType = type;
+	mIsShaderVisible = is_shader_visible;
+
+	mEntrySize = device->GetDevice()->GetDescriptorHandleIncrementSize(type);
+	mCurrentTop = 0;
+	mPageSize = page_size;
+	mRateWindowStart = std::chrono::steady_clock::now();
+
+	std::scoped_lock lock(mLock);
+	ThrowIfFalse(AddPage());
+}
+
+bool DescriptorPool::AddPage()
+{
+	UINT page_idx = mPageCount;
+	if (page_idx == kMaxPages)
+		return false;
 
 	D3D12_DESCRIPTOR_HEAP_DESC desc;
 	desc.NodeMask = 0;
-	desc.NumDescriptors = size;
-	desc.Type = type;
-	desc.Flags = is_shader_visible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-	ThrowIfFailed(mDevicePtr->GetDevice()->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&mHeap)));
+	desc.NumDescriptors = mPageSize;
+	desc.Type = mType;
+	desc.Flags = mIsShaderVisible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	if (LogCheckAndContinue(mDevicePtr->GetDevice()->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&mPages[page_idx].heap)), LogCategory::Error) != StatusCode::Ok)
+		return false;
 
-	mEntrySize = device->GetDevice()->GetDescriptorHandleIncrementSize(type);
-	mCurrentTop = 0;
-	mSize = size;
-	mCPUHeapStart = mHeap->GetCPUDescriptorHandleForHeapStart();
-	mGPUHeapStart = mHeap->GetGPUDescriptorHandleForHeapStart();
+	mPages[page_idx].cpu_start = mPages[page_idx].heap->GetCPUDescriptorHandleForHeapStart();
+	if (mIsShaderVisible)
+		mPages[page_idx].gpu_start = mPages[page_idx].heap->GetGPUDescriptorHandleForHeapStart();
+
+	// Only publish the page once it's fully written
+	mPageCount = page_idx + 1;
+
+	if (page_idx > 0)
+		LogMsg(std::wstring(L"Descriptor pool of type ") + std::to_wstring(mType) + L" grew to " + std::to_wstring(page_idx + 1) + L" pages", LogCategory::Info);
+
+	return true;
 }
 
 DescriptorPool::~DescriptorPool()
 {
-	mHeap->Release();
+	for (UINT page_idx = 0; page_idx < mPageCount; page_idx++)
+		mPages[page_idx].heap->Release();
+}
+
+DescriptorPool::Stats DescriptorPool::GetStats()
+{
+	std::scoped_lock lock(mLock);
+
+	Stats stats;
+	stats.page_count = mPageCount;
+	stats.capacity = mPageCount * mPageSize;
+	stats.used = mUsedCount;
+	stats.high_water_mark = mHighWaterMark;
+	stats.free_list_length = (UINT)mFreeIndexes.size();
+	stats.fragmentation = mCurrentTop > 0 ? stats.free_list_length / (float)mCurrentTop : 0.0f;
+	stats.allocation_rate = mAllocationRate;
+	stats.total_allocations = mTotalAllocations;
+	stats.failed_allocations = mFailedAllocations;
+
+	return stats;
 }
 
 Descriptor::Descriptor(Descriptor&& other) :
 	  mRefCount(std::exchange(other.mRefCount, nullptr))
 	, mPool(std::exchange(other.mPool, nullptr))
 	, mIndex(std::exchange(other.mIndex, -1))
+	, mId(std::exchange(other.mId, 0))
 {
 }
 
@@ -39,6 +85,7 @@ Descriptor& Descriptor::operator=(Descriptor&& rhs)
 	mRefCount = std::exchange(rhs.mRefCount, nullptr);
 	mPool = std::exchange(rhs.mPool, nullptr);
 	mIndex = std::exchange(rhs.mIndex, -1);
+	mId = std::exchange(rhs.mId, 0);
 
 	return *this;
 }
@@ -47,6 +94,7 @@ Descriptor::Descriptor() :
 	  mRefCount(new std::atomic_int(1))
 	, mPool(nullptr)
 	, mIndex(-1)
+	, mId(0)
 {
 }
 
@@ -60,6 +108,7 @@ Descriptor& Descriptor::operator=(const Descriptor& rhs)
 	mRefCount = rhs.mRefCount;
 	mPool = rhs.mPool;
 	mIndex = rhs.mIndex;
+	mId = rhs.mId;
 
 	(*mRefCount)++;
 
@@ -70,50 +119,93 @@ Descriptor::~Descriptor()
 {
 	if (mPool != nullptr && mRefCount != nullptr && mRefCount->fetch_sub(1) == 1)
 	{
-		std::scoped_lock lock(mPool->mLock);
-
-		mPool->mFreeIndexes.push(mIndex);
+		// CPU only pools are staging, the GPU never reads them and the shader visible heaps copy the descriptors before submitting,
+		//  so the index can be reused right away. Command lists in flight can still reference the shader visible ones
+		if (mPool->IsShaderVisible())
+			mPool->mDevicePtr->DeferRelease(DescriptorPool::RetiredIndex(mPool, mIndex));
+		else
+			mPool->FreeIndex(mIndex);
 		delete mRefCount;
 	}
 }
 
+void DescriptorPool::FreeIndex(INT index)
+{
+	std::scoped_lock lock(mLock);
+
+	mFreeIndexes.push(index);
+	--mUsedCount;
+}
+
 CD3DX12_CPU_DESCRIPTOR_HANDLE Descriptor::operator*()
 {
-	return CD3DX12_CPU_DESCRIPTOR_HANDLE(mPool->mCPUHeapStart, mIndex, mPool->mEntrySize);
+	auto& page = mPool->mPages[mIndex / mPool->mPageSize];
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(page.cpu_start, mIndex % mPool->mPageSize, mPool->mEntrySize);
 }
 CD3DX12_GPU_DESCRIPTOR_HANDLE Descriptor::GetGPUDescriptor()
 {
-	return CD3DX12_GPU_DESCRIPTOR_HANDLE(mPool->mGPUHeapStart, mIndex, mPool->mEntrySize);
+	if (!LogAssertAndContinue(mPool->mIsShaderVisible, LogCategory::Error))
+		return CD3DX12_GPU_DESCRIPTOR_HANDLE(D3D12_DEFAULT);
+
+	auto& page = mPool->mPages[mIndex / mPool->mPageSize];
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(page.gpu_start, mIndex % mPool->mPageSize, mPool->mEntrySize);
+}
+
+D3D12_DESCRIPTOR_HEAP_TYPE Descriptor::GetType() const
+{
+	return mPool->mType;
 }
 
 bool Descriptor::IsValid() const
 {
-	return (mPool != nullptr) && (mPool->GetHeap() != nullptr);
+	return (mPool != nullptr) && (mIndex >= 0);
 }
 
 Descriptor DescriptorPool::GetNextDescriptor()
 {
+	using namespace std::chrono;
+
 	Descriptor handle;
 
-	if (!LogAssertAndContinue(mHeap != nullptr, LogCategory::Error))
-		return handle;
+	std::scoped_lock lock(mLock);
 
 	if (mFreeIndexes.empty())
 	{
-		if (!LogAssertAndContinue(mCurrentTop < mSize, LogCategory::Error))
-			return handle;
+		// Shader visible pools can't grow, see the class comment
+		if (mCurrentTop == mPageCount * mPageSize)
+		{
+			if (!LogAssertAndContinue(!mIsShaderVisible && AddPage(), LogCategory::Error))
+			{
+				++mFailedAllocations;
+				return handle;
+			}
+		}
 
 		handle.mPool = this;
-		handle.mIndex = mCurrentTop.fetch_add(1);
+		handle.mIndex = mCurrentTop++;
 	}
 	else
 	{
-		std::scoped_lock lock(mLock);
-
 		handle.mPool = this;
 		handle.mIndex = mFreeIndexes.front();
 		mFreeIndexes.pop();
 	}
+	handle.mId = ++sNextDescriptorId;
+
+	++mUsedCount;
+	mHighWaterMark = std::max(mHighWaterMark, mUsedCount);
+	++mTotalAllocations;
+
+	// Update the allocation rate once per second
+	++mRateWindowAllocations;
+	auto now = steady_clock::now();
+	auto window_length = duration_cast<duration<float>>(now - mRateWindowStart).count();
+	if (window_length >= 1.0f)
+	{
+		mAllocationRate = mRateWindowAllocations / window_length;
+		mRateWindowAllocations = 0;
+		mRateWindowStart = now;
+	}
 
 	return handle;
 }
@@ -18,38 +18,110 @@ namespace FrameDX12
 		Descriptor& operator=(Descriptor&&);
 		
 		CD3DX12_CPU_DESCRIPTOR_HANDLE operator*();
+		// Only valid for descriptors from a shader visible pool
+		// Views on the staging pools need to be copied to a table first, see ShaderVisibleHeap
 		CD3DX12_GPU_DESCRIPTOR_HANDLE GetGPUDescriptor();
 
+		// Unique for every descriptor returned by GetNextDescriptor, shared by copies of it
+		// Unlike the index it's never reused, so it can be used to identify the view written on it
+		uint64_t GetId() const { return mId; }
+		D3D12_DESCRIPTOR_HEAP_TYPE GetType() const;
+
 		bool IsValid() const;
 	private:
 		std::atomic_int * mRefCount;
 		DescriptorPool* mPool;
 		INT mIndex;
+		uint64_t mId;
 	};
 	
-	// Manages a fixed size heap providing access to descriptors on it and reusing unused indexes
+	// Manages a set of heaps (pages) providing access to descriptors on them and reusing unused indexes
 	// It returns a wrapper of CD3DX12_CPU_DESCRIPTOR_HANDLE which dereferences the heap on access and keeps track of references count
+	// ------------------------------------------------------------------------------------------------------------------
+	// Released indexes of shader visible pools go through the device deferred release queue, so they are only reused once the GPU is done
+	//  with the work that can reference them. CPU only pools reuse them right away, as the GPU never reads those
+	// CPU only pools grow by adding a new page when they run out of space, up to kMaxPages
+	// Shader visible pools never grow, as only one heap of each type can be bound at a time. Running out logs an error,
+	//  increases the failed allocations counter and returns an invalid descriptor
 	class DescriptorPool
 	{
 	public:
+		static constexpr UINT kMaxPages = 64;
+
+		// Occupancy telemetry, to size the pages from real data
+		struct Stats
+		{
+			UINT page_count;
+			UINT capacity; // Descriptors on all the current pages
+			UINT used; // Live descriptors, plus the released ones still waiting for the GPU
+			UINT high_water_mark; // Max number of live descriptors ever
+			UINT free_list_length; // Indexes released and waiting to be reused
+			float fragmentation; // Fraction of the touched range that is on the free list
+			float allocation_rate; // Allocations per second, measured over the last full second
+			uint64_t total_allocations;
+			uint64_t failed_allocations;
+		};
+
 		~DescriptorPool();
-		void Initialize(class Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, bool is_shader_visible, UINT size);
+		// page_size is the number of descriptors on each heap. Shader visible pools only have one page
+		void Initialize(class Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, bool is_shader_visible, UINT page_size);
 
 		Descriptor GetNextDescriptor();
-		ID3D12DescriptorHeap* GetHeap() const { return mHeap; }
+		// Returns the first page. For shader visible pools that's the only heap
+		ID3D12DescriptorHeap* GetHeap() const { return mPages[0].heap; }
+		D3D12_DESCRIPTOR_HEAP_TYPE GetType() const { return mType; }
+		bool IsShaderVisible() const { return mIsShaderVisible; }
+
+		// Thread safe
+		Stats GetStats();
 	private:
 		friend Descriptor;
 
+		// Adds a new page. Needs to be called with the lock taken
+		bool AddPage();
+
+		// Owns a released index, it goes back to the free list when destroyed
+		struct RetiredIndex
+		{
+			RetiredIndex(DescriptorPool* pool, INT index) : pool(pool), index(index) {}
+			RetiredIndex(RetiredIndex&& other) : pool(std::exchange(other.pool, nullptr)), index(other.index) {}
+			~RetiredIndex() { if (pool) pool->FreeIndex(index); }
+
+			DescriptorPool* pool;
+			INT index;
+		};
+		void FreeIndex(INT index);
+
+		// Source for the descriptors ids, shared by all the pools
+		static std::atomic<uint64_t> sNextDescriptorId;
+
+		D3D12_DESCRIPTOR_HEAP_TYPE mType;
+		bool mIsShaderVisible;
+
 		std::mutex mLock;
 		std::queue<INT> mFreeIndexes;
 
-		ID3D12DescriptorHeap* mHeap = nullptr;
-		D3D12_CPU_DESCRIPTOR_HANDLE mCPUHeapStart;
-		D3D12_GPU_DESCRIPTOR_HANDLE mGPUHeapStart;
+		// Fixed array so descriptors can read the pages without locking while a new page is added
+		struct Page
+		{
+			ID3D12DescriptorHeap* heap = nullptr;
+			D3D12_CPU_DESCRIPTOR_HANDLE cpu_start;
+			D3D12_GPU_DESCRIPTOR_HANDLE gpu_start;
+		} mPages[kMaxPages];
+		std::atomic<UINT> mPageCount = 0;
 
 		UINT mEntrySize;
-		UINT mSize;
-		std::atomic<UINT> mCurrentTop;
+		UINT mPageSize;
+		UINT mCurrentTop;
+
+		// Telemetry
+		UINT mUsedCount = 0;
+		UINT mHighWaterMark = 0;
+		uint64_t mTotalAllocations = 0;
+		uint64_t mFailedAllocations = 0;
+		uint64_t mRateWindowAllocations = 0;
+		std::chrono::steady_clock::time_point mRateWindowStart;
+		float mAllocationRate = 0;
 		
 		class Device* mDevicePtr;
 	};
@@ -0,0 +1,123 @@
+#include "FrameConstantAllocator.h"
+#include "BufferedResource.h"
+#include "../Device/Device.h"
+#include "../Core/Log.h"
+
+using namespace FrameDX12;
+
+namespace
+{
+	// Chunk the thread is allocating from. Dropped when the frame changes or the thread uses another allocator
+	struct ThreadChunk
+	{
+		const FrameConstantAllocator* owner = nullptr;
+		uint64_t frame_number = 0;
+		FrameConstantAllocator::Allocation next = {};
+		uint64_t remaining = 0;
+	};
+	thread_local ThreadChunk tChunk;
+
+	uint64_t AlignConstantSize(uint64_t size)
+	{
+		constexpr uint64_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+		return (size + alignment - 1) / alignment * alignment;
+	}
+}
+
+FrameConstantAllocator::FrameConstantAllocator(Device* device) :
+	mRegions{
+		{ kRegionSize, kOverflowPageSize, [this](uint64_t size) { return CreateOverflowPage(size); } },
+		{ kRegionSize, kOverflowPageSize, [this](uint64_t size) { return CreateOverflowPage(size); } },
+		{ kRegionSize, kOverflowPageSize, [this](uint64_t size) { return CreateOverflowPage(size); } } },
+	mDevice(device)
+{
+}
+
+void FrameConstantAllocator::CreateResource()
+{
+	auto heap_props = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	auto buffer_desc = CD3DX12_RESOURCE_DESC::Buffer(kRegionSize * kResourceBufferCount);
+	ThrowIfFailed(mDevice->GetDevice()->CreateCommittedResource(
+		&heap_props,
+		D3D12_HEAP_FLAG_NONE,
+		&buffer_desc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&mResource)));
+
+	CD3DX12_RANGE empty_range(0, 0); // Write only
+	ThrowIfFailed(mResource->Map(0, &empty_range, reinterpret_cast<void**>(&mMappedMem)));
+}
+
+FrameConstantAllocator::Allocation FrameConstantAllocator::Allocate(uint64_t size)
+{
+	size = AlignConstantSize(size);
+
+	uint64_t frame_number = mFrameNumber.load(std::memory_order_relaxed);
+	if (tChunk.owner != this || tChunk.frame_number != frame_number || tChunk.remaining < size)
+	{
+		tChunk.owner = this;
+		tChunk.frame_number = frame_number;
+		tChunk.next = GetChunk(size, tChunk.remaining);
+	}
+
+	Allocation allocation = tChunk.next;
+	tChunk.next.cpu_ptr += size;
+	tChunk.next.gpu_address += size;
+	tChunk.remaining -= size;
+
+	return allocation;
+}
+
+FrameConstantAllocator::Allocation FrameConstantAllocator::GetChunk(uint64_t min_size, uint64_t& chunk_size)
+{
+	std::call_once(mCreated, [this]() { CreateResource(); });
+
+	chunk_size = std::max(min_size, kChunkSize);
+
+	auto chunk = mRegions[mCurrentRegion].TakeChunk(chunk_size);
+	if (!chunk.page)
+	{
+		uint64_t offset = mCurrentRegion * kRegionSize + chunk.offset;
+		return { mMappedMem + offset, mResource->GetGPUVirtualAddress() + offset };
+	}
+
+	return { chunk.page->cpu_ptr + chunk.offset, chunk.page->resource->GetGPUVirtualAddress() + chunk.offset };
+}
+
+FrameConstantAllocator::OverflowPage FrameConstantAllocator::CreateOverflowPage(uint64_t size)
+{
+	LogMsg(L"Frame constants region full, adding an overflow page", LogCategory::Warning);
+
+	OverflowPage page;
+
+	auto heap_props = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	auto buffer_desc = CD3DX12_RESOURCE_DESC::Buffer(size);
+	ThrowIfFailed(mDevice->GetDevice()->CreateCommittedResource(
+		&heap_props,
+		D3D12_HEAP_FLAG_NONE,
+		&buffer_desc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&page.resource)));
+
+	CD3DX12_RANGE empty_range(0, 0);
+	ThrowIfFailed(page.resource->Map(0, &empty_range, reinterpret_cast<void**>(&page.cpu_ptr)));
+
+	return page;
+}
+
+void FrameConstantAllocator::AdvanceFrame(uint64_t frame_number)
+{
+	// Device::AdvanceFrame already waited for the frame that used the region of this index
+	mCurrentRegion = sCurrentResourceBufferIndex;
+	mRegions[mCurrentRegion].Reset();
+
+	// Drops the chunks of the threads, which belong to the previous region
+	mFrameNumber.store(frame_number, std::memory_order_relaxed);
+}
+
+uint64_t FrameConstantAllocator::GetUsedBytes() const
+{
+	return mRegions[mCurrentRegion].GetUsedBytes();
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "../Core/stdafx.h"
+#include "FrameRegion.h"
+
+namespace FrameDX12
+{
+	// Linear allocator for constants that only live for a frame, like per draw data, on a persistently mapped upload buffer
+	// Each buffered frame has its own region, reset when the frame comes around again. Device::AdvanceFrame waits for the GPU to finish the
+	//  frame that used it kResourceBufferCount frames ago before that
+	// Threads take chunks of the region with an atomic add and then bump allocate on their own chunk, so allocating doesn't lock or contend
+	// The GPU address can go straight to SetGraphicsRootConstantBufferView, no descriptors or ConstantBuffer needed
+	// If a region runs out, the frame gets extra pages. They stay with the region and are reused when it overflows again
+	// Thread safe, except for AdvanceFrame
+	class FrameConstantAllocator
+	{
+	public:
+		static constexpr uint64_t kRegionSize = 8 * 1024 * 1024;
+		static constexpr uint64_t kChunkSize = 64 * 1024;
+		static constexpr uint64_t kOverflowPageSize = 4 * 1024 * 1024;
+
+		struct Allocation
+		{
+			uint8_t* cpu_ptr; // Write only memory
+			D3D12_GPU_VIRTUAL_ADDRESS gpu_address;
+		};
+
+		FrameConstantAllocator(class Device* device);
+
+		// Aligned to D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT. Only valid for the current frame
+		Allocation Allocate(uint64_t size);
+
+		// Allocates and copies the data, returning the GPU address
+		// A plain copy, constants are too small for StreamingCopy to pay off and its fence per call costs more than the copy
+		template<typename T>
+		D3D12_GPU_VIRTUAL_ADDRESS Push(const T& data)
+		{
+			Allocation allocation = Allocate(sizeof(T));
+			memcpy(allocation.cpu_ptr, &data, sizeof(T));
+			return allocation.gpu_address;
+		}
+
+		// Resets the region of the new frame. Called by Device::AdvanceFrame, nothing can be allocating at the same time
+		void AdvanceFrame(uint64_t frame_number);
+
+		// Bytes handed out to chunks on the current frame, counting the overflow pages
+		uint64_t GetUsedBytes() const;
+	private:
+		// Takes a chunk of at least kChunkSize bytes of the current region, or of an overflow page if it's full
+		Allocation GetChunk(uint64_t min_size, uint64_t& chunk_size);
+		void CreateResource();
+
+		struct OverflowPage
+		{
+			ComPtr<ID3D12Resource> resource;
+			uint8_t* cpu_ptr;
+		};
+		OverflowPage CreateOverflowPage(uint64_t size);
+
+		std::once_flag mCreated;
+		ComPtr<ID3D12Resource> mResource; // A region per buffered frame, one after the other
+		uint8_t* mMappedMem = nullptr;
+
+		FrameRegion<OverflowPage> mRegions[3]; // kResourceBufferCount
+		uint8_t mCurrentRegion = 0;
+		std::atomic<uint64_t> mFrameNumber = 0;
+
+		class Device* mDevice;
+	};
+}
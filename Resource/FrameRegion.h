@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <functional>
+#include <algorithm>
+
+// No D3D on this file, the pages are opaque so the policy can be tested on its own
+
+namespace FrameDX12
+{
+	// Chunks of the memory of one buffered frame, as handed out by the FrameConstantAllocator
+	// Chunks come from the region with an atomic add. When it's full they come from overflow pages, created through a callback
+	// Overflow pages are kept when the region is reset, and reused by the next frames that overflow
+	// Thread safe, except for Reset
+	template<typename Page>
+	class FrameRegion
+	{
+	public:
+		struct Chunk
+		{
+			const Page* page; // Null for the region itself
+			uint64_t offset; // On the region or on the page
+		};
+
+		// create_page(size) returns the data of a new overflow page of at least that size
+		FrameRegion(uint64_t region_size, uint64_t overflow_page_size, std::function<Page(uint64_t)> create_page) :
+			mRegionSize(region_size),
+			mOverflowPageSize(overflow_page_size),
+			mCreatePage(std::move(create_page))
+		{}
+
+		Chunk TakeChunk(uint64_t size)
+		{
+			uint64_t start = mTop.fetch_add(size, std::memory_order_relaxed);
+			if (start + size <= mRegionSize)
+				return { nullptr, start };
+
+			// The region is full, go to the overflow pages
+			std::scoped_lock lock(mOverflowLock);
+
+			while (mUsedOverflowPages < mOverflowPages.size())
+			{
+				OverflowPage& page = mOverflowPages[mUsedOverflowPages];
+				if (page.top + size <= page.size)
+				{
+					Chunk chunk = { &page.page, page.top };
+					page.top += size;
+					return chunk;
+				}
+				++mUsedOverflowPages;
+			}
+
+			// Appended to a deque, so the pages handed out before keep their address
+			uint64_t page_size = std::max(size, mOverflowPageSize);
+			OverflowPage& added = mOverflowPages.emplace_back(OverflowPage{ mCreatePage(page_size), page_size, size });
+			mUsedOverflowPages = mOverflowPages.size() - 1;
+			return { &added.page, 0 };
+		}
+
+		// Nothing can be taking chunks at the same time
+		void Reset()
+		{
+			mTop.store(0, std::memory_order_relaxed);
+			mUsedOverflowPages = 0;
+			for (OverflowPage& page : mOverflowPages)
+				page.top = 0;
+		}
+
+		// Bytes handed out since the last Reset, counting the overflow pages
+		uint64_t GetUsedBytes() const
+		{
+			uint64_t used = std::min(mTop.load(std::memory_order_relaxed), mRegionSize);
+
+			std::scoped_lock lock(mOverflowLock);
+			for (const OverflowPage& page : mOverflowPages)
+				used += page.top;
+			return used;
+		}
+
+		size_t GetOverflowPagesCount() const
+		{
+			std::scoped_lock lock(mOverflowLock);
+			return mOverflowPages.size();
+		}
+	private:
+		struct OverflowPage
+		{
+			Page page;
+			uint64_t size;
+			uint64_t top;
+		};
+
+		uint64_t mRegionSize;
+		uint64_t mOverflowPageSize;
+		std::function<Page(uint64_t)> mCreatePage;
+
+		std::atomic<uint64_t> mTop = 0;
+
+		mutable std::mutex mOverflowLock;
+		std::deque<OverflowPage> mOverflowPages;
+		size_t mUsedOverflowPages = 0;
+	};
+}
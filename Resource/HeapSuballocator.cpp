@@ -0,0 +1,202 @@
+#include "HeapSuballocator.h"
+#include <algorithm>
+
+using namespace FrameDX12;
+
+BuddyAllocator::BuddyAllocator(uint64_t size, uint64_t min_allocation) :
+	mSize(size),
+	mMinAllocation(min_allocation)
+{
+	mLevelsCount = 1;
+	while ((mSize >> (mLevelsCount - 1)) > mMinAllocation)
+		++mLevelsCount;
+
+	mFreeBlocks.resize(mLevelsCount);
+	mFreeBlocks[0].insert(0);
+}
+
+uint32_t BuddyAllocator::GetLevel(uint64_t size) const
+{
+	// Deepest level that still fits the size
+	uint32_t level = 0;
+	while (level + 1 < mLevelsCount && GetLevelSize(level + 1) >= size)
+		++level;
+	return level;
+}
+
+uint64_t BuddyAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t* allocated_size)
+{
+	// Blocks are aligned to their size, so asking for the alignment as size is enough
+	uint64_t block_size = std::max({ size, alignment, mMinAllocation });
+	if (block_size > mSize)
+		return kInvalidOffset;
+
+	uint32_t level = GetLevel(block_size);
+
+	// Find the smallest free block that fits
+	int32_t source_level = level;
+	while (source_level >= 0 && mFreeBlocks[source_level].empty())
+		--source_level;
+
+	if (source_level < 0)
+		return kInvalidOffset;
+
+	uint64_t offset = *mFreeBlocks[source_level].begin();
+	mFreeBlocks[source_level].erase(mFreeBlocks[source_level].begin());
+
+	// Split it until it's the right size, leaving the second halves free
+	for (uint32_t split_level = source_level + 1; split_level <= level; split_level++)
+		mFreeBlocks[split_level].insert(offset + GetLevelSize(split_level));
+
+	mAllocatedLevels[offset] = level;
+	mAllocatedSize += GetLevelSize(level);
+
+	if (allocated_size) *allocated_size = GetLevelSize(level);
+	return offset;
+}
+
+void BuddyAllocator::Free(uint64_t offset)
+{
+	auto entry = mAllocatedLevels.find(offset);
+	if (entry == mAllocatedLevels.end())
+		return;
+
+	uint32_t level = entry->second;
+	mAllocatedLevels.erase(entry);
+	mAllocatedSize -= GetLevelSize(level);
+
+	// Merge with the buddy while it's free
+	while (level > 0)
+	{
+		uint64_t buddy = offset ^ GetLevelSize(level);
+		auto buddy_entry = mFreeBlocks[level].find(buddy);
+		if (buddy_entry == mFreeBlocks[level].end())
+			break;
+
+		mFreeBlocks[level].erase(buddy_entry);
+		offset = std::min(offset, buddy);
+		--level;
+	}
+
+	mFreeBlocks[level].insert(offset);
+}
+
+uint64_t BuddyAllocator::GetLargestFreeBlock() const
+{
+	for (uint32_t level = 0; level < mLevelsCount; level++)
+	{
+		if (!mFreeBlocks[level].empty())
+			return GetLevelSize(level);
+	}
+	return 0;
+}
+
+HeapSuballocator::HeapSuballocator(uint64_t block_size, uint64_t min_allocation, std::function<bool(uint32_t)> create_block, std::function<void(uint32_t)> release_block) :
+	mBlockSize(block_size),
+	mMinAllocation(min_allocation),
+	mCreateBlock(create_block),
+	mReleaseBlock(release_block)
+{
+}
+
+HeapSuballocator::Allocation HeapSuballocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	std::scoped_lock lock(mLock);
+
+	Allocation allocation;
+	allocation.size = size;
+
+	if (size > mBlockSize || alignment > mBlockSize)
+	{
+		++mFailedAllocations;
+		return allocation;
+	}
+
+	// First fit on the existing blocks, so the memory stays packed on the first ones
+	for (uint32_t block_idx = 0; block_idx < mBlocks.size(); block_idx++)
+	{
+		if (!mBlocks[block_idx])
+			continue;
+
+		uint64_t offset = mBlocks[block_idx]->Allocate(size, alignment, &allocation.allocated_size);
+		if (offset != BuddyAllocator::kInvalidOffset)
+		{
+			allocation.block = block_idx;
+			allocation.offset = offset;
+			break;
+		}
+	}
+
+	if (!allocation.IsValid())
+	{
+		// Need a new block, reuse the index of a released one if possible
+		uint32_t block_idx = 0;
+		while (block_idx < mBlocks.size() && mBlocks[block_idx])
+			++block_idx;
+
+		if (!mCreateBlock(block_idx))
+		{
+			++mFailedAllocations;
+			return allocation;
+		}
+
+		if (block_idx == mBlocks.size())
+			mBlocks.emplace_back();
+		mBlocks[block_idx] = std::make_unique<BuddyAllocator>(mBlockSize, mMinAllocation);
+
+		allocation.block = block_idx;
+		allocation.offset = mBlocks[block_idx]->Allocate(size, alignment, &allocation.allocated_size);
+	}
+
+	mRequestedBytes += size;
+	++mAllocationsCount;
+
+	return allocation;
+}
+
+void HeapSuballocator::Free(const Allocation& allocation)
+{
+	if (!allocation.IsValid())
+		return;
+
+	std::scoped_lock lock(mLock);
+
+	mBlocks[allocation.block]->Free(allocation.offset);
+	mRequestedBytes -= allocation.size;
+	--mAllocationsCount;
+}
+
+void HeapSuballocator::Trim()
+{
+	std::scoped_lock lock(mLock);
+
+	for (uint32_t block_idx = 0; block_idx < mBlocks.size(); block_idx++)
+	{
+		if (mBlocks[block_idx] && mBlocks[block_idx]->IsEmpty())
+		{
+			mBlocks[block_idx].reset();
+			if (mReleaseBlock) mReleaseBlock(block_idx);
+		}
+	}
+}
+
+HeapSuballocator::Stats HeapSuballocator::GetStats()
+{
+	std::scoped_lock lock(mLock);
+
+	Stats stats = {};
+	for (auto& block : mBlocks)
+	{
+		if (!block)
+			continue;
+
+		++stats.blocks_count;
+		stats.reserved_bytes += block->GetSize();
+		stats.allocated_bytes += block->GetAllocatedSize();
+	}
+	stats.requested_bytes = mRequestedBytes;
+	stats.allocations_count = mAllocationsCount;
+	stats.failed_allocations = mFailedAllocations;
+
+	return stats;
+}
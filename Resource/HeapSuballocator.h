@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <mutex>
+#include <memory>
+
+// No D3D on this file, the allocation policy is plain CPU code and can be used against a fake heap
+
+namespace FrameDX12
+{
+	// Buddy allocator over a single block of memory
+	// Allocations are rounded up to a power of two, and are aligned to their (rounded) size
+	class BuddyAllocator
+	{
+	public:
+		static constexpr uint64_t kInvalidOffset = ~0ull;
+
+		// Both sizes need to be powers of two
+		BuddyAllocator(uint64_t size, uint64_t min_allocation);
+
+		// Returns kInvalidOffset if there's no space
+		// allocated_size returns the size actually taken, after rounding
+		uint64_t Allocate(uint64_t size, uint64_t alignment, uint64_t* allocated_size = nullptr);
+		void Free(uint64_t offset);
+
+		uint64_t GetSize() const { return mSize; }
+		uint64_t GetAllocatedSize() const { return mAllocatedSize; }
+		// Size of the biggest allocation that would succeed right now
+		uint64_t GetLargestFreeBlock() const;
+		bool IsEmpty() const { return mAllocatedSize == 0; }
+	private:
+		uint32_t GetLevel(uint64_t size) const; // Level 0 is the whole block
+		uint64_t GetLevelSize(uint32_t level) const { return mSize >> level; }
+
+		uint64_t mSize;
+		uint64_t mMinAllocation;
+		uint32_t mLevelsCount;
+		uint64_t mAllocatedSize = 0;
+
+		std::vector<std::unordered_set<uint64_t>> mFreeBlocks; // Per level
+		std::unordered_map<uint64_t, uint32_t> mAllocatedLevels; // Offset to level
+	};
+
+	// Sub-allocates ranges from a growing set of fixed size blocks (heaps), each managed with a buddy allocator
+	// The blocks are created through a callback, so the actual memory can be anything (an ID3D12Heap on the Device, a fake one to test the policy)
+	// Thread safe
+	class HeapSuballocator
+	{
+	public:
+		struct Allocation
+		{
+			uint32_t block = ~0u;
+			uint64_t offset = 0;
+			uint64_t size = 0; // Requested size
+			uint64_t allocated_size = 0; // Actual size taken, after rounding
+
+			bool IsValid() const { return block != ~0u; }
+		};
+
+		struct Stats
+		{
+			uint32_t blocks_count;
+			uint64_t reserved_bytes; // Memory on all the blocks
+			uint64_t requested_bytes; // Sum of the requested sizes of the live allocations
+			uint64_t allocated_bytes; // Sum of the rounded sizes of the live allocations
+			uint64_t allocations_count;
+			uint64_t failed_allocations;
+
+			// Memory lost to rounding the allocations
+			uint64_t GetInternalWaste() const { return allocated_bytes - requested_bytes; }
+			// Memory reserved but not allocated
+			uint64_t GetUnusedBytes() const { return reserved_bytes - allocated_bytes; }
+		};
+
+		// create_block is called with the index of the new block, and returns false if the block couldn't be created
+		// release_block is called when an empty block is released
+		HeapSuballocator(uint64_t block_size, uint64_t min_allocation, std::function<bool(uint32_t)> create_block, std::function<void(uint32_t)> release_block = nullptr);
+
+		// Sizes bigger than the block size always fail, the caller should handle them on their own
+		Allocation Allocate(uint64_t size, uint64_t alignment);
+		void Free(const Allocation& allocation);
+
+		// Releases the empty blocks. Their indexes can be reused by later blocks
+		void Trim();
+
+		Stats GetStats();
+		uint64_t GetBlockSize() const { return mBlockSize; }
+	private:
+		std::mutex mLock;
+
+		uint64_t mBlockSize;
+		uint64_t mMinAllocation;
+		std::function<bool(uint32_t)> mCreateBlock;
+		std::function<void(uint32_t)> mReleaseBlock;
+
+		std::vector<std::unique_ptr<BuddyAllocator>> mBlocks; // Null for released blocks
+
+		uint64_t mRequestedBytes = 0;
+		uint64_t mAllocationsCount = 0;
+		uint64_t mFailedAllocations = 0;
+	};
+}
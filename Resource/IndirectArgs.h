@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <execution>
+
+// No D3D on this file, the argument generation is plain CPU code and can be built and timed on its own
+
+namespace FrameDX12
+{
+	// One indirect draw, as read by the MeshCollection command signature : a root constant followed by D3D12_DRAW_INDEXED_ARGUMENTS
+	struct IndirectDrawArgs
+	{
+		uint32_t draw_id; // Root constant, the shader uses it to find the data of the draw
+		uint32_t index_count_per_instance;
+		uint32_t instance_count;
+		uint32_t start_index_location;
+		int32_t base_vertex_location;
+		uint32_t start_instance_location;
+	};
+	static_assert(sizeof(IndirectDrawArgs) == 24, "IndirectDrawArgs needs to match the command signature stride");
+
+	struct IndirectDrawItem
+	{
+		uint32_t bucket; // Draws of the same bucket are issued together, so they end up contiguous on the arguments
+		uint32_t draw_id;
+		uint32_t index_count;
+		uint32_t start_index;
+		int32_t base_vertex;
+		uint32_t instance_count;
+	};
+
+	constexpr size_t kIndirectArgsChunkSize = 2048;
+
+	// Writes the arguments of count draws grouped by bucket, keeping the order of the draws inside each bucket
+	// get_item(i) returns the IndirectDrawItem of draw i, it's called twice per draw from several threads
+	// args needs space for count entries, and bucket_offsets for bucket_count + 1. Bucket b goes from bucket_offsets[b] to bucket_offsets[b + 1]
+	// Draws with a bucket out of range are skipped. Returns the number of arguments written
+	// It's a counting sort done in chunks : a histogram per chunk, a prefix sum, and a scatter per chunk
+	// The scatter writes all over args, so it should be cached memory. Write combined memory (like an upload heap) is better filled
+	//  with a sequential copy after
+	template<typename GetItem>
+	size_t BuildIndirectArgs(size_t count, uint32_t bucket_count, GetItem&& get_item, IndirectDrawArgs* args, uint32_t* bucket_offsets)
+	{
+		const size_t chunk_count = (count + kIndirectArgsChunkSize - 1) / kIndirectArgsChunkSize;
+
+		std::vector<uint32_t> chunks(chunk_count);
+		std::iota(chunks.begin(), chunks.end(), 0);
+
+		// [chunk][bucket]
+		std::vector<uint32_t> chunk_offsets(chunk_count * bucket_count, 0);
+
+		std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](uint32_t chunk)
+		{
+			uint32_t* histogram = chunk_offsets.data() + chunk * bucket_count;
+			size_t end = std::min(count, (chunk + 1) * kIndirectArgsChunkSize);
+			for (size_t idx = chunk * kIndirectArgsChunkSize; idx < end; idx++)
+			{
+				uint32_t bucket = get_item(idx).bucket;
+				if (bucket < bucket_count)
+					++histogram[bucket];
+			}
+		});
+
+		// Bucket major, so each bucket is contiguous and the chunks keep their order inside it
+		uint32_t offset = 0;
+		for (uint32_t bucket = 0; bucket < bucket_count; bucket++)
+		{
+			bucket_offsets[bucket] = offset;
+			for (size_t chunk = 0; chunk < chunk_count; chunk++)
+			{
+				uint32_t& entry = chunk_offsets[chunk * bucket_count + bucket];
+				uint32_t chunk_draws = entry;
+				entry = offset;
+				offset += chunk_draws;
+			}
+		}
+		bucket_offsets[bucket_count] = offset;
+
+		std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](uint32_t chunk)
+		{
+			uint32_t* next = chunk_offsets.data() + chunk * bucket_count;
+			size_t end = std::min(count, (chunk + 1) * kIndirectArgsChunkSize);
+			for (size_t idx = chunk * kIndirectArgsChunkSize; idx < end; idx++)
+			{
+				IndirectDrawItem item = get_item(idx);
+				if (item.bucket >= bucket_count)
+					continue;
+
+				IndirectDrawArgs& draw_args = args[next[item.bucket]++];
+				draw_args.draw_id = item.draw_id;
+				draw_args.index_count_per_instance = item.index_count;
+				draw_args.instance_count = item.instance_count;
+				draw_args.start_index_location = item.start_index;
+				draw_args.base_vertex_location = item.base_vertex;
+				draw_args.start_instance_location = 0;
+			}
+		});
+
+		return offset;
+	}
+}
@@ -0,0 +1,105 @@
+#include "InstanceMatrices.h"
+#include <algorithm>
+#include <xmmintrin.h>
+
+using namespace FrameDX12;
+
+void FrameDX12::ComputeInstanceMatrices(const float* const streams[kInstanceStreamCount], size_t first, size_t count, const float view_projection[4][4], float* matrices)
+{
+	__m128 vp[4][4];
+	for (int row = 0; row < 4; row++)
+		for (int column = 0; column < 4; column++)
+			vp[row][column] = _mm_set1_ps(view_projection[row][column]);
+
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+
+	size_t end = first + count;
+	for (size_t base = first; base < end; base += 4)
+	{
+		auto load = [&](int stream) { return _mm_loadu_ps(streams[stream] + base); };
+		__m128 px = load(0), py = load(1), pz = load(2);
+		__m128 qx = load(3), qy = load(4), qz = load(5), qw = load(6);
+		__m128 sx = load(7), sy = load(8), sz = load(9);
+
+		// Same as XMMatrixScaling * XMMatrixRotationQuaternion * XMMatrixTranslation, for 4 instances
+		__m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+		__m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+		__m128 xw = _mm_mul_ps(qx, qw), yw = _mm_mul_ps(qy, qw), zw = _mm_mul_ps(qz, qw);
+
+		__m128 world[3][3] =
+		{
+			{
+				_mm_mul_ps(sx, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)))),
+				_mm_mul_ps(sx, _mm_mul_ps(two, _mm_add_ps(xy, zw))),
+				_mm_mul_ps(sx, _mm_mul_ps(two, _mm_sub_ps(xz, yw)))
+			},
+			{
+				_mm_mul_ps(sy, _mm_mul_ps(two, _mm_sub_ps(xy, zw))),
+				_mm_mul_ps(sy, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)))),
+				_mm_mul_ps(sy, _mm_mul_ps(two, _mm_add_ps(yz, xw)))
+			},
+			{
+				_mm_mul_ps(sz, _mm_mul_ps(two, _mm_add_ps(xz, yw))),
+				_mm_mul_ps(sz, _mm_mul_ps(two, _mm_sub_ps(yz, xw))),
+				_mm_mul_ps(sz, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))))
+			}
+		};
+		__m128 translation[3] = { px, py, pz };
+
+		// WVP = World * ViewProjection. The last column of World is (0, 0, 0, 1)
+		__m128 wvp[4][4];
+		for (int column = 0; column < 4; column++)
+		{
+			for (int row = 0; row < 3; row++)
+			{
+				wvp[row][column] = _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(world[row][0], vp[0][column]),
+					_mm_mul_ps(world[row][1], vp[1][column])),
+					_mm_mul_ps(world[row][2], vp[2][column]));
+			}
+			wvp[3][column] = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(px, vp[0][column]),
+				_mm_mul_ps(py, vp[1][column])),
+				_mm_mul_ps(pz, vp[2][column])),
+				vp[3][column]);
+		}
+
+		// Row r of the transposed matrices is column r of the originals. Transposing the 4x4 block of a column over the 4 lanes
+		//  leaves that row of each instance on its own register
+		__m128 world_rows[4][4]; // [row][instance]
+		__m128 wvp_rows[4][4];
+		for (int row = 0; row < 4; row++)
+		{
+			if (row < 3)
+			{
+				world_rows[row][0] = world[0][row];
+				world_rows[row][1] = world[1][row];
+				world_rows[row][2] = world[2][row];
+				world_rows[row][3] = translation[row];
+				_MM_TRANSPOSE4_PS(world_rows[row][0], world_rows[row][1], world_rows[row][2], world_rows[row][3]);
+			}
+			else
+			{
+				for (int instance = 0; instance < 4; instance++)
+					world_rows[row][instance] = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+			}
+
+			wvp_rows[row][0] = wvp[0][row];
+			wvp_rows[row][1] = wvp[1][row];
+			wvp_rows[row][2] = wvp[2][row];
+			wvp_rows[row][3] = wvp[3][row];
+			_MM_TRANSPOSE4_PS(wvp_rows[row][0], wvp_rows[row][1], wvp_rows[row][2], wvp_rows[row][3]);
+		}
+
+		size_t instances = std::min<size_t>(4, end - base);
+		for (size_t instance = 0; instance < instances; instance++)
+		{
+			float* destination = matrices + (base - first + instance) * 32;
+			for (int row = 0; row < 4; row++)
+				_mm_storeu_ps(destination + row * 4, world_rows[row][instance]);
+			for (int row = 0; row < 4; row++)
+				_mm_storeu_ps(destination + 16 + row * 4, wvp_rows[row][instance]);
+		}
+	}
+}
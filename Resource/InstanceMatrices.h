@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+
+// No D3D on this file, the math of InstanceTransforms is plain SSE so it can be built and timed on its own
+
+namespace FrameDX12
+{
+	// Streams in the order of InstanceTransforms::Stream: position xyz, rotation quaternion xyzw and scale xyz
+	constexpr int kInstanceStreamCount = 10;
+
+	// Computes the World and WVP matrices of the instances [first, first + count), 4 at a time with SSE
+	// Each instance gets 32 floats on matrices, the transposed World then the transposed WVP, so the shaders can use mul(position, matrix)
+	// first needs to be a multiple of 4, and the streams padded to a multiple of 4 instances
+	// view_projection is row major, as in XMFLOAT4X4. matrices should be cached memory, it is written with plain stores
+	void ComputeInstanceMatrices(const float* const streams[kInstanceStreamCount], size_t first, size_t count, const float view_projection[4][4], float* matrices);
+}
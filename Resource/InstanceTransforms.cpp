@@ -0,0 +1,65 @@
+#include "InstanceTransforms.h"
+#include "../Device/CommandGraph.h"
+
+using namespace FrameDX12;
+using namespace DirectX;
+
+void InstanceTransforms::Create(Device* device, uint32_t count)
+{
+	mCount = count;
+
+	uint32_t padded_count = (count + 3) / 4 * 4;
+	for (int stream = 0; stream < kStreamCount; stream++)
+	{
+		bool is_one = stream == RotationW || stream == ScaleX || stream == ScaleY || stream == ScaleZ;
+		mStreams[stream].assign(padded_count, is_one ? 1.0f : 0.0f);
+	}
+
+	XMStoreFloat4x4(&mViewProjection, XMMatrixIdentity());
+
+	mBuffer.Create(device, count, false, true, {}, nullptr, true);
+	mBuffer.Map();
+}
+
+void InstanceTransforms::SetTransform(uint32_t index, FXMVECTOR position, FXMVECTOR rotation_quaternion, FXMVECTOR scale)
+{
+	XMFLOAT3 p, s;
+	XMFLOAT4 q;
+	XMStoreFloat3(&p, position);
+	XMStoreFloat4(&q, rotation_quaternion);
+	XMStoreFloat3(&s, scale);
+
+	mStreams[PositionX][index] = p.x; mStreams[PositionY][index] = p.y; mStreams[PositionZ][index] = p.z;
+	mStreams[RotationX][index] = q.x; mStreams[RotationY][index] = q.y; mStreams[RotationZ][index] = q.z; mStreams[RotationW][index] = q.w;
+	mStreams[ScaleX][index] = s.x; mStreams[ScaleY][index] = s.y; mStreams[ScaleZ][index] = s.z;
+}
+
+void InstanceTransforms::BeginFrame(FXMMATRIX view_projection)
+{
+	XMStoreFloat4x4(&mViewProjection, view_projection);
+}
+
+void InstanceTransforms::AddUpdateNode(CommandGraph& graph, std::string name, std::vector<std::string> dependencies)
+{
+	// Only CPU work, the lists of the node stay empty
+	graph.AddNode(name, nullptr, [this](ID3D12GraphicsCommandList*, uint32_t chunk)
+	{
+		ComputeChunk(chunk);
+	}, dependencies, GetChunkCount());
+}
+
+void InstanceTransforms::ComputeChunk(uint32_t chunk)
+{
+	static_assert(sizeof(GPUData) == 32 * sizeof(float));
+
+	const float* streams[kStreamCount];
+	for (int stream = 0; stream < kStreamCount; stream++)
+		streams[stream] = mStreams[stream].data();
+
+	// The chunks and the pages of Generate start on multiples of 4 instances, as the kernel needs
+	uint32_t start = GetChunkStart(chunk);
+	mBuffer.Generate(start, GetChunkEnd(chunk) - start, [&](GPUData* elements, size_t first_index, size_t count)
+	{
+		ComputeInstanceMatrices(streams, first_index, count, mViewProjection.m, &elements[0].World.m[0][0]);
+	});
+}
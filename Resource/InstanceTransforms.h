@@ -0,0 +1,68 @@
+#pragma once
+#include "../Core/stdafx.h"
+#include "StructuredBuffer.h"
+#include "InstanceMatrices.h"
+
+namespace FrameDX12
+{
+	class CommandGraph;
+
+	// Position, rotation and scale of many instances, stored as SoA so they can be turned into matrices 4 instances at a time with SSE
+	// Each frame a graph node computes the World and WVP matrices in chunks of kChunkSize instances, one chunk per repeat, so the graph
+	//  workers do them in parallel. They go through StructuredBuffer::Generate on a buffer rewritten every frame, so each worker fills
+	//  a cached scratch page that is then streamed to the current frame copy
+	// The matrices are stored transposed, so the shaders can use them as float4x4 with mul(position, matrix)
+	class InstanceTransforms
+	{
+	public:
+		static constexpr uint32_t kChunkSize = 4096;
+
+		struct GPUData
+		{
+			DirectX::XMFLOAT4X4 World;
+			DirectX::XMFLOAT4X4 WVP;
+		};
+
+		// Rotations are quaternions
+		enum Stream
+		{
+			PositionX, PositionY, PositionZ,
+			RotationX, RotationY, RotationZ, RotationW,
+			ScaleX, ScaleY, ScaleZ,
+			kStreamCount
+		};
+		static_assert(kStreamCount == kInstanceStreamCount);
+
+		// All the instances start with the identity transform
+		void Create(Device* device, uint32_t count);
+
+		void SetTransform(uint32_t index, DirectX::FXMVECTOR position, DirectX::FXMVECTOR rotation_quaternion, DirectX::FXMVECTOR scale);
+
+		// Array with one value per instance. Can be written from the nodes that run before the update node, for example a chunk per repeat
+		float* GetStream(Stream stream) { return mStreams[stream].data(); }
+
+		// Sets the view projection matrix used for the WVP of the current frame. Call it each frame before executing the graph
+		void BeginFrame(DirectX::FXMMATRIX view_projection);
+
+		// Adds the node that computes the matrices of the current frame. The nodes that draw the instances need to depend on it
+		void AddUpdateNode(CommandGraph& graph, std::string name, std::vector<std::string> dependencies = {});
+
+		// What the update node does for each repeat
+		void ComputeChunk(uint32_t chunk);
+
+		uint32_t GetCount() const { return mCount; }
+		uint32_t GetChunkCount() const { return (mCount + kChunkSize - 1) / kChunkSize; }
+		uint32_t GetChunkStart(uint32_t chunk) const { return chunk * kChunkSize; }
+		uint32_t GetChunkEnd(uint32_t chunk) const { return std::min(mCount, (chunk + 1) * kChunkSize); }
+
+		// SRV of the matrices of the current frame
+		Descriptor GetSRV() { return mBuffer.GetSRV(); }
+	private:
+		uint32_t mCount = 0;
+		std::vector<float> mStreams[kStreamCount]; // Padded to a multiple of 4 instances
+
+		DirectX::XMFLOAT4X4 mViewProjection;
+
+		StructuredBuffer<GPUData> mBuffer;
+	};
+}
@@ -1,68 +1,154 @@
 #include "Mesh.h"
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
+#include "OBJParser.h"
+#include "MeshCache.h"
+#include "VertexWelder.h"
+#include "MeshOptimizer.h"
 #include "../Device/CommandGraph.h"
+#include "../Device/Device.h"
 #include "../Core/Utils.h"
+#include "../Core/MappedFile.h"
 #include <DirectXMesh.h>
 
 using namespace FrameDX12;
 
-void Mesh::BuildFromOBJ(Device* device, CommandGraph& copy_graph, const std::string& path, VertexDesc&& vertex_desc)
+namespace
 {
-    mDesc.vertex_layout = vertex_desc;
+    // Of everything on the input elements, and of the positions being normalized
+    // The code that writes the vertices can't be hashed, so a layout that changes only that still needs another name
+    uint64_t HashVertexLayout(const VertexDesc& layout)
+    {
+        std::string description = std::to_string(layout.normalized_positions);
+        D3D12_INPUT_LAYOUT_DESC input_layout = layout.GetGPUDesc();
+        for (uint32_t idx = 0; idx < input_layout.NumElements; idx++)
+        {
+            const D3D12_INPUT_ELEMENT_DESC& element = input_layout.pInputElementDescs[idx];
+            description += std::string("|") + element.SemanticName + " " + std::to_string(element.SemanticIndex) + " " +
+                           std::to_string(element.Format) + " " + std::to_string(element.InputSlot) + " " +
+                           std::to_string(element.AlignedByteOffset) + " " + std::to_string(element.InputSlotClass) + " " +
+                           std::to_string(element.InstanceDataStepRate);
+        }
+        return HashMeshSource(description.data(), description.size());
+    }
+}
 
+VertexDesc FrameDX12::MakeQuantizedVertexDesc(PositionFormat position_format, UVFormat uv_format)
+{
+    std::string name = std::string("Quantized") + (position_format == PositionFormat::Half ? "HalfPosition" : "SNorm16Position") +
+                                                  (uv_format == UVFormat::Half ? "HalfUV" : "UNorm16UV");
+
+    VertexDesc layout;
+    if (position_format == PositionFormat::Half)
+        layout = uv_format == UVFormat::Half ? MakeVertexDesc<QuantizedVertexLayout<PositionFormat::Half, UVFormat::Half>>(name) :
+                                               MakeVertexDesc<QuantizedVertexLayout<PositionFormat::Half, UVFormat::UNorm16>>(name);
+    else
+        layout = uv_format == UVFormat::Half ? MakeVertexDesc<QuantizedVertexLayout<PositionFormat::SNorm16, UVFormat::Half>>(name) :
+                                               MakeVertexDesc<QuantizedVertexLayout<PositionFormat::SNorm16, UVFormat::UNorm16>>(name);
+    layout.normalized_positions = true;
+    return layout;
+}
+
+bool Mesh::LoadOBJ(const std::string& path)
+{
     using namespace std;
 
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
+    // The data of a previous load goes away, nothing can be uploading it
+    mCache = MeshCacheFile();
+    mUserFormatedVB.clear();
 
-    std::string warn;
-    std::string err;
+    MappedFile source;
+    if (!source.Open(path))
+    {
+        LogMsg(L"Can't open " + StringToWString(path), LogCategory::Error);
+        return false;
+    }
 
-    bool succeeded = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str());
+    // The hash of the source is a lot faster than parsing it, so checking the cache is cheap even when it misses
+    MeshCacheKey cache_key;
+    string cache_path;
+    if (mLoadOptions.use_cache)
+    {
+        cache_key = { HashMeshSource(source.GetData(), source.GetSize()), mDesc.vertex_layout.name, (uint32_t)mDesc.vertex_layout.vertex_size,
+                      HashVertexLayout(mDesc.vertex_layout), HashLoadOptions() };
+        cache_path = GetMeshCachePath(path, mDesc.vertex_layout.name);
 
-    if (!warn.empty()) LogMsg(StringToWString(warn), LogCategory::Warning);
-    if (!err.empty()) LogMsg(StringToWString(err), LogCategory::Error);
+        if (mCache.Open(cache_path, cache_key))
+        {
+            mDesc.vertex_count = mCache.GetVertexCount();
+            mDesc.index_count = mCache.GetIndexCount();
+            mDesc.triangle_count = mDesc.index_count / 3;
+            mDesc.bounds.Center = { mCache.GetBoundsCenter()[0], mCache.GetBoundsCenter()[1], mCache.GetBoundsCenter()[2] };
+            mDesc.bounds.Extents = { mCache.GetBoundsExtents()[0], mCache.GetBoundsExtents()[1], mCache.GetBoundsExtents()[2] };
 
-    if (!succeeded)
-        return;
+            // The upload copies straight from the mapped file
+            mVertexData = mCache.GetVertexData();
+            mIndexData = mCache.GetIndexData();
+            return true;
+        }
+    }
 
-    // Create CPU-side vertex and index buffers
-    unordered_map<CPUVertex, uint32_t> unique_vertices = {};
+    OBJData obj;
+    std::string error;
+    if (!ParseOBJ(source.GetData(), source.GetSize(), obj, error))
+    {
+        LogMsg(StringToWString(error), LogCategory::Error);
+        return false;
+    }
 
-    size_t reserve_size = 0;
-    for (const auto& shape : shapes)
-        reserve_size += shape.mesh.indices.size() * 3;
-    mVertices.reserve(reserve_size);
-    mIndices.reserve(reserve_size);
+    // Create CPU-side vertex and index buffers
+    // The corners are welded by their attribute indices, so the vertices only need to be built once per unique corner
+    vector<OBJData::Corner> unique_corners;
+    WeldOBJ(obj, unique_corners, mIndices, mLoadOptions.weld_tolerance);
 
-    for (const auto& shape : shapes)
+    // The OBJ order is usually bad for the post-transform cache, and the vertices need to follow the new order for the fetches
+    if (mLoadOptions.optimize_vertex_cache)
     {
-        for (const auto& index : shape.mesh.indices)
+        uint32_t vertex_count = unique_corners.size();
+        VertexCacheStats before = ComputeVertexCacheStats(mIndices, vertex_count);
+
+        OptimizeVertexCache(mIndices, vertex_count);
+
+        if (mLoadOptions.optimize_overdraw)
         {
-            CPUVertex vertex;
-            vertex.position.x = attrib.vertices[3 * index.vertex_index + 0];
-            vertex.position.y = attrib.vertices[3 * index.vertex_index + 1];
-            vertex.position.z = attrib.vertices[3 * index.vertex_index + 2];
+            vector<float> positions(3 * vertex_count);
+            for (auto [idx, corner] : fpp::enumerate(unique_corners))
+                memcpy(&positions[3 * idx], &obj.positions[3 * corner.position], 3 * sizeof(float));
 
-            vertex.normal.x = attrib.normals[3 * index.normal_index + 0];
-            vertex.normal.y = attrib.normals[3 * index.normal_index + 1];
-            vertex.normal.z = attrib.normals[3 * index.normal_index + 2];
+            OptimizeOverdraw(mIndices, positions, mLoadOptions.overdraw_threshold);
+        }
 
-            vertex.uv.x = attrib.texcoords[2 * index.texcoord_index + 0];
-            vertex.uv.y = attrib.texcoords[2 * index.texcoord_index + 1];
+        vector<uint32_t> remap = OptimizeVertexFetch(mIndices, vertex_count);
+        vector<OBJData::Corner> fetch_ordered_corners(vertex_count);
+        for (auto [idx, corner] : fpp::enumerate(unique_corners))
+            fetch_ordered_corners[remap[idx]] = corner;
+        unique_corners = move(fetch_ordered_corners);
 
-            vertex.tangent.x = vertex.tangent.y = vertex.tangent.z = vertex.tangent.w = 0;
-            vertex.bitangent.x = vertex.bitangent.y = vertex.bitangent.z = 0;
+        VertexCacheStats after = ComputeVertexCacheStats(mIndices, vertex_count);
+        LogMsg(L"Vertex cache of " + StringToWString(path) +
+               L" : ACMR " + to_wstring(before.acmr) + L" -> " + to_wstring(after.acmr) +
+               L", ATVR " + to_wstring(before.atvr) + L" -> " + to_wstring(after.atvr), LogCategory::Info);
+    }
 
-            if (!unique_vertices.count(vertex))
-            {
-                unique_vertices[vertex] = static_cast<uint32_t>(mVertices.size());
-                mVertices.push_back(vertex);
-            }
+    mVertices.resize(unique_corners.size());
+    for (auto [idx, corner] : fpp::enumerate(unique_corners))
+    {
+        CPUVertex& vertex = mVertices[idx];
+        vertex = {};
+        vertex.position.x = obj.positions[3 * corner.position + 0];
+        vertex.position.y = obj.positions[3 * corner.position + 1];
+        vertex.position.z = obj.positions[3 * corner.position + 2];
 
-            mIndices.push_back(unique_vertices[vertex]);
+        // Faces without normals or UVs get zeros
+        if (corner.normal != OBJData::kMissing)
+        {
+            vertex.normal.x = obj.normals[3 * corner.normal + 0];
+            vertex.normal.y = obj.normals[3 * corner.normal + 1];
+            vertex.normal.z = obj.normals[3 * corner.normal + 2];
+        }
+
+        if (corner.texcoord != OBJData::kMissing)
+        {
+            vertex.uv.x = obj.texcoords[2 * corner.texcoord + 0];
+            vertex.uv.y = obj.texcoords[2 * corner.texcoord + 1];
         }
     }
 
@@ -94,47 +180,209 @@ void Mesh::BuildFromOBJ(Device* device, CommandGraph& copy_graph, const std::str
         vertex.bitangent = raw_bitangents[idx];
     }
 
+    // Before the conversion, the layout can store the positions relative to it
+    if (!mVertices.empty())
+        DirectX::BoundingBox::CreateFromPoints(mDesc.bounds, mVertices.size(), &mVertices[0].position, sizeof(CPUVertex));
+
     // Convert the CPU vertex to the user defined representation
-    size_t buffer_size = mVertices.size() * vertex_desc.vertex_size;
-    void* user_vb = malloc(buffer_size);
-    mUserFormatedVB = user_vb;
+    const VertexDesc& layout = mDesc.vertex_layout;
+    size_t buffer_size = mVertices.size() * layout.vertex_size;
+    mUserFormatedVB.resize(buffer_size);
+    void* user_vb = mUserFormatedVB.data();
 
-    for (const CPUVertex& vertex : mVertices)
-        user_vb = mDesc.vertex_layout.AppendVertex(user_vb, vertex);
+    // The max keeps the flat axes finite, their normalized positions are 0 anyway
+    DirectX::XMVECTOR center = DirectX::XMLoadFloat3(&mDesc.bounds.Center);
+    DirectX::XMVECTOR extents = DirectX::XMLoadFloat3(&mDesc.bounds.Extents);
+    DirectX::XMVECTOR inverse_extents = DirectX::XMVectorReciprocal(DirectX::XMVectorMax(extents, DirectX::XMVectorReplicate(1e-20f)));
 
-    // Create GPU-side buffers
-    mIndexBuffer.Create(device, CD3DX12_RESOURCE_DESC::Buffer(mIndices.size() * sizeof(uint32_t)));
-    mVertexBuffer.Create(device, CD3DX12_RESOURCE_DESC::Buffer(buffer_size));
+    const CPUVertex* source_vertices = mVertices.data();
+    vector<CPUVertex> normalized_vertices;
+    if (layout.normalized_positions)
+    {
+        normalized_vertices = mVertices;
+        for (CPUVertex& vertex : normalized_vertices)
+            DirectX::XMStoreFloat3(&vertex.position, DirectX::XMVectorMultiply(DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&vertex.position), center), inverse_extents));
+        source_vertices = normalized_vertices.data();
+    }
 
-    copy_graph.AddNode("", [this,buffer_size](ID3D12GraphicsCommandList* cl)
+    if (layout.AppendVertices)
     {
-        // Need to set it to common when using the copy queue
-        // TODO : It would be nice if the command graph could batch resource barriers
-        mIndexBuffer.FillFromBuffer(cl, mIndices, D3D12_RESOURCE_STATE_COMMON);
-        mVertexBuffer.FillFromBuffer(cl, reinterpret_cast<char*>(mUserFormatedVB), buffer_size, D3D12_RESOURCE_STATE_COMMON);
-    }, nullptr, {});
+        layout.AppendVertices(source_vertices, mVertices.size(), user_vb);
+    }
+    else
+    {
+        for (size_t idx = 0; idx < mVertices.size(); idx++)
+            user_vb = layout.AppendVertex(user_vb, source_vertices[idx]);
+    }
+
+    if (layout.ReadVertex)
+    {
+        QuantizationError error;
+        const uint8_t* written = mUserFormatedVB.data();
+        for (const CPUVertex& vertex : mVertices)
+        {
+            CPUVertex decoded;
+            layout.ReadVertex(written, decoded);
+            written += layout.vertex_size;
+
+            if (layout.normalized_positions)
+                DirectX::XMStoreFloat3(&decoded.position, DirectX::XMVectorMultiplyAdd(DirectX::XMLoadFloat3(&decoded.position), extents, center));
+
+            error.AddPosition(&vertex.position.x, &decoded.position.x);
+            error.AddNormal(&vertex.normal.x, &decoded.normal.x);
+            error.AddTangent(&vertex.tangent.x, &decoded.tangent.x);
+            error.AddUV(&vertex.uv.x, &decoded.uv.x);
+        }
+
+        LogMsg(L"Quantization error of " + StringToWString(path) + L" with the layout " + StringToWString(layout.name) +
+               L" : position " + to_wstring(error.position) + L", normal " + to_wstring(error.normal) + L" deg, tangent " + to_wstring(error.tangent) +
+               L" deg (" + to_wstring(error.tangent_sign) + L" sign flips), UV " + to_wstring(error.uv), LogCategory::Info);
+    }
+
+    mVertexData = mUserFormatedVB.data();
+    mIndexData = mIndices.data();
+
+    if (mLoadOptions.use_cache)
+    {
+        const DirectX::XMFLOAT3& center = mDesc.bounds.Center;
+        const DirectX::XMFLOAT3& extents = mDesc.bounds.Extents;
+        float bounds_center[3] = { center.x, center.y, center.z };
+        float bounds_extents[3] = { extents.x, extents.y, extents.z };
+
+        // Not fatal, the next load parses the OBJ again
+        if (!MeshCacheFile::Write(cache_path, cache_key, mVertexData, mDesc.vertex_count, mIndexData, mDesc.index_count, bounds_center, bounds_extents))
+            LogMsg(L"Can't write the mesh cache " + StringToWString(cache_path), LogCategory::Warning);
+    }
+
+    return true;
+}
+
+uint32_t Mesh::HashLoadOptions() const
+{
+    uint32_t weld_tolerance_bits;
+    memcpy(&weld_tolerance_bits, &mLoadOptions.weld_tolerance, sizeof(float));
+
+    // The options that are off don't change it, so the caches of the meshes loaded without them stay valid
+    uint32_t hash = weld_tolerance_bits;
+    if (mLoadOptions.optimize_vertex_cache)
+    {
+        hash = hash * 31 + 1;
+        if (mLoadOptions.optimize_overdraw)
+        {
+            uint32_t threshold_bits;
+            memcpy(&threshold_bits, &mLoadOptions.overdraw_threshold, sizeof(float));
+            hash = hash * 31 + threshold_bits;
+        }
+    }
+    return hash;
+}
+
+void Mesh::CreateGPUBuffers(Device* device)
+{
+    size_t buffer_size = mDesc.vertex_count * mDesc.vertex_layout.vertex_size;
+
+    mIndexBuffer.Create(device, CD3DX12_RESOURCE_DESC::Buffer(mDesc.index_count * sizeof(uint32_t)));
+    mVertexBuffer.Create(device, CD3DX12_RESOURCE_DESC::Buffer(buffer_size));
 
     mVBV.BufferLocation = mVertexBuffer->GetGPUVirtualAddress();
     mVBV.SizeInBytes = buffer_size;
     mVBV.StrideInBytes = mDesc.vertex_layout.vertex_size;
 
     mIBV.BufferLocation = mIndexBuffer->GetGPUVirtualAddress();
-    mIBV.SizeInBytes = mIndices.size() * sizeof(uint32_t);
+    mIBV.SizeInBytes = mDesc.index_count * sizeof(uint32_t);
     mIBV.Format = DXGI_FORMAT_R32_UINT;
 }
 
+void Mesh::RecordUpload(ID3D12GraphicsCommandList* cl, UploadBatch& batch)
+{
+    if (mCollection)
+    {
+        mCollection->Upload(cl, mRange, mVertexData, mIndexData);
+        return;
+    }
+
+    // Need to set it to common when using the copy queue
+    batch.Add(mIndexBuffer, 0, mIndexData, mDesc.index_count * sizeof(uint32_t), D3D12_RESOURCE_STATE_COMMON);
+    batch.Add(mVertexBuffer, 0, mVertexData, mDesc.vertex_count * mDesc.vertex_layout.vertex_size, D3D12_RESOURCE_STATE_COMMON);
+}
+
+void Mesh::BuildFromOBJ(Device* device, CommandGraph& copy_graph, const std::string& path, VertexDesc&& vertex_desc)
+{
+    mDesc.vertex_layout = vertex_desc;
+
+    if (!LoadOBJ(path))
+        return;
+
+    CreateGPUBuffers(device);
+
+    copy_graph.AddNode("", [this](ID3D12GraphicsCommandList* cl)
+    {
+        UploadBatch batch;
+        RecordUpload(cl, batch);
+        batch.Record(cl);
+    }, nullptr, {});
+}
+
+void Mesh::BuildFromOBJ(Device* device, CommandGraph& copy_graph, const std::string& path, MeshCollection& collection, VertexDesc&& vertex_desc)
+{
+    mDesc.vertex_layout = vertex_desc;
+
+    if (!LoadOBJ(path))
+        return;
+
+    // Reserve the range now, so the copy nodes can run in parallel without touching the collection state
+    mCollection = &collection;
+    mRange = collection.Allocate(mDesc.vertex_layout, mDesc.vertex_count, mDesc.index_count);
+
+    copy_graph.AddNode("", [this](ID3D12GraphicsCommandList* cl)
+    {
+        UploadBatch batch;
+        RecordUpload(cl, batch);
+        batch.Record(cl);
+    }, nullptr, {});
+}
+
+UploadTicket Mesh::StreamFromOBJ(Device* device, const std::string& path, MeshCollection* collection, StreamingUploader::Priority priority, VertexDesc&& vertex_desc)
+{
+    mDesc.vertex_layout = vertex_desc;
+
+    if (!LoadOBJ(path))
+        return {};
+
+    if (collection)
+    {
+        mCollection = collection;
+        mRange = collection->Allocate(mDesc.vertex_layout, mDesc.vertex_count, mDesc.index_count);
+    }
+    else
+    {
+        CreateGPUBuffers(device);
+    }
+
+    // The CPU data (or the mapped cache) stays on the mesh, so the uploader doesn't need a copy of it
+    uint64_t size_in_bytes = (uint64_t)mDesc.vertex_count * mDesc.vertex_layout.vertex_size + mDesc.index_count * sizeof(uint32_t);
+    mUploadTicket = device->GetStreamingUploader().Enqueue(size_in_bytes, priority, [this](ID3D12GraphicsCommandList* cl, UploadBatch& batch)
+    {
+        RecordUpload(cl, batch);
+    });
+
+    return mUploadTicket;
+}
+
 void Mesh::Draw(ID3D12GraphicsCommandList* cl, uint32_t instances_count)
 {
+    if (mCollection)
+    {
+        mCollection->Draw(cl, mRange, instances_count);
+        return;
+    }
+
     // Remember, the transitions do nothing (that is, this function, not DX barriers) if the resource is already on the state you want
     mVertexBuffer.Transition(cl, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
     mIndexBuffer.Transition(cl, D3D12_RESOURCE_STATE_INDEX_BUFFER);
 
     cl->IASetIndexBuffer(&mIBV);
     cl->IASetVertexBuffers(0, 1, &mVBV);
-    cl->DrawIndexedInstanced(mIndices.size(), instances_count, 0, 0, 0);
+    MeshCollection::InvalidateBinding(); // The collection pages are not bound anymore
+    cl->DrawIndexedInstanced(mDesc.index_count, instances_count, 0, 0, 0);
 }
-
-Mesh::~Mesh()
-{
-    free(mUserFormatedVB);
-}
\ No newline at end of file
@@ -1,82 +1,116 @@
 #pragma once
 #include "../Core/stdafx.h"
 #include "CommitedResource.h"
+#include "MeshCache.h"
+#include "MeshCollection.h"
+#include "StreamingUploader.h"
+#include "UploadBatch.h"
+#include "VertexLayout.h"
 
 namespace FrameDX12
 {
-	struct CPUVertex
-	{
-
-		DirectX::XMFLOAT3 position;
-		DirectX::XMFLOAT3 normal;
-		DirectX::XMFLOAT4 tangent;
-		DirectX::XMFLOAT3 bitangent;
-		DirectX::XMFLOAT2 uv;
-
-		bool operator==(const CPUVertex& other) const
-		{
-			using namespace DirectX;
-
-			return XMVector3Equal(XMLoadFloat3(&position), XMLoadFloat3(&other.position)) &&
-				XMVector3Equal(XMLoadFloat3(&normal), XMLoadFloat3(&other.normal)) &&
-				XMVector4Equal(XMLoadFloat4(&tangent), XMLoadFloat4(&other.tangent)) &&
-				XMVector3Equal(XMLoadFloat3(&bitangent), XMLoadFloat3(&other.bitangent)) &&
-				XMVector2Equal(XMLoadFloat2(&uv), XMLoadFloat2(&other.uv));
-		}
-	};
+	// The layout of the default VertexDesc
+	using DefaultVertexLayout = VertexLayout<VertexElement<VertexSemantic::Position, VertexFormat::Float3>,
+											 VertexElement<VertexSemantic::Normal  , VertexFormat::Float3>,
+											 VertexElement<VertexSemantic::Tangent , VertexFormat::Float4>,
+											 VertexElement<VertexSemantic::UV      , VertexFormat::Float2>>;
 
 	// Generic way to describe a vertex, with a default implementation
 	struct VertexDesc
 	{
-		// Returns the DirectX input layout desc
-		std::function<D3D12_INPUT_LAYOUT_DESC()> GetGPUDesc = []()
-		{
-			D3D12_INPUT_LAYOUT_DESC input_layout;
-
-			static D3D12_INPUT_ELEMENT_DESC vertex_desc[] =
-			{
-				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT   , 0, 0                           , D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-				{ "NORMAL"  , 0, DXGI_FORMAT_R32G32B32_FLOAT   , 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-				{ "TANGENT" , 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }, // w is the sign, used to flip
-				{ "UV"      , 0, DXGI_FORMAT_R32G32_FLOAT      , 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-			};
-
-			input_layout.pInputElementDescs = vertex_desc;
-			input_layout.NumElements = _countof(vertex_desc);
+		// Identifies the layout. Meshes with the same name share buffers on a MeshCollection, so change it if you change the layout
+		std::string name = "Default";
 
-			return input_layout;
-		};
+		// Returns the DirectX input layout desc
+		std::function<D3D12_INPUT_LAYOUT_DESC()> GetGPUDesc = DefaultVertexLayout::GetGPUDesc;
 
 		// Size of the vertex on the data to be copied over to the GPU
-		size_t vertex_size = 48;
+		size_t vertex_size = DefaultVertexLayout::kVertexSize;
 
 		// Function to add a new vertex to the data buffer. It returns the buffer ready to write the next vertex
-		std::function<void* (void*, const CPUVertex&)> AppendVertex = [](void* RawBuffer, const CPUVertex& Vertex)
-		{
-			float* Buffer = reinterpret_cast<float*>(RawBuffer);
+		std::function<void* (void*, const CPUVertex&)> AppendVertex = DefaultVertexLayout::AppendVertex;
 
-			*(Buffer++) = Vertex.position.x;
-			*(Buffer++) = Vertex.position.y;
-			*(Buffer++) = Vertex.position.z;
+		// Optional, converts all the vertices of a mesh with a single call. If set it's used instead of AppendVertex
+		// Left empty by default, so replacing only AppendVertex keeps working. MakeVertexDesc sets both
+		std::function<void(const CPUVertex*, size_t, void*)> AppendVertices;
 
-			*(Buffer++) = Vertex.normal.x;
-			*(Buffer++) = Vertex.normal.y;
-			*(Buffer++) = Vertex.normal.z;
+		// If true, AppendVertex gets the positions relative to the mesh bounds, in [-1, 1] on each axis, so they can go on normalized
+		//  or half formats without losing the precision on big meshes. The shader gets them back with Center + position * Extents
+		//  of Mesh::GetDesc().bounds
+		bool normalized_positions = false;
 
-			*(Buffer++) = Vertex.tangent.x;
-			*(Buffer++) = Vertex.tangent.y;
-			*(Buffer++) = Vertex.tangent.z;
-			*(Buffer++) = Vertex.tangent.w;
+		// Optional, reads back a vertex written by AppendVertex (positions still normalized if they were). If set, the error of the
+		//  layout is logged when a mesh is processed
+		std::function<void(const void*, CPUVertex&)> ReadVertex;
+	};
 
-			*(Buffer++) = Vertex.uv.x;
-			*(Buffer++) = Vertex.uv.y;
+	// VertexDesc of a layout known at compile time, converting the vertices with the batch loop of the layout
+	template<typename Layout>
+	VertexDesc MakeVertexDesc(std::string name = Layout::GetName())
+	{
+		VertexDesc desc;
+		desc.name = std::move(name);
+		desc.GetGPUDesc = Layout::GetGPUDesc;
+		desc.vertex_size = Layout::kVertexSize;
+		desc.AppendVertex = Layout::AppendVertex;
+		desc.AppendVertices = Layout::Convert;
+		if constexpr (!Layout::kIsLossless)
+			desc.ReadVertex = Layout::ReadVertex;
+		return desc;
+	}
+
+	enum class PositionFormat
+	{
+		Half,   // R16G16B16A16_FLOAT
+		SNorm16 // R16G16B16A16_SNORM, uniform precision over the bounds
+	};
 
-			return Buffer;
-		};
+	enum class UVFormat
+	{
+		Half,   // R16G16_FLOAT, for UVs that tile
+		UNorm16 // R16G16_UNORM, more precision but UVs out of [0, 1] are clamped
 	};
 
+	// Vertex of 20 bytes instead of the 48 of the default one, with the same data
+	//  POSITION : float4, xyz normalized to the mesh bounds (see VertexDesc::normalized_positions), w is the sign of the bitangent
+	//  NORMAL   : float2, octahedral encoded
+	//  TANGENT  : float2, octahedral encoded
+	//  UV       : float2
+	template<PositionFormat Position, UVFormat UV>
+	using QuantizedVertexLayout = VertexLayout<VertexElement<VertexSemantic::PositionBitangentSign, Position == PositionFormat::Half ? VertexFormat::Half4 : VertexFormat::SNorm16x4>,
+											   VertexElement<VertexSemantic::Normal, VertexFormat::Octahedral16>,
+											   VertexElement<VertexSemantic::Tangent, VertexFormat::Octahedral16>,
+											   VertexElement<VertexSemantic::UV, UV == UVFormat::Half ? VertexFormat::Half2 : VertexFormat::UNorm16x2>>;
+
+	// VertexDesc of the QuantizedVertexLayout, for formats picked at runtime
+	// Octahedral decoding in HLSL :
+	//  float3 n = float3(e.xy, 1 - abs(e.x) - abs(e.y));
+	//  if (n.z < 0) n.xy = (1 - abs(n.yx)) * (n.xy >= 0 ? 1 : -1);
+	//  n = normalize(n);
+	VertexDesc MakeQuantizedVertexDesc(PositionFormat position_format = PositionFormat::SNorm16, UVFormat uv_format = UVFormat::Half);
+
 	class Mesh
 	{
+	public:
+		// How the OBJ is processed when loading it
+		struct LoadOptions
+		{
+			// Positions, normals and texcoords closer than this on every component become the same one. 0 only welds the corners that use
+			//  the same attribute indices
+			float weld_tolerance = 0.0f;
+
+			// Loads the processed mesh from a binary cache next to the OBJ if there's one for the same source, layout and options,
+			//  and writes it after processing the OBJ if not
+			bool use_cache = true;
+
+			// Reorders the triangles for the post-transform vertex cache and the vertices in the order they are used, and logs the ACMR
+			//  before and after. Off by default, as it makes the load slower and the buffers stop following the order of the file
+			bool optimize_vertex_cache = false;
+			// After that, moves the clusters of triangles that face out first, to reduce overdraw. Only kept if the ACMR grows less than
+			//  overdraw_threshold times. Needs optimize_vertex_cache
+			bool optimize_overdraw = false;
+			float overdraw_threshold = 1.05f;
+		};
 	private:
 		struct Description
 		{
@@ -91,44 +125,74 @@ namespace FrameDX12
 			uint32_t triangle_count;
 			uint32_t index_count;
 			VertexDesc vertex_layout;
+			DirectX::BoundingBox bounds;
 		} mDesc;
 
 	public:
 		Mesh() = default;
 		Mesh(Mesh&&) = default;
 		Mesh(const Mesh&) = delete;
-		~Mesh();
 
 		// Creates a mesh from an OBJ file
 		// Adds all necessary commands to the referenced graph. The commands are all copy so you can use the copy queue here
 		// Remember to call Build and Execute on the graph, and wait for the results, before drawing!
-		void BuildFromOBJ(class Device* device, class CommandGraph& copy_graph, const std::string& path, VertexDesc&& vertex_desc = VertexDesc());
+		void BuildFromOBJ(class Device* device, class CommandGraph& copy_graph, const std::string& path, VertexDesc&& vertex_desc = MakeVertexDesc<DefaultVertexLayout>("Default"));
+		// Same, but the geometry is placed on the collection shared buffers instead of buffers owned by the mesh
+		// The collection needs to outlive the mesh
+		void BuildFromOBJ(class Device* device, class CommandGraph& copy_graph, const std::string& path, MeshCollection& collection, VertexDesc&& vertex_desc = MakeVertexDesc<DefaultVertexLayout>("Default"));
+
+		// Same, but the upload goes to the device StreamingUploader instead of a graph, so there's nothing to execute or wait for on the CPU
+		// Make the queue that draws the mesh wait for the returned ticket with StreamingUploader::QueueWait before drawing
+		// If collection is not null the geometry is placed there. The mesh can't be moved until the ticket is done
+		UploadTicket StreamFromOBJ(class Device* device, const std::string& path, MeshCollection* collection = nullptr,
+								   StreamingUploader::Priority priority = StreamingUploader::Priority::Normal, VertexDesc&& vertex_desc = MakeVertexDesc<DefaultVertexLayout>("Default"));
+
+		// Only valid for meshes loaded with StreamFromOBJ
+		const UploadTicket& GetUploadTicket() const { return mUploadTicket; }
 
 		// Sets the buffers and the draw command
+		// For meshes on a collection the buffers are only set if the list has a different page bound
 		// Assumes that the IA is set to triangle list
 		void Draw(ID3D12GraphicsCommandList* cl, uint32_t instances_count = 1);
 
+		// Only valid for meshes on a collection
+		const MeshCollection::Range& GetRange() const { return mRange; }
+
 		Description GetDesc() const { return mDesc; }
+
+		// Used by the next load
+		void SetLoadOptions(const LoadOptions& options) { mLoadOptions = options; }
 	private:
+		// Loads the CPU side data
+		bool LoadOBJ(const std::string& path);
+
+		// Creates the buffers owned by the mesh and their views
+		void CreateGPUBuffers(class Device* device);
+		// Adds the copies of the CPU data, either the ones to the mesh buffers to the batch or the ones to the collection range to the list
+		void RecordUpload(ID3D12GraphicsCommandList* cl, UploadBatch& batch);
+
+		// Of the load options that change the processed mesh
+		uint32_t HashLoadOptions() const;
+
 		std::vector<uint32_t> mIndices;
 		std::vector<CPUVertex> mVertices;
-		void* mUserFormatedVB = nullptr;
+		std::vector<uint8_t> mUserFormatedVB;
+
+		// The data to upload, either the processed OBJ or the mapped cache. Both are owned by the mesh and kept until it's destroyed
+		//  or loaded again, and moving the mesh keeps the pointers valid
+		MeshCacheFile mCache;
+		const void* mVertexData = nullptr;
+		const uint32_t* mIndexData = nullptr;
 
 		D3D12_VERTEX_BUFFER_VIEW mVBV;
 		D3D12_INDEX_BUFFER_VIEW mIBV;
 		CommitedResource mVertexBuffer;
 		CommitedResource mIndexBuffer;
-	};
-}
 
-namespace std
-{
-	template<> struct hash<FrameDX12::CPUVertex>
-	{
-		size_t operator()(FrameDX12::CPUVertex const& vertex) const
-		{
-			// Hashing the raw bytes interpreted as a string
-			return hash<string>()(string((const char*)&vertex, sizeof(FrameDX12::CPUVertex)));
-		}
+		MeshCollection* mCollection = nullptr;
+		MeshCollection::Range mRange;
+
+		UploadTicket mUploadTicket;
+		LoadOptions mLoadOptions;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,161 @@
+#include "MeshCache.h"
+#include <cstring>
+#include <cstdio>
+#include <cctype>
+#include <fstream>
+#include <filesystem>
+#include <atomic>
+#include <random>
+
+using namespace FrameDX12;
+
+namespace
+{
+	constexpr uint64_t kVertexAlignment = 16;
+
+	uint64_t Align(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	uint64_t Rotate(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	// Random per process, plus a counter for the calls inside it
+	std::string MakeTemporaryPath(const std::string& path)
+	{
+		static const uint64_t process_tag = ((uint64_t)std::random_device()() << 32) | std::random_device()();
+		static std::atomic<uint64_t> counter = 0;
+
+		char suffix[64];
+		snprintf(suffix, sizeof(suffix), ".%016llx.%llu.tmp", (unsigned long long)process_tag, (unsigned long long)counter++);
+		return path + suffix;
+	}
+}
+
+uint64_t FrameDX12::HashMeshSource(const char* data, size_t size)
+{
+	constexpr uint64_t kPrime0 = 0x9E3779B185EBCA87ull;
+	constexpr uint64_t kPrime1 = 0xC2B2AE3D27D4EB4Full;
+
+	// 4 independent lanes of 8 bytes, so the multiplies of a block don't wait for each other
+	uint64_t lanes[4] = { kPrime0, kPrime1, ~kPrime0, ~kPrime1 };
+	size_t offset = 0;
+	for (; offset + 32 <= size; offset += 32)
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			uint64_t word;
+			memcpy(&word, data + offset + lane * 8, 8);
+			lanes[lane] = Rotate(lanes[lane] ^ (word * kPrime1), 31) * kPrime0;
+		}
+	}
+
+	uint64_t hash = size * kPrime0;
+	for (uint64_t lane : lanes)
+		hash = Rotate(hash ^ lane, 27) * kPrime1;
+	for (; offset < size; offset++)
+		hash = Rotate(hash ^ (uint8_t)data[offset], 11) * kPrime0;
+
+	return hash ^ (hash >> 29);
+}
+
+std::string FrameDX12::GetMeshCachePath(const std::string& source_path, const std::string& layout_name)
+{
+	std::string safe_name = layout_name;
+	for (char& c : safe_name)
+	{
+		if (!isalnum((unsigned char)c))
+			c = '_';
+	}
+	return source_path + "." + safe_name + ".meshcache";
+}
+
+bool MeshCacheFile::Open(const std::string& path, const MeshCacheKey& key)
+{
+	mHeader = nullptr;
+	if (!mFile.Open(path) || mFile.GetSize() < sizeof(Header))
+	{
+		mFile.Close();
+		return false;
+	}
+
+	const Header* header = reinterpret_cast<const Header*>(mFile.GetData());
+	bool matches = header->magic == kMagic &&
+				   header->version == kVersion &&
+				   header->source_hash == key.source_hash &&
+				   strncmp(header->layout_name, key.layout_name.c_str(), kMaxLayoutName) == 0 &&
+				   header->vertex_size == key.vertex_size &&
+				   header->layout_hash == key.layout_hash &&
+				   header->options_hash == key.options_hash;
+
+	// A truncated file fails here
+	matches = matches &&
+			  header->vertex_offset + (uint64_t)header->vertex_count * header->vertex_size <= mFile.GetSize() &&
+			  header->index_offset + (uint64_t)header->index_count * sizeof(uint32_t) <= mFile.GetSize();
+
+	if (!matches)
+	{
+		mFile.Close();
+		return false;
+	}
+
+	mHeader = header;
+	return true;
+}
+
+bool MeshCacheFile::Write(const std::string& path, const MeshCacheKey& key,
+						  const void* vertex_data, uint32_t vertex_count,
+						  const uint32_t* index_data, uint32_t index_count,
+						  const float bounds_center[3], const float bounds_extents[3])
+{
+	if (key.layout_name.size() >= kMaxLayoutName)
+		return false;
+
+	Header header = {};
+	header.magic = kMagic;
+	header.version = kVersion;
+	header.source_hash = key.source_hash;
+	strncpy(header.layout_name, key.layout_name.c_str(), kMaxLayoutName - 1);
+	header.vertex_size = key.vertex_size;
+	header.options_hash = key.options_hash;
+	header.layout_hash = key.layout_hash;
+	header.vertex_count = vertex_count;
+	header.index_count = index_count;
+	header.vertex_offset = Align(sizeof(Header), kVertexAlignment);
+	header.index_offset = Align(header.vertex_offset + (uint64_t)vertex_count * key.vertex_size, sizeof(uint32_t));
+	memcpy(header.bounds_center, bounds_center, sizeof(header.bounds_center));
+	memcpy(header.bounds_extents, bounds_extents, sizeof(header.bounds_extents));
+
+	std::string temporary_path = MakeTemporaryPath(path);
+	std::error_code error;
+	{
+		std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		const char padding[kVertexAlignment] = {};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		file.write(padding, header.vertex_offset - sizeof(Header));
+		file.write(static_cast<const char*>(vertex_data), (uint64_t)vertex_count * key.vertex_size);
+		file.write(padding, header.index_offset - (header.vertex_offset + (uint64_t)vertex_count * key.vertex_size));
+		file.write(reinterpret_cast<const char*>(index_data), (uint64_t)index_count * sizeof(uint32_t));
+
+		file.close();
+		if (!file)
+		{
+			std::filesystem::remove(temporary_path, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(temporary_path, path, error);
+	if (error)
+	{
+		std::filesystem::remove(temporary_path, error);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "../Core/MappedFile.h"
+#include <cstdint>
+#include <string>
+
+// No D3D on this file, the vertices are opaque bytes in the format of the layout
+
+namespace FrameDX12
+{
+	// What the cached data depends on. A cache is only used if all of it matches
+	struct MeshCacheKey
+	{
+		uint64_t source_hash;     // HashMeshSource of the source file contents
+		std::string layout_name;  // VertexDesc::name
+		uint32_t vertex_size;
+		uint64_t layout_hash;     // Of every element of the layout and how the vertices are written, as the name can be reused
+		uint32_t options_hash;    // Of the load options that change the output
+	};
+
+	// Binary cache of a processed mesh: the vertex buffer already in the GPU format, the index buffer and the bounds
+	// The file is memory mapped and the buffers are read from the mapping, so uploading them copies straight from the file pages
+	// The mapping lives as long as the object (moving it keeps the same pointers), so the owner can keep the data pointers until it's destroyed
+	// The format is versioned with kVersion, bump it when the format or the processing that creates the data changes
+	class MeshCacheFile
+	{
+	public:
+		static constexpr uint32_t kVersion = 3;
+
+		// Returns false if the file doesn't exist, is from another version or doesn't match the key
+		bool Open(const std::string& path, const MeshCacheKey& key);
+
+		// Writes to a temporary file first and renames it over the cache, so a cache is never left half written
+		// The temporary file is unique per call, so loads of the same mesh on other threads or processes can write it at the same time,
+		//  the last rename wins. Mappings of the old file stay valid
+		static bool Write(const std::string& path, const MeshCacheKey& key,
+						  const void* vertex_data, uint32_t vertex_count,
+						  const uint32_t* index_data, uint32_t index_count,
+						  const float bounds_center[3], const float bounds_extents[3]);
+
+		uint32_t GetVertexCount() const { return mHeader->vertex_count; }
+		uint32_t GetIndexCount() const { return mHeader->index_count; }
+		const void* GetVertexData() const { return mFile.GetData() + mHeader->vertex_offset; }
+		const uint32_t* GetIndexData() const { return reinterpret_cast<const uint32_t*>(mFile.GetData() + mHeader->index_offset); }
+		const float* GetBoundsCenter() const { return mHeader->bounds_center; }
+		const float* GetBoundsExtents() const { return mHeader->bounds_extents; }
+	private:
+		static constexpr uint32_t kMagic = 0x48534D46; // "FMSH"
+		static constexpr size_t kMaxLayoutName = 64;
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t source_hash;
+			char layout_name[kMaxLayoutName];
+			uint32_t vertex_size;
+			uint32_t options_hash;
+			uint64_t layout_hash;
+			uint32_t vertex_count;
+			uint32_t index_count;
+			uint64_t vertex_offset;
+			uint64_t index_offset;
+			float bounds_center[3];
+			float bounds_extents[3];
+		};
+
+		MappedFile mFile;
+		const Header* mHeader = nullptr;
+	};
+
+	// 64 bit hash of the source file contents
+	uint64_t HashMeshSource(const char* data, size_t size);
+
+	// Where the cache of a source goes: next to it, with the layout on the name, so each layout has its own cache
+	std::string GetMeshCachePath(const std::string& source_path, const std::string& layout_name);
+}
@@ -0,0 +1,252 @@
+#include "MeshCollection.h"
+#include "Mesh.h"
+#include "../Device/CommandGraph.h"
+#include "../Core/StreamingCopy.h"
+
+using namespace FrameDX12;
+
+namespace
+{
+	struct BoundPage
+	{
+		ID3D12GraphicsCommandList* cl = nullptr;
+		const MeshCollection::Page* page = nullptr;
+		uint64_t epoch = 0;
+	};
+	thread_local BoundPage tBoundPage;
+
+	bool IsBound(ID3D12GraphicsCommandList* cl, const MeshCollection::Page* page)
+	{
+		return tBoundPage.cl == cl && tBoundPage.page == page && tBoundPage.epoch == CommandGraph::GetRecordingEpoch();
+	}
+}
+
+MeshCollection::Page* MeshCollection::CreatePage(const VertexDesc& layout, uint32_t vertex_count, uint32_t index_count)
+{
+	auto page = std::make_unique<Page>();
+	page->layout_name = layout.name;
+	page->vertex_size = layout.vertex_size;
+	page->vertex_capacity = std::max<uint32_t>(vertex_count, kVertexPageSize / layout.vertex_size);
+	page->index_capacity = std::max<uint32_t>(index_count, kIndexPageSize / sizeof(uint32_t));
+
+	uint64_t vb_size = (uint64_t)page->vertex_capacity * page->vertex_size;
+	uint64_t ib_size = (uint64_t)page->index_capacity * sizeof(uint32_t);
+
+	// Created on COMMON so no barriers are needed, see the class comment
+	page->vertex_buffer.Create(mDevice, CD3DX12_RESOURCE_DESC::Buffer(vb_size), D3D12_RESOURCE_STATE_COMMON);
+	page->index_buffer.Create(mDevice, CD3DX12_RESOURCE_DESC::Buffer(ib_size), D3D12_RESOURCE_STATE_COMMON);
+
+	page->vbv.BufferLocation = page->vertex_buffer->GetGPUVirtualAddress();
+	page->vbv.SizeInBytes = vb_size;
+	page->vbv.StrideInBytes = page->vertex_size;
+
+	page->ibv.BufferLocation = page->index_buffer->GetGPUVirtualAddress();
+	page->ibv.SizeInBytes = ib_size;
+	page->ibv.Format = DXGI_FORMAT_R32_UINT;
+
+	page->id = mPagesById.size();
+	mPagesById.push_back(page.get());
+
+	auto& layout_pages = mPages[layout.name];
+	layout_pages.push_back(std::move(page));
+	return layout_pages.back().get();
+}
+
+MeshCollection::Range MeshCollection::Allocate(const VertexDesc& layout, uint32_t vertex_count, uint32_t index_count)
+{
+	std::scoped_lock lock(mLock);
+
+	Page* page = nullptr;
+	for (auto& candidate : mPages[layout.name])
+	{
+		if (candidate->vertex_top + vertex_count <= candidate->vertex_capacity &&
+			candidate->index_top + index_count <= candidate->index_capacity)
+		{
+			page = candidate.get();
+			break;
+		}
+	}
+
+	if (!page)
+		page = CreatePage(layout, vertex_count, index_count);
+
+	LogAssert(page->vertex_size == layout.vertex_size, LogCategory::Error);
+
+	Range range;
+	range.page = page;
+	range.base_vertex = page->vertex_top;
+	range.vertex_count = vertex_count;
+	range.start_index = page->index_top;
+	range.index_count = index_count;
+
+	page->vertex_top += vertex_count;
+	page->index_top += index_count;
+	++mMeshesCount;
+
+	return range;
+}
+
+void MeshCollection::Upload(ID3D12GraphicsCommandList* cl, const Range& range, const void* vertices, const uint32_t* indices)
+{
+	UploadRing& ring = mDevice->GetUploadRing((QueueType)cl->GetType());
+
+	uint64_t vb_size = (uint64_t)range.vertex_count * range.page->vertex_size;
+	uint64_t ib_size = (uint64_t)range.index_count * sizeof(uint32_t);
+
+	// Both on the same allocation, so it's a single trip to the ring
+	uint64_t ib_staging_offset = (vb_size + 3) & ~3ull;
+	auto staging = ring.Allocate(cl, ib_staging_offset + ib_size);
+	StreamingCopyNoFence(staging.cpu_ptr, vertices, vb_size);
+	StreamingCopyNoFence(staging.cpu_ptr + ib_staging_offset, indices, ib_size);
+	StreamingFence();
+
+	range.page->vertex_buffer.MarkUsed();
+	range.page->index_buffer.MarkUsed();
+
+	cl->CopyBufferRegion(range.page->vertex_buffer.Get(), (uint64_t)range.base_vertex * range.page->vertex_size, staging.resource, staging.offset, vb_size);
+	cl->CopyBufferRegion(range.page->index_buffer.Get(), (uint64_t)range.start_index * sizeof(uint32_t), staging.resource, staging.offset + ib_staging_offset, ib_size);
+}
+
+void MeshCollection::Bind(ID3D12GraphicsCommandList* cl, const Page* page)
+{
+	// Binding once per list and page is enough to keep the page resident
+	page->vertex_buffer.MarkUsed();
+	page->index_buffer.MarkUsed();
+
+	cl->IASetVertexBuffers(0, 1, &page->vbv);
+	cl->IASetIndexBuffer(&page->ibv);
+
+	tBoundPage.cl = cl;
+	tBoundPage.page = page;
+	tBoundPage.epoch = CommandGraph::GetRecordingEpoch();
+}
+
+void MeshCollection::InvalidateBinding()
+{
+	tBoundPage = BoundPage();
+}
+
+void MeshCollection::Draw(ID3D12GraphicsCommandList* cl, const Range& range, uint32_t instances_count, uint32_t start_instance)
+{
+	if (!IsBound(cl, range.page))
+		Bind(cl, range.page);
+
+	cl->DrawIndexedInstanced(range.index_count, instances_count, range.start_index, range.base_vertex, start_instance);
+}
+
+ID3D12CommandSignature* MeshCollection::GetCommandSignature(ID3D12RootSignature* root_signature, uint32_t root_constant_parameter)
+{
+	std::scoped_lock lock(mSignaturesLock);
+
+	auto& signature = mCommandSignatures[{ root_signature, root_constant_parameter }];
+	if (!signature)
+	{
+		// Needs to match IndirectDrawArgs
+		D3D12_INDIRECT_ARGUMENT_DESC arguments[2] = {};
+		arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+		arguments[0].Constant.RootParameterIndex = root_constant_parameter;
+		arguments[0].Constant.DestOffsetIn32BitValues = 0;
+		arguments[0].Constant.Num32BitValuesToSet = 1;
+		arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+		D3D12_COMMAND_SIGNATURE_DESC desc = {};
+		desc.ByteStride = sizeof(IndirectDrawArgs);
+		desc.NumArgumentDescs = _countof(arguments);
+		desc.pArgumentDescs = arguments;
+
+		ThrowIfFailed(mDevice->GetDevice()->CreateCommandSignature(&desc, root_signature, IID_PPV_ARGS(&signature)));
+	}
+
+	return signature.Get();
+}
+
+void MeshCollection::DrawIndirect(ID3D12GraphicsCommandList* cl, const IndirectDraw* draws, size_t count, uint32_t pso_bucket_count,
+								  ID3D12RootSignature* root_signature, uint32_t root_constant_parameter,
+								  const std::function<void(ID3D12GraphicsCommandList*, uint32_t)>& set_bucket)
+{
+	if (count == 0)
+		return;
+
+	std::vector<Page*> pages;
+	{
+		std::scoped_lock lock(mLock);
+		pages = mPagesById;
+	}
+
+	// PSO major, so the PSO changes as few times as possible
+	uint32_t pages_count = pages.size();
+	uint32_t bucket_count = pso_bucket_count * pages_count;
+
+	// The sort scatters the arguments all over, so they are built on cached memory and then streamed to the upload ring in order
+	// Reused per thread, so recording every frame doesn't allocate
+	thread_local std::vector<IndirectDrawArgs> args;
+	args.resize(count);
+
+	std::vector<uint32_t> bucket_offsets(bucket_count + 1);
+	size_t args_count = BuildIndirectArgs(count, bucket_count, [draws, pages_count, pso_bucket_count, bucket_count](size_t idx)
+	{
+		const IndirectDraw& draw = draws[idx];
+
+		IndirectDrawItem item;
+		// Out of range buckets (or pages created after the copy above) map past the end, so they are skipped
+		bool valid = draw.pso_bucket < pso_bucket_count && draw.range->page->id < pages_count;
+		item.bucket = valid ? draw.pso_bucket * pages_count + draw.range->page->id : bucket_count;
+		item.draw_id = draw.draw_id;
+		item.index_count = draw.range->index_count;
+		item.start_index = draw.range->start_index;
+		item.base_vertex = draw.range->base_vertex;
+		item.instance_count = draw.instance_count;
+		return item;
+	}, args.data(), bucket_offsets.data());
+
+	// Draws with a pso_bucket not below pso_bucket_count were skipped
+	LogAssert(args_count == count, LogCategory::Error);
+	if (args_count == 0)
+		return;
+
+	// Upload memory is on GENERIC_READ, that already includes INDIRECT_ARGUMENT
+	auto staging = mDevice->GetUploadRing((QueueType)cl->GetType()).Allocate(cl, args_count * sizeof(IndirectDrawArgs));
+	StreamingCopy(staging.cpu_ptr, args.data(), args_count * sizeof(IndirectDrawArgs));
+
+	ID3D12CommandSignature* signature = GetCommandSignature(root_signature, root_constant_parameter);
+
+	uint32_t current_pso_bucket = ~0u;
+	for (uint32_t bucket = 0; bucket < bucket_count; bucket++)
+	{
+		uint32_t draws_count = bucket_offsets[bucket + 1] - bucket_offsets[bucket];
+		if (draws_count == 0)
+			continue;
+
+		uint32_t pso_bucket = bucket / pages_count;
+		if (pso_bucket != current_pso_bucket)
+		{
+			set_bucket(cl, pso_bucket);
+			current_pso_bucket = pso_bucket;
+		}
+
+		const Page* page = pages[bucket % pages_count];
+		if (!IsBound(cl, page))
+			Bind(cl, page);
+
+		cl->ExecuteIndirect(signature, draws_count, staging.resource, staging.offset + bucket_offsets[bucket] * sizeof(IndirectDrawArgs), nullptr, 0);
+	}
+}
+
+MeshCollection::Stats MeshCollection::GetStats()
+{
+	std::scoped_lock lock(mLock);
+
+	Stats stats = {};
+	stats.meshes_count = mMeshesCount;
+	for (auto& [name, pages] : mPages)
+	{
+		for (auto& page : pages)
+		{
+			++stats.pages_count;
+			stats.reserved_bytes += page->vbv.SizeInBytes + page->ibv.SizeInBytes;
+			stats.used_bytes += (uint64_t)page->vertex_top * page->vertex_size + (uint64_t)page->index_top * sizeof(uint32_t);
+		}
+	}
+
+	return stats;
+}
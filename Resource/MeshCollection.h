@@ -1,8 +1,115 @@
 #pragma once
+#include "../Core/stdafx.h"
+#include "CommitedResource.h"
+#include "IndirectArgs.h"
+#include <map>
+
 namespace FrameDX12
 {
+	struct VertexDesc;
+
+	// Geometry arena. Meshes with the same vertex layout (same VertexDesc::name) are sub-allocated from big shared vertex and index buffers (pages)
+	// Each mesh only keeps its base vertex and start index, so drawing meshes that share a page doesn't need to touch the IA
+	// The pages stay on the COMMON state, buffers get promoted to the copy and read states implicitly and decay back at the end of each ExecuteCommandLists
+	// Meshes are never removed, the arena only grows
+	// Thread safe
 	class MeshCollection
 	{
+	public:
+		static constexpr uint64_t kVertexPageSize = 32 * 1024 * 1024;
+		static constexpr uint64_t kIndexPageSize = 16 * 1024 * 1024;
+
+		struct Page;
+
+		// Where a mesh lives on the arena
+		struct Range
+		{
+			Page* page = nullptr;
+			uint32_t base_vertex = 0;
+			uint32_t vertex_count = 0;
+			uint32_t start_index = 0;
+			uint32_t index_count = 0;
+
+			bool IsValid() const { return page != nullptr; }
+		};
+
+		MeshCollection(Device* device) :
+			mDevice(device)
+		{}
+
+		// Reserves space for a mesh. Meshes bigger than a page get a page of their own
+		Range Allocate(const VertexDesc& layout, uint32_t vertex_count, uint32_t index_count);
+
+		// Records the copy of the mesh data to its range, vertices need to be already in the layout format
+		// The data is staged on the upload ring of the command list queue, so it can be freed after this returns
+		void Upload(ID3D12GraphicsCommandList* cl, const Range& range, const void* vertices, const uint32_t* indices);
+
+		// Binds the page of the range if it's not already bound on the command list, and issues the draw
+		// Assumes that the IA is set to triangle list
+		void Draw(ID3D12GraphicsCommandList* cl, const Range& range, uint32_t instances_count = 1, uint32_t start_instance = 0);
+
+		struct IndirectDraw
+		{
+			const Range* range;
+			uint32_t pso_bucket; // Small index chosen by the caller, draws of the same bucket use the same PSO
+			uint32_t draw_id; // Goes to the root constant, so the shader can find the data of the draw
+			uint32_t instance_count = 1;
+		};
+
+		// Multi-draw path. Builds the indirect arguments of all the draws on the CPU in parallel, and streams them to the upload ring of the command list queue
+		// Draws with a pso_bucket not below pso_bucket_count are skipped and logged as an error
+		// Then issues one ExecuteIndirect per PSO bucket and page, calling set_bucket when the bucket changes so the caller can set the PSO
+		// The draw id is written to the 32 bit root constant at root_constant_parameter of root_signature, which needs to be set on the list
+		// The command signature is created the first time a root signature and parameter pair is used
+		void DrawIndirect(ID3D12GraphicsCommandList* cl, const IndirectDraw* draws, size_t count, uint32_t pso_bucket_count,
+						  ID3D12RootSignature* root_signature, uint32_t root_constant_parameter,
+						  const std::function<void(ID3D12GraphicsCommandList*, uint32_t)>& set_bucket);
+
+		// Sets the vertex and index buffers of the page. Draw already does this when needed
+		void Bind(ID3D12GraphicsCommandList* cl, const Page* page);
+
+		// The bound page is tracked per thread and command list, and dropped when the list is reset (see CommandGraph::GetRecordingEpoch)
+		// Call this if you set other vertex or index buffers on a list you draw arena meshes on
+		static void InvalidateBinding();
+
+		struct Stats
+		{
+			uint32_t pages_count;
+			uint32_t meshes_count;
+			uint64_t reserved_bytes; // Size of all the pages
+			uint64_t used_bytes;
+		};
+		Stats GetStats();
+
+		struct Page
+		{
+			uint32_t id; // Index on the collection, in creation order
+			std::string layout_name;
+			uint32_t vertex_size;
+
+			CommitedResource vertex_buffer;
+			CommitedResource index_buffer;
+			D3D12_VERTEX_BUFFER_VIEW vbv;
+			D3D12_INDEX_BUFFER_VIEW ibv;
+
+			// In vertices and indices
+			uint32_t vertex_capacity;
+			uint32_t index_capacity;
+			uint32_t vertex_top = 0;
+			uint32_t index_top = 0;
+		};
+	private:
+		Page* CreatePage(const VertexDesc& layout, uint32_t vertex_count, uint32_t index_count);
+		ID3D12CommandSignature* GetCommandSignature(ID3D12RootSignature* root_signature, uint32_t root_constant_parameter);
+
+		std::mutex mLock;
+		std::unordered_map<std::string, std::vector<std::unique_ptr<Page>>> mPages; // Per layout name
+		std::vector<Page*> mPagesById;
+		uint32_t mMeshesCount = 0;
+
+		std::mutex mSignaturesLock;
+		std::map<std::pair<ID3D12RootSignature*, uint32_t>, ComPtr<ID3D12CommandSignature>> mCommandSignatures;
 
+		Device* mDevice;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,364 @@
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace FrameDX12;
+
+namespace
+{
+	constexpr uint32_t kNone = UINT32_MAX;
+
+	// Forsyth's tuning values. The simulated cache is LRU, and the 3 vertices of the last triangle get a fixed score so the
+	//  next triangle doesn't always continue a strip
+	constexpr uint32_t kCacheSize = 32;
+	constexpr float kCacheDecayPower = 1.5f;
+	constexpr float kLastTriangleScore = 0.75f;
+	constexpr float kValenceBoostScale = 2.0f;
+	constexpr float kValenceBoostPower = 0.5f;
+	constexpr uint32_t kMaxTableValence = 64;
+
+	// The scores only depend on small integers, so they are computed once
+	struct ScoreTables
+	{
+		float cache[kCacheSize];
+		float valence[kMaxTableValence];
+
+		ScoreTables()
+		{
+			for (uint32_t position = 0; position < kCacheSize; position++)
+			{
+				cache[position] = position < 3 ? kLastTriangleScore :
+					std::pow(1.0f - (position - 3) / float(kCacheSize - 3), kCacheDecayPower);
+			}
+			for (uint32_t remaining = 1; remaining < kMaxTableValence; remaining++)
+				valence[remaining] = kValenceBoostScale * std::pow((float)remaining, -kValenceBoostPower);
+			valence[0] = 0.0f;
+		}
+	};
+
+	float ScoreVertex(const ScoreTables& tables, uint32_t cache_position, uint32_t remaining)
+	{
+		// Vertices with no triangles left never make a triangle better
+		if (remaining == 0)
+			return -1.0f;
+
+		float score = cache_position == kNone ? 0.0f : tables.cache[cache_position];
+		score += remaining < kMaxTableValence ? tables.valence[remaining] : kValenceBoostScale * std::pow((float)remaining, -kValenceBoostPower);
+		return score;
+	}
+
+	// FIFO cache simulation with timestamps, so there's no array to shift. The accesses return 1 on a miss
+	class FIFOCache
+	{
+	public:
+		FIFOCache(uint32_t vertex_count, uint32_t size) : mTime(vertex_count, 0), mSize(size), mTimestamp(size + 1) {}
+
+		// Forgets everything, as if the cache was flushed
+		void Reset() { mTimestamp += mSize + 1; }
+
+		uint32_t Access(uint32_t vertex)
+		{
+			if (mTimestamp - mTime[vertex] <= mSize)
+				return 0;
+			mTime[vertex] = mTimestamp++;
+			return 1;
+		}
+
+		uint32_t AccessTriangle(const uint32_t* triangle)
+		{
+			return Access(triangle[0]) + Access(triangle[1]) + Access(triangle[2]);
+		}
+	private:
+		std::vector<uint32_t> mTime;
+		uint32_t mSize;
+		uint32_t mTimestamp;
+	};
+}
+
+VertexCacheStats FrameDX12::ComputeVertexCacheStats(const std::vector<uint32_t>& indices, uint32_t vertex_count, uint32_t cache_size)
+{
+	VertexCacheStats stats;
+	if (indices.empty() || vertex_count == 0)
+		return stats;
+
+	FIFOCache cache(vertex_count, cache_size);
+	for (uint32_t index : indices)
+		stats.transformed_vertices += cache.Access(index);
+
+	stats.acmr = stats.transformed_vertices / float(indices.size() / 3);
+	stats.atvr = stats.transformed_vertices / float(vertex_count);
+	return stats;
+}
+
+void FrameDX12::OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertex_count)
+{
+	static const ScoreTables tables;
+
+	uint32_t triangle_count = indices.size() / 3;
+	if (triangle_count == 0)
+		return;
+
+	// Triangles of each vertex, as a flat array with offsets. Emitted triangles are swapped to the end of the range of the vertex
+	//  and remaining shrinks, so only the pending ones are visited
+	std::vector<uint32_t> remaining(vertex_count, 0);
+	for (uint32_t index : indices)
+		remaining[index]++;
+
+	std::vector<uint32_t> offsets(vertex_count + 1, 0);
+	for (uint32_t vertex = 0; vertex < vertex_count; vertex++)
+		offsets[vertex + 1] = offsets[vertex] + remaining[vertex];
+
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+		for (uint32_t idx = 0; idx < indices.size(); idx++)
+			adjacency[cursor[indices[idx]]++] = idx / 3;
+	}
+
+	std::vector<uint32_t> cache_position(vertex_count, kNone);
+	std::vector<float> vertex_score(vertex_count);
+	for (uint32_t vertex = 0; vertex < vertex_count; vertex++)
+		vertex_score[vertex] = ScoreVertex(tables, kNone, remaining[vertex]);
+
+	std::vector<float> triangle_score(triangle_count);
+	uint32_t best = 0;
+	for (uint32_t triangle = 0; triangle < triangle_count; triangle++)
+	{
+		const uint32_t* corners = indices.data() + 3 * triangle;
+		triangle_score[triangle] = vertex_score[corners[0]] + vertex_score[corners[1]] + vertex_score[corners[2]];
+		if (triangle_score[triangle] > triangle_score[best])
+			best = triangle;
+	}
+
+	std::vector<uint8_t> emitted(triangle_count, false);
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	// 3 extra slots for the vertices of the new triangle before the oldest ones are pushed out
+	uint32_t cache[kCacheSize + 3];
+	uint32_t cache_count = 0;
+	uint32_t input_cursor = 0;
+
+	for (uint32_t emitted_count = 0; emitted_count < triangle_count; emitted_count++)
+	{
+		// Nothing on the cache has triangles left, continue from the input order
+		if (best == kNone)
+		{
+			while (emitted[input_cursor])
+				input_cursor++;
+			best = input_cursor;
+		}
+
+		const uint32_t* triangle = indices.data() + 3 * best;
+		output.insert(output.end(), triangle, triangle + 3);
+		emitted[best] = true;
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			uint32_t vertex = triangle[corner];
+			uint32_t* begin = adjacency.data() + offsets[vertex];
+			uint32_t* end = begin + remaining[vertex];
+			std::iter_swap(std::find(begin, end, best), end - 1);
+			remaining[vertex]--;
+		}
+
+		// The triangle goes to the front of the LRU, followed by what was already there
+		uint32_t new_cache[kCacheSize + 3] = { triangle[0], triangle[1], triangle[2] };
+		uint32_t new_count = 3;
+		for (uint32_t idx = 0; idx < cache_count; idx++)
+		{
+			uint32_t vertex = cache[idx];
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+				new_cache[new_count++] = vertex;
+		}
+
+		for (uint32_t idx = 0; idx < new_count; idx++)
+			cache_position[new_cache[idx]] = idx < kCacheSize ? idx : kNone;
+
+		// Apply the score changes first, the triangles of 2 cached vertices get both
+		for (uint32_t idx = 0; idx < new_count; idx++)
+		{
+			uint32_t vertex = new_cache[idx];
+			float score = ScoreVertex(tables, cache_position[vertex], remaining[vertex]);
+			float delta = score - vertex_score[vertex];
+			vertex_score[vertex] = score;
+
+			const uint32_t* vertex_triangles = adjacency.data() + offsets[vertex];
+			for (uint32_t triangle_idx = 0; triangle_idx < remaining[vertex]; triangle_idx++)
+				triangle_score[vertex_triangles[triangle_idx]] += delta;
+		}
+
+		// Only the triangles of the cached vertices are candidates, searching all of them would make it quadratic
+		cache_count = std::min(new_count, kCacheSize);
+		std::copy(new_cache, new_cache + cache_count, cache);
+
+		best = kNone;
+		float best_score = -1.0f;
+		for (uint32_t idx = 0; idx < cache_count; idx++)
+		{
+			uint32_t vertex = cache[idx];
+			const uint32_t* vertex_triangles = adjacency.data() + offsets[vertex];
+			for (uint32_t triangle_idx = 0; triangle_idx < remaining[vertex]; triangle_idx++)
+			{
+				uint32_t candidate = vertex_triangles[triangle_idx];
+				if (triangle_score[candidate] > best_score)
+				{
+					best_score = triangle_score[candidate];
+					best = candidate;
+				}
+			}
+		}
+	}
+
+	indices = std::move(output);
+}
+
+void FrameDX12::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<float>& positions, float threshold)
+{
+	uint32_t triangle_count = indices.size() / 3;
+	uint32_t vertex_count = positions.size() / 3;
+	if (triangle_count == 0)
+		return;
+
+	VertexCacheStats current = ComputeVertexCacheStats(indices, vertex_count);
+
+	// Hard boundaries, where the current order misses all the vertices of a triangle. Cutting there costs nothing
+	std::vector<uint32_t> hard_starts;
+	{
+		FIFOCache cache(vertex_count, kVertexCacheStatsSize);
+		for (uint32_t triangle = 0; triangle < triangle_count; triangle++)
+		{
+			if (cache.AccessTriangle(indices.data() + 3 * triangle) == 3)
+				hard_starts.push_back(triangle);
+		}
+		hard_starts.push_back(triangle_count);
+	}
+
+	// Soft boundaries inside them, where the part so far already has an ACMR within the threshold of the whole cluster when
+	//  starting from an empty cache, which is the worst that can happen after reordering
+	std::vector<uint32_t> cluster_starts;
+	{
+		FIFOCache cache(vertex_count, kVertexCacheStatsSize);
+		for (size_t hard = 0; hard + 1 < hard_starts.size(); hard++)
+		{
+			uint32_t begin = hard_starts[hard];
+			uint32_t end = hard_starts[hard + 1];
+
+			cache.Reset();
+			uint32_t cluster_misses = 0;
+			for (uint32_t triangle = begin; triangle < end; triangle++)
+				cluster_misses += cache.AccessTriangle(indices.data() + 3 * triangle);
+			float target_acmr = threshold * cluster_misses / float(end - begin);
+
+			cache.Reset();
+			cluster_starts.push_back(begin);
+			uint32_t misses = 0;
+			uint32_t start = begin;
+			for (uint32_t triangle = begin; triangle < end; triangle++)
+			{
+				misses += cache.AccessTriangle(indices.data() + 3 * triangle);
+				if (triangle + 1 < end && misses <= target_acmr * (triangle + 1 - start))
+				{
+					cluster_starts.push_back(triangle + 1);
+					cache.Reset();
+					misses = 0;
+					start = triangle + 1;
+				}
+			}
+		}
+		cluster_starts.push_back(triangle_count);
+	}
+
+	auto position = [&](uint32_t vertex, int axis) { return positions[3 * vertex + axis]; };
+
+	struct ClusterData
+	{
+		float centroid[3] = {};
+		float normal[3] = {};
+		float area = 0.0f;
+	};
+	auto accumulate = [&](uint32_t begin, uint32_t end, ClusterData& data)
+	{
+		for (uint32_t triangle = begin; triangle < end; triangle++)
+		{
+			const uint32_t* corners = indices.data() + 3 * triangle;
+			float edge0[3], edge1[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				edge0[axis] = position(corners[1], axis) - position(corners[0], axis);
+				edge1[axis] = position(corners[2], axis) - position(corners[0], axis);
+			}
+
+			// The cross product is twice the area times the normal, so adding them gives the area weighted normal
+			float cross[3] = { edge0[1] * edge1[2] - edge0[2] * edge1[1],
+							   edge0[2] * edge1[0] - edge0[0] * edge1[2],
+							   edge0[0] * edge1[1] - edge0[1] * edge1[0] };
+			float area = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float center = (position(corners[0], axis) + position(corners[1], axis) + position(corners[2], axis)) / 3.0f;
+				data.centroid[axis] += center * area;
+				data.normal[axis] += cross[axis];
+			}
+			data.area += area;
+		}
+		if (data.area > 0.0f)
+		{
+			for (float& value : data.centroid)
+				value /= data.area;
+		}
+	};
+
+	// Area weighted centroid of the mesh
+	ClusterData mesh;
+	accumulate(0, triangle_count, mesh);
+
+	// Clusters that face away from the center are on the outside of the mesh, and are more likely to occlude the rest
+	uint32_t cluster_count = cluster_starts.size() - 1;
+	std::vector<float> sort_keys(cluster_count);
+	for (uint32_t cluster = 0; cluster < cluster_count; cluster++)
+	{
+		ClusterData data;
+		accumulate(cluster_starts[cluster], cluster_starts[cluster + 1], data);
+
+		float length = std::sqrt(data.normal[0] * data.normal[0] + data.normal[1] * data.normal[1] + data.normal[2] * data.normal[2]);
+		float key = 0.0f;
+		for (int axis = 0; axis < 3 && length > 0.0f; axis++)
+			key += (data.centroid[axis] - mesh.centroid[axis]) * data.normal[axis] / length;
+		sort_keys[cluster] = key;
+	}
+
+	std::vector<uint32_t> order(cluster_count);
+	for (uint32_t cluster = 0; cluster < cluster_count; cluster++)
+		order[cluster] = cluster;
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sort_keys[a] > sort_keys[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	for (uint32_t cluster : order)
+		output.insert(output.end(), indices.begin() + 3 * cluster_starts[cluster], indices.begin() + 3 * cluster_starts[cluster + 1]);
+
+	if (ComputeVertexCacheStats(output, vertex_count).acmr <= threshold * current.acmr)
+		indices = std::move(output);
+}
+
+std::vector<uint32_t> FrameDX12::OptimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t vertex_count)
+{
+	std::vector<uint32_t> remap(vertex_count, kNone);
+	uint32_t next = 0;
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == kNone)
+			remap[index] = next++;
+		index = remap[index];
+	}
+
+	for (uint32_t& new_position : remap)
+	{
+		if (new_position == kNone)
+			new_position = next++;
+	}
+
+	return remap;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// No D3D on this file, it only reorders indices and vertices
+
+namespace FrameDX12
+{
+	// Result of running an index buffer through a simulated FIFO post-transform cache
+	struct VertexCacheStats
+	{
+		uint32_t transformed_vertices = 0;
+		float acmr = 0.0f; // Average cache miss ratio, transformed vertices per triangle. 0.5 is the best possible, 3 the worst
+		float atvr = 0.0f; // Average transformed vertex ratio, transformed vertices per vertex. 1 is the best possible
+	};
+
+	// Size of the FIFO simulated by the stats. Close to what current GPUs do in practice, the exact number doesn't change much
+	constexpr uint32_t kVertexCacheStatsSize = 16;
+
+	VertexCacheStats ComputeVertexCacheStats(const std::vector<uint32_t>& indices, uint32_t vertex_count, uint32_t cache_size = kVertexCacheStatsSize);
+
+	// Reorders the triangles so consecutive ones reuse the same vertices (Forsyth's linear speed vertex cache optimization)
+	// Each vertex is scored by its position on a simulated LRU cache and by how many triangles still use it, and the next triangle is
+	//  the one with the highest sum of its vertex scores among the ones using the cached vertices
+	void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertex_count);
+
+	// Reorders clusters of triangles so the ones facing out of the mesh go first, which lets early Z reject more of the rest
+	// Needs the vertex cache order, the clusters are cut where that order restarts the cache, so moving them costs few extra misses
+	// positions is xyz per vertex. The new order is only kept if its ACMR is at most threshold times the current one
+	void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<float>& positions, float threshold = 1.05f);
+
+	// Returns the new position of each vertex, in the order the indices use them first, and updates the indices to it
+	// Move the vertices with it so the fetches go forward through memory. Unused vertices go at the end
+	std::vector<uint32_t> OptimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t vertex_count);
+}
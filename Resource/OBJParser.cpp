@@ -0,0 +1,307 @@
+#include "OBJParser.h"
+#include "../Core/MappedFile.h"
+#include <charconv>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+
+using namespace FrameDX12;
+
+namespace
+{
+	// Under this, a file isn't worth splitting any more
+	constexpr size_t kMinChunkSize = 1024 * 1024;
+
+	struct Chunk
+	{
+		const char* begin;
+		const char* end;
+
+		std::vector<float> positions;
+		std::vector<float> normals;
+		std::vector<float> texcoords;
+
+		// Positive indices are already final. Negative ones are relative to the attributes read so far, and only the ones of
+		//  this chunk are known while parsing, so they are stored relative to the chunk (can be negative) and fixed on the merge
+		std::vector<OBJData::Corner> corners;
+		struct Fixup
+		{
+			uint32_t corner;
+			uint8_t attribute; // 0 position, 1 normal, 2 texcoord
+		};
+		std::vector<Fixup> fixups;
+
+		std::string error;
+	};
+
+	template<typename F>
+	void ParallelFor(size_t count, F&& f)
+	{
+		if (count == 1)
+		{
+			f(0);
+			return;
+		}
+
+		std::vector<std::thread> threads;
+		threads.reserve(count);
+		for (size_t idx = 0; idx < count; idx++)
+			threads.emplace_back([&f, idx]() { f(idx); });
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+	inline const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && IsSpace(*p)) ++p;
+		return p;
+	}
+
+	inline const char* ParseFloat(const char* p, const char* end, float& value)
+	{
+		p = SkipSpaces(p, end);
+		if (p < end && *p == '+') ++p; // from_chars doesn't take it
+		auto [next, ec] = std::from_chars(p, end, value);
+		return ec == std::errc() ? next : nullptr;
+	}
+
+	// The values from required_count on are 0 if they are not on the line
+	inline const char* ParseFloats(const char* p, const char* end, std::vector<float>& output, int count, int required_count)
+	{
+		for (int idx = 0; idx < count; idx++)
+		{
+			float value = 0.0f;
+			const char* next = ParseFloat(p, end, value);
+			if (!next && idx < required_count)
+				return nullptr;
+
+			output.push_back(value);
+			p = next ? next : p;
+		}
+		return p;
+	}
+
+	// Returns the index as stored on the chunk, flagging it for the fixup if it's relative
+	inline const char* ParseIndex(const char* p, const char* end, size_t local_count, uint32_t& index, bool& relative)
+	{
+		int64_t value;
+		auto [next, ec] = std::from_chars(p, end, value);
+		if (ec != std::errc() || value == 0)
+			return nullptr;
+
+		relative = value < 0;
+		index = (uint32_t)(relative ? (int64_t)local_count + value : value - 1);
+		return next;
+	}
+
+	bool ParseFace(const char* p, const char* end, Chunk& chunk, std::vector<OBJData::Corner>& face, std::vector<uint8_t>& face_relative)
+	{
+		face.clear();
+		face_relative.clear();
+
+		while (true)
+		{
+			p = SkipSpaces(p, end);
+			if (p == end || *p == '\n' || *p == '#')
+				break;
+
+			OBJData::Corner corner = { OBJData::kMissing, OBJData::kMissing, OBJData::kMissing };
+			bool relative[3] = {};
+
+			p = ParseIndex(p, end, chunk.positions.size() / 3, corner.position, relative[0]);
+			if (p && p < end && *p == '/')
+			{
+				++p;
+				if (p < end && *p != '/')
+					p = ParseIndex(p, end, chunk.texcoords.size() / 2, corner.texcoord, relative[2]);
+				if (p && p < end && *p == '/')
+					p = ParseIndex(p + 1, end, chunk.normals.size() / 3, corner.normal, relative[1]);
+			}
+			if (!p)
+				return false;
+
+			face.push_back(corner);
+			face_relative.push_back(relative[0] | relative[1] << 1 | relative[2] << 2);
+		}
+
+		if (face.size() < 3)
+			return false;
+
+		// Fan triangulation
+		for (size_t idx = 1; idx + 1 < face.size(); idx++)
+		{
+			for (size_t vertex : { (size_t)0, idx, idx + 1 })
+			{
+				for (uint8_t attribute = 0; attribute < 3; attribute++)
+				{
+					if (face_relative[vertex] & (1 << attribute))
+						chunk.fixups.push_back({ (uint32_t)chunk.corners.size(), attribute });
+				}
+				chunk.corners.push_back(face[vertex]);
+			}
+		}
+		return true;
+	}
+
+	void ParseChunk(Chunk& chunk)
+	{
+		// Rough guess of the density of an OBJ, so the vectors don't grow from zero
+		size_t size = chunk.end - chunk.begin;
+		chunk.positions.reserve(size / 40);
+		chunk.corners.reserve(size / 20);
+
+		std::vector<OBJData::Corner> face;
+		std::vector<uint8_t> face_relative;
+
+		const char* p = chunk.begin;
+		while (p < chunk.end)
+		{
+			const char* line_end = static_cast<const char*>(memchr(p, '\n', chunk.end - p));
+			if (!line_end) line_end = chunk.end;
+
+			p = SkipSpaces(p, line_end);
+			const char* parsed = p;
+			if (line_end - p > 2 && p[0] == 'v' && IsSpace(p[1]))
+				parsed = ParseFloats(p + 2, line_end, chunk.positions, 3, 3);
+			else if (line_end - p > 3 && p[0] == 'v' && p[1] == 'n' && IsSpace(p[2]))
+				parsed = ParseFloats(p + 3, line_end, chunk.normals, 3, 3);
+			else if (line_end - p > 3 && p[0] == 'v' && p[1] == 't' && IsSpace(p[2]))
+				parsed = ParseFloats(p + 3, line_end, chunk.texcoords, 2, 1);
+			else if (line_end - p > 2 && p[0] == 'f' && IsSpace(p[1]))
+				parsed = ParseFace(p + 2, line_end, chunk, face, face_relative) ? p : nullptr;
+
+			if (!parsed)
+			{
+				chunk.error = "Invalid OBJ statement: " + std::string(p, std::min<size_t>(line_end - p, 64));
+				return;
+			}
+
+			p = line_end + 1;
+		}
+	}
+}
+
+bool FrameDX12::ParseOBJ(const std::string& path, OBJData& data, std::string& error, uint32_t thread_count)
+{
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		error = "Can't open " + path;
+		return false;
+	}
+
+	return ParseOBJ(file.GetData(), file.GetSize(), data, error, thread_count);
+}
+
+bool FrameDX12::ParseOBJ(const char* text, size_t size, OBJData& data, std::string& error, uint32_t thread_count)
+{
+	data = {};
+
+	if (thread_count == 0)
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	size_t chunk_count = std::clamp<size_t>(size / kMinChunkSize, 1, thread_count);
+
+	// Line aligned chunks of about the same size
+	std::vector<Chunk> chunks(chunk_count);
+	const char* text_end = text + size;
+	const char* begin = text;
+	for (size_t idx = 0; idx < chunk_count; idx++)
+	{
+		const char* end = idx + 1 == chunk_count ? text_end : text + size * (idx + 1) / chunk_count;
+		end = std::max(end, begin);
+		const char* line_end = static_cast<const char*>(memchr(end, '\n', text_end - end));
+		end = line_end ? line_end + 1 : text_end;
+
+		chunks[idx].begin = begin;
+		chunks[idx].end = end;
+		begin = end;
+	}
+
+	ParallelFor(chunk_count, [&](size_t idx) { ParseChunk(chunks[idx]); });
+
+	for (Chunk& chunk : chunks)
+	{
+		if (!chunk.error.empty())
+		{
+			error = chunk.error;
+			return false;
+		}
+	}
+
+	// The attributes of the previous chunks go first
+	struct Bases
+	{
+		size_t positions, normals, texcoords, corners;
+	};
+	std::vector<Bases> bases(chunk_count);
+	Bases total = {};
+	for (size_t idx = 0; idx < chunk_count; idx++)
+	{
+		bases[idx] = total;
+		total.positions += chunks[idx].positions.size();
+		total.normals += chunks[idx].normals.size();
+		total.texcoords += chunks[idx].texcoords.size();
+		total.corners += chunks[idx].corners.size();
+	}
+
+	data.positions.resize(total.positions);
+	data.normals.resize(total.normals);
+	data.texcoords.resize(total.texcoords);
+	data.corners.resize(total.corners);
+
+	uint32_t position_count = total.positions / 3;
+	uint32_t normal_count = total.normals / 3;
+	uint32_t texcoord_count = total.texcoords / 2;
+	std::vector<uint8_t> invalid(chunk_count, false);
+
+	ParallelFor(chunk_count, [&](size_t idx)
+	{
+		Chunk& chunk = chunks[idx];
+		const Bases& base = bases[idx];
+
+		std::copy(chunk.positions.begin(), chunk.positions.end(), data.positions.begin() + base.positions);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), data.normals.begin() + base.normals);
+		std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), data.texcoords.begin() + base.texcoords);
+
+		// Relative indices that go past the start of the file end up negative. They can't be left wrapped around, as they could
+		//  land on kMissing
+		for (const Chunk::Fixup& fixup : chunk.fixups)
+		{
+			OBJData::Corner& corner = chunk.corners[fixup.corner];
+			uint32_t& index = fixup.attribute == 0 ? corner.position : fixup.attribute == 1 ? corner.normal : corner.texcoord;
+			size_t attribute_base = fixup.attribute == 0 ? base.positions / 3 : fixup.attribute == 1 ? base.normals / 3 : base.texcoords / 2;
+
+			int64_t fixed = (int64_t)(int32_t)index + (int64_t)attribute_base;
+			if (fixed < 0)
+			{
+				invalid[idx] = true;
+				return;
+			}
+			index = (uint32_t)fixed;
+		}
+
+		for (const OBJData::Corner& corner : chunk.corners)
+		{
+			if (corner.position >= position_count ||
+				(corner.normal != OBJData::kMissing && corner.normal >= normal_count) ||
+				(corner.texcoord != OBJData::kMissing && corner.texcoord >= texcoord_count))
+			{
+				invalid[idx] = true;
+				break;
+			}
+		}
+
+		std::copy(chunk.corners.begin(), chunk.corners.end(), data.corners.begin() + base.corners);
+	});
+
+	if (std::find(invalid.begin(), invalid.end(), (uint8_t)true) != invalid.end())
+	{
+		error = "OBJ face references a vertex that doesn't exist";
+		data = {};
+		return false;
+	}
+
+	return true;
+}
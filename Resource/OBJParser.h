@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <string>
+
+// No D3D on this file, the output is plain arrays that Mesh turns into vertices
+
+namespace FrameDX12
+{
+	// Geometry of an OBJ file, with the attributes unwelded, as they are on the file
+	struct OBJData
+	{
+		static constexpr uint32_t kMissing = UINT32_MAX;
+
+		// Indices to the attribute arrays, kMissing if the face didn't have that attribute
+		struct Corner
+		{
+			uint32_t position;
+			uint32_t normal;
+			uint32_t texcoord;
+		};
+
+		std::vector<float> positions; // xyz
+		std::vector<float> normals;   // xyz
+		std::vector<float> texcoords; // uv
+		std::vector<Corner> corners;  // 3 per triangle
+
+		uint32_t GetTriangleCount() const { return corners.size() / 3; }
+	};
+
+	// Parses the v, vn, vt and f statements of an OBJ, everything else (materials, groups, lines) is skipped
+	// Faces with more than 3 vertices are triangulated as fans. Negative (relative) indices are supported
+	// The file is memory mapped and split in line aligned chunks that are parsed in parallel, then merged. thread_count 0 uses all the cores
+	// Returns false and fills error if the file can't be read or has invalid indices
+	bool ParseOBJ(const std::string& path, OBJData& data, std::string& error, uint32_t thread_count = 0);
+
+	// Same, for an OBJ already in memory
+	bool ParseOBJ(const char* text, size_t size, OBJData& data, std::string& error, uint32_t thread_count = 0);
+}
@@ -0,0 +1,125 @@
+#include "PlacedResourceAllocator.h"
+#include "../Device/Device.h"
+#include "../Core/Log.h"
+
+using namespace FrameDX12;
+
+PlacedResourceAllocator::Pool& PlacedResourceAllocator::GetPool(D3D12_HEAP_TYPE heap_type, Category category)
+{
+	Pool& pool = mPools[heap_type - D3D12_HEAP_TYPE_DEFAULT][(int)category];
+
+	std::scoped_lock lock(mPoolsLock);
+	if (!pool.allocator)
+	{
+		D3D12_HEAP_FLAGS heap_flags;
+		switch (category)
+		{
+		case Category::Buffers:
+			heap_flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+			break;
+		case Category::Textures:
+			heap_flags = D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+			break;
+		default:
+			heap_flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+			break;
+		}
+
+		uint64_t min_allocation = category == Category::Buffers ? D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+		pool.allocator = std::make_unique<HeapSuballocator>(kBlockSize, min_allocation,
+		[this, &pool, heap_type, heap_flags](uint32_t block_idx)
+		{
+			if (block_idx >= kMaxBlocks)
+				return false;
+
+			// MSAA resources need 4MB alignment, so that's the alignment of the blocks
+			CD3DX12_HEAP_DESC desc(kBlockSize, heap_type, D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT, heap_flags);
+			if (LogCheckAndContinue(mDevice->GetDevice()->CreateHeap(&desc, IID_PPV_ARGS(&pool.heaps[block_idx])), LogCategory::Error) != StatusCode::Ok)
+				return false;
+
+			// UPLOAD and READBACK heaps live on system memory, only the video memory is budgeted
+			if (heap_type == D3D12_HEAP_TYPE_DEFAULT)
+				pool.residency[block_idx] = mDevice->GetResidencyManager().Register(static_cast<ID3D12Pageable*>(pool.heaps[block_idx].Get()), kBlockSize);
+			return true;
+		},
+		[this, &pool](uint32_t block_idx)
+		{
+			mDevice->GetResidencyManager().Unregister(std::exchange(pool.residency[block_idx], nullptr));
+			pool.heaps[block_idx].Reset();
+		});
+	}
+
+	return pool;
+}
+
+bool PlacedResourceAllocator::CreateResource(D3D12_RESOURCE_DESC desc, D3D12_HEAP_TYPE heap_type, D3D12_RESOURCE_STATES initial_states, const D3D12_CLEAR_VALUE* clear_value,
+											 ComPtr<ID3D12Resource>& resource, PlacedAllocation& allocation)
+{
+	if (heap_type != D3D12_HEAP_TYPE_DEFAULT && heap_type != D3D12_HEAP_TYPE_UPLOAD && heap_type != D3D12_HEAP_TYPE_READBACK)
+		return false;
+
+	Category category;
+	if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+		category = Category::Buffers;
+	else if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+		category = Category::RenderTargets;
+	else
+		category = Category::Textures;
+
+	// Try the small alignments first, the device tells us if the resource can use them
+	// Only textures that are not render targets or depth buffers can use 4KB. Small MSAA resources can use 64KB instead of 4MB
+	// Buffers always need 64KB
+	uint64_t small_alignment = 0;
+	if (desc.SampleDesc.Count > 1)
+		small_alignment = D3D12_SMALL_MSAA_RESOURCE_PLACEMENT_ALIGNMENT;
+	else if (category == Category::Textures)
+		small_alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+
+	D3D12_RESOURCE_ALLOCATION_INFO info;
+	desc.Alignment = small_alignment;
+	info = mDevice->GetDevice()->GetResourceAllocationInfo(0, 1, &desc);
+	if (small_alignment != 0 && info.Alignment != small_alignment)
+	{
+		desc.Alignment = 0;
+		info = mDevice->GetDevice()->GetResourceAllocationInfo(0, 1, &desc);
+	}
+
+	if (info.SizeInBytes == UINT64_MAX || info.SizeInBytes > kMaxPlacedSize)
+		return false;
+
+	Pool& pool = GetPool(heap_type, category);
+	auto range = pool.allocator->Allocate(info.SizeInBytes, info.Alignment);
+	if (!range.IsValid())
+		return false;
+
+	PlacedAllocation new_allocation(pool.allocator.get(), range, pool.residency[range.block]);
+	if (LogCheckAndContinue(mDevice->GetDevice()->CreatePlacedResource(
+			pool.heaps[range.block].Get(),
+			range.offset,
+			&desc,
+			initial_states,
+			clear_value,
+			IID_PPV_ARGS(&resource)), LogCategory::Error) != StatusCode::Ok)
+	{
+		return false;
+	}
+
+	allocation = std::move(new_allocation);
+	return true;
+}
+
+HeapSuballocator::Stats PlacedResourceAllocator::GetStats(D3D12_HEAP_TYPE heap_type, Category category)
+{
+	return GetPool(heap_type, category).allocator->GetStats();
+}
+
+void PlacedResourceAllocator::Trim()
+{
+	for (auto& pools : mPools)
+	{
+		for (auto& pool : pools)
+		{
+			if (pool.allocator) pool.allocator->Trim();
+		}
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "../Core/stdafx.h"
+#include "HeapSuballocator.h"
+#include "ResidencyManager.h"
+
+namespace FrameDX12
+{
+	// Range of a heap used by a placed resource. Frees the range on destruction
+	class PlacedAllocation
+	{
+	public:
+		PlacedAllocation() = default;
+		PlacedAllocation(HeapSuballocator* pool, const HeapSuballocator::Allocation& allocation, ResidencyManager::Object* residency) :
+			mPool(pool),
+			mAllocation(allocation),
+			mResidency(residency)
+		{}
+		PlacedAllocation(const PlacedAllocation&) = delete;
+		PlacedAllocation& operator=(const PlacedAllocation&) = delete;
+		PlacedAllocation(PlacedAllocation&& other) :
+			mPool(std::exchange(other.mPool, nullptr)),
+			mAllocation(other.mAllocation),
+			mResidency(std::exchange(other.mResidency, nullptr))
+		{}
+		PlacedAllocation& operator=(PlacedAllocation&& rhs)
+		{
+			if (this != &rhs)
+			{
+				if (mPool) mPool->Free(mAllocation);
+				mPool = std::exchange(rhs.mPool, nullptr);
+				mAllocation = rhs.mAllocation;
+				mResidency = std::exchange(rhs.mResidency, nullptr);
+			}
+			return *this;
+		}
+		~PlacedAllocation()
+		{
+			if (mPool) mPool->Free(mAllocation);
+		}
+
+		bool IsValid() const { return mPool != nullptr; }
+		const HeapSuballocator::Allocation& GetAllocation() const { return mAllocation; }
+		// Residency of the whole heap. Null for heaps that are not tracked
+		ResidencyManager::Object* GetResidency() const { return mResidency; }
+	private:
+		HeapSuballocator* mPool = nullptr;
+		HeapSuballocator::Allocation mAllocation;
+		ResidencyManager::Object* mResidency = nullptr;
+	};
+
+	// Creates placed resources on big ID3D12Heap blocks instead of giving each resource its own implicit heap
+	// There's a pool per heap type and resource category (heap tier 1 can't mix buffers and textures on the same heap)
+	// Small textures use the 4KB placement alignment and small MSAA resources 64KB, when the device allows it. Buffers always need 64KB
+	// Render targets and depth buffers land on memory other resources used, so they need a discard or a clear before anything else
+	//  (CommitedResource discards them on the first Transition)
+	// The DEFAULT heaps are registered on the device ResidencyManager, so they are evicted as a whole
+	// Thread safe
+	class PlacedResourceAllocator
+	{
+	public:
+		enum class Category { Buffers, Textures, RenderTargets, COUNT };
+
+		static constexpr uint64_t kBlockSize = 64 * 1024 * 1024;
+		// Bigger resources are better off committed, as they would take a big part of a block
+		static constexpr uint64_t kMaxPlacedSize = kBlockSize / 4;
+		static constexpr uint32_t kMaxBlocks = 256;
+
+		PlacedResourceAllocator(class Device* device) :
+			mDevice(device)
+		{}
+
+		// Creates the resource on one of the pools
+		// Returns false if the resource should be committed instead. Only DEFAULT, UPLOAD and READBACK heaps are pooled
+		bool CreateResource(D3D12_RESOURCE_DESC desc, D3D12_HEAP_TYPE heap_type, D3D12_RESOURCE_STATES initial_states, const D3D12_CLEAR_VALUE* clear_value,
+							ComPtr<ID3D12Resource>& resource, PlacedAllocation& allocation);
+
+		// Waste and usage statistics for a pool
+		HeapSuballocator::Stats GetStats(D3D12_HEAP_TYPE heap_type, Category category);
+
+		// Releases the empty blocks of all the pools
+		void Trim();
+	private:
+		static constexpr int kHeapTypesCount = 3; // DEFAULT, UPLOAD and READBACK, same order as D3D12_HEAP_TYPE
+
+		struct Pool
+		{
+			std::unique_ptr<HeapSuballocator> allocator;
+			// Fixed array, so reading a heap doesn't race with a new block being created
+			ComPtr<ID3D12Heap> heaps[kMaxBlocks];
+			ResidencyManager::Object* residency[kMaxBlocks] = {};
+		};
+
+		Pool& GetPool(D3D12_HEAP_TYPE heap_type, Category category);
+
+		std::mutex mPoolsLock;
+		Pool mPools[kHeapTypesCount][(int)Category::COUNT];
+
+		class Device* mDevice;
+	};
+}
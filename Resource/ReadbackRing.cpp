@@ -0,0 +1,238 @@
+#include "ReadbackRing.h"
+#include "../Device/Device.h"
+#include "../Core/Log.h"
+
+using namespace FrameDX12;
+
+void ReadbackRing::Initialize(Device* device, QueueType queue, uint64_t size)
+{
+	mDevice = device;
+	mQueue = queue;
+	mSize = size;
+}
+
+ReadbackRing::~ReadbackRing()
+{
+	if (!mWaiter.joinable())
+		return;
+
+	{
+		std::scoped_lock lock(mLock);
+		mClosing = true;
+	}
+	mBatchClosed.notify_one();
+	mWaiter.join();
+
+	CloseHandle(mFenceEvent);
+}
+
+std::shared_ptr<ReadbackData::Region> ReadbackRing::Allocate(uint64_t size, uint64_t alignment, ID3D12Resource*& resource, uint64_t& offset)
+{
+	std::scoped_lock lock(mLock);
+
+	if (!mResource)
+	{
+		auto heap_props = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+		auto buffer_desc = CD3DX12_RESOURCE_DESC::Buffer(mSize);
+		ThrowIfFailed(mDevice->GetDevice()->CreateCommittedResource(
+			&heap_props,
+			D3D12_HEAP_FLAG_NONE,
+			&buffer_desc,
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr,
+			IID_PPV_ARGS(&mResource)));
+
+		// Mapped once for the whole life of the ring, the CPU only reads ranges whose copies the fence says are done
+		ThrowIfFailed(mResource->Map(0, nullptr, reinterpret_cast<void**>(&mMappedMem)));
+
+		mFenceEvent = CreateEventEx(nullptr, FALSE, FALSE, EVENT_ALL_ACCESS);
+		mWaiter = std::thread([this]() { WaitForBatches(); });
+	}
+
+	auto region = std::shared_ptr<ReadbackData::Region>(new ReadbackData::Region(), [this](ReadbackData::Region* region)
+	{
+		Release(region);
+		delete region;
+	});
+
+	uint64_t start = (mHead + alignment - 1) / alignment * alignment;
+	if (start % mSize + size > mSize)
+		start = (start / mSize + 1) * mSize;
+
+	// The ranges are released when the CPU is done with the data, so there's nothing to wait for if the ring is full
+	if (size > mSize || start + size - mTail > mSize)
+	{
+		LogMsg(L"Readback ring full, using a dedicated resource", LogCategory::Warning);
+
+		auto heap_props = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+		auto buffer_desc = CD3DX12_RESOURCE_DESC::Buffer(size);
+		ThrowIfFailed(mDevice->GetDevice()->CreateCommittedResource(
+			&heap_props,
+			D3D12_HEAP_FLAG_NONE,
+			&buffer_desc,
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr,
+			IID_PPV_ARGS(&region->dedicated)));
+
+		uint8_t* cpu_ptr;
+		ThrowIfFailed(region->dedicated->Map(0, nullptr, reinterpret_cast<void**>(&cpu_ptr)));
+		region->cpu_ptr = cpu_ptr;
+
+		resource = region->dedicated.Get();
+		offset = 0;
+		return region;
+	}
+
+	mHead = start + size;
+	mAllocations.push_back({ start, mHead, false });
+
+	region->end = mHead;
+	region->cpu_ptr = mMappedMem + start % mSize;
+
+	resource = mResource.Get();
+	offset = start % mSize;
+	return region;
+}
+
+void ReadbackRing::Release(ReadbackData::Region* region)
+{
+	if (region->dedicated)
+		return;
+
+	std::scoped_lock lock(mLock);
+
+	for (Allocation& allocation : mAllocations)
+	{
+		if (allocation.end == region->end)
+		{
+			allocation.released = true;
+			break;
+		}
+	}
+
+	while (!mAllocations.empty() && mAllocations.front().released)
+		mAllocations.pop_front();
+
+	if (mAllocations.empty())
+		mHead = mTail = 0;
+	else
+		mTail = mAllocations.front().start;
+}
+
+ReadbackFuture ReadbackRing::AddPending(ID3D12CommandList* cl, std::shared_ptr<ReadbackData::Region> region, uint64_t size, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint)
+{
+	Pending pending;
+	pending.list = cl;
+	pending.submitted = false;
+	pending.region = std::move(region);
+	pending.size = size;
+	pending.footprint = footprint;
+	ReadbackFuture future = pending.promise.get_future().share();
+
+	std::scoped_lock lock(mLock);
+	mOpenBatch.push_back(std::move(pending));
+
+	return future;
+}
+
+ReadbackFuture ReadbackRing::ReadBuffer(ID3D12GraphicsCommandList* cl, ID3D12Resource* source, uint64_t source_offset, uint64_t size_in_bytes)
+{
+	ID3D12Resource* resource;
+	uint64_t offset;
+	auto region = Allocate(size_in_bytes, D3D12_RAW_UAV_SRV_BYTE_ALIGNMENT, resource, offset);
+
+	cl->CopyBufferRegion(resource, offset, source, source_offset, size_in_bytes);
+
+	return AddPending(cl, std::move(region), size_in_bytes, {});
+}
+
+ReadbackFuture ReadbackRing::ReadTexture(ID3D12GraphicsCommandList* cl, ID3D12Resource* source, UINT subresource)
+{
+	D3D12_RESOURCE_DESC desc = source->GetDesc();
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+	UINT64 size_in_bytes;
+	mDevice->GetDevice()->GetCopyableFootprints(&desc, subresource, 1, 0, &footprint, nullptr, nullptr, &size_in_bytes);
+
+	ID3D12Resource* resource;
+	uint64_t offset;
+	auto region = Allocate(size_in_bytes, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, resource, offset);
+
+	footprint.Offset = offset;
+	CD3DX12_TEXTURE_COPY_LOCATION destination_location(resource, footprint);
+	CD3DX12_TEXTURE_COPY_LOCATION source_location(source, subresource);
+	cl->CopyTextureRegion(&destination_location, 0, 0, 0, &source_location, nullptr);
+
+	// The data starts at the footprint, so the returned one is relative to it
+	footprint.Offset = 0;
+	return AddPending(cl, std::move(region), size_in_bytes, footprint);
+}
+
+void ReadbackRing::Submit(ID3D12CommandList* const* lists, UINT count)
+{
+	std::scoped_lock lock(mLock);
+
+	for (Pending& pending : mOpenBatch)
+	{
+		if (std::find(lists, lists + count, pending.list) != lists + count)
+			pending.submitted = true;
+	}
+}
+
+void ReadbackRing::CloseBatch(uint64_t fence_value)
+{
+	{
+		std::scoped_lock lock(mLock);
+
+		Batch batch = { fence_value };
+		size_t open_count = 0;
+		for (Pending& pending : mOpenBatch)
+		{
+			if (pending.submitted)
+				batch.copies.push_back(std::move(pending));
+			else
+				mOpenBatch[open_count++] = std::move(pending);
+		}
+		mOpenBatch.resize(open_count);
+
+		if (batch.copies.empty())
+			return;
+
+		mBatches.push_back(std::move(batch));
+	}
+	mBatchClosed.notify_one();
+}
+
+void ReadbackRing::WaitForBatches()
+{
+	while (true)
+	{
+		uint64_t fence_value;
+		{
+			std::unique_lock lock(mLock);
+			mBatchClosed.wait(lock, [this]() { return mClosing || !mBatches.empty(); });
+			if (mBatches.empty())
+				return;
+
+			fence_value = mBatches.front().fence_value;
+		}
+
+		// Own event, as the device one can be used at the same time from other threads
+		mDevice->WaitForWork(mQueue, fence_value, mFenceEvent);
+
+		Batch batch;
+		{
+			std::scoped_lock lock(mLock);
+			batch = std::move(mBatches.front());
+			mBatches.pop_front();
+		}
+
+		for (Pending& pending : batch.copies)
+		{
+			ReadbackData data;
+			data.mRegion = std::move(pending.region);
+			data.mSize = pending.size;
+			data.mFootprint = pending.footprint;
+			pending.promise.set_value(std::move(data));
+		}
+	}
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include "../Core/stdafx.h"
+
+namespace FrameDX12
+{
+	enum class QueueType;
+
+	// Data copied back from the GPU, on the mapped memory of the readback ring
+	// It holds its range of the ring until destroyed, so drop it (and the futures pointing to it) once the data was consumed
+	// Needs to be destroyed before the device
+	class ReadbackData
+	{
+	public:
+		bool IsValid() const { return mRegion != nullptr; }
+
+		// Zero copy view of the data. Read only, writing to readback memory is really slow
+		std::span<const uint8_t> GetData() const { return { mRegion->cpu_ptr, mSize }; }
+
+		template<typename T>
+		std::span<const T> GetDataAs() const { return { reinterpret_cast<const T*>(mRegion->cpu_ptr), mSize / sizeof(T) }; }
+
+		// Only for textures. Offset is relative to GetData, rows are RowPitch bytes apart
+		const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& GetFootprint() const { return mFootprint; }
+	private:
+		friend class ReadbackRing;
+
+		// Frees the range of the ring when the last copy of the data is destroyed
+		struct Region
+		{
+			uint64_t end; // Virtual offset on the ring
+			const uint8_t* cpu_ptr;
+			ComPtr<ID3D12Resource> dedicated; // Set if it didn't fit on the ring
+		};
+
+		std::shared_ptr<Region> mRegion;
+		uint64_t mSize = 0;
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT mFootprint = {};
+	};
+
+	using ReadbackFuture = std::shared_future<ReadbackData>;
+
+	// Persistently mapped READBACK buffer used as a ring, for copies from GPU resources to the CPU
+	// Copies are tagged with the command list that records them. Device::ExecuteCommandLists marks the ones of the submitted lists, and the
+	//  next signal of the queue tags them with its fence value (the Device calls CloseBatch when signaling), as with the upload ring
+	// Copies of lists that are not submitted yet are left for a later signal, so their futures never complete before the data is there
+	// A thread waits on the fence, and resolves the futures when the GPU is done. Nothing stalls the frame
+	// Ranges are freed when their ReadbackData is destroyed, in any order. Copies that don't fit get a dedicated resource instead of waiting
+	// Thread safe
+	class ReadbackRing
+	{
+	public:
+		ReadbackRing() = default;
+		ReadbackRing(const ReadbackRing&) = delete;
+		ReadbackRing& operator=(const ReadbackRing&) = delete;
+		// The device needs to have waited for the queue, the futures of lists that were never submitted get a broken promise
+		~ReadbackRing();
+
+		// The buffer and the thread are created on the first copy, so unused rings don't take anything
+		void Initialize(class Device* device, QueueType queue, uint64_t size);
+
+		// Records the copy of a range of a buffer. The source needs to be on COPY_SOURCE (or GENERIC_READ for upload heaps)
+		ReadbackFuture ReadBuffer(ID3D12GraphicsCommandList* cl, ID3D12Resource* source, uint64_t source_offset, uint64_t size_in_bytes);
+
+		// Records the copy of a subresource of a texture. The source needs to be on COPY_SOURCE
+		ReadbackFuture ReadTexture(ID3D12GraphicsCommandList* cl, ID3D12Resource* source, UINT subresource = 0);
+
+		// Marks the copies of the lists as submitted. Called by Device::ExecuteCommandLists after the lists are on the queue
+		void Submit(ID3D12CommandList* const* lists, UINT count);
+
+		// Tags the copies submitted since the last call with the fence value
+		void CloseBatch(uint64_t fence_value);
+	private:
+		struct Pending
+		{
+			ID3D12CommandList* list;
+			bool submitted;
+			std::shared_ptr<ReadbackData::Region> region;
+			uint64_t size;
+			D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+			std::promise<ReadbackData> promise;
+		};
+
+		struct Batch
+		{
+			uint64_t fence_value;
+			std::vector<Pending> copies;
+		};
+
+		// Returns the region and the offset of the allocation on its resource
+		std::shared_ptr<ReadbackData::Region> Allocate(uint64_t size, uint64_t alignment, ID3D12Resource*& resource, uint64_t& offset);
+		ReadbackFuture AddPending(ID3D12CommandList* cl, std::shared_ptr<ReadbackData::Region> region, uint64_t size, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint);
+		void Release(ReadbackData::Region* region);
+		void WaitForBatches();
+
+		std::mutex mLock;
+
+		ComPtr<ID3D12Resource> mResource;
+		uint8_t* mMappedMem = nullptr;
+		uint64_t mSize = 0;
+
+		// Virtual offsets, as on the upload ring
+		uint64_t mHead = 0;
+		uint64_t mTail = 0;
+
+		// Regions on the ring in allocation order. Released ones stay until everything before them is released too
+		struct Allocation
+		{
+			uint64_t start;
+			uint64_t end;
+			bool released;
+		};
+		std::deque<Allocation> mAllocations;
+
+		std::vector<Pending> mOpenBatch; // Recorded copies without a fence value yet
+		std::deque<Batch> mBatches; // Closed, waiting for the GPU
+
+		std::thread mWaiter;
+		std::condition_variable mBatchClosed;
+		bool mClosing = false;
+		HANDLE mFenceEvent = nullptr;
+
+		QueueType mQueue;
+		class Device* mDevice = nullptr;
+	};
+}
@@ -6,10 +6,10 @@ using namespace FrameDX12;
 
 void RenderTarget::CreateFromSwapchain(Device* device)
 {
-	mStates = D3D12_RESOURCE_STATE_PRESENT;
 	mHandle.Construct([this, device](uint8_t i)
 	{
 		ThrowIfFailed(device->GetSwapChain()->GetBuffer(i, IID_PPV_ARGS(&mResource[i])));
+		mStates[i] = std::make_unique<ResourceStates>(mResource[i].Get(), 1, D3D12_RESOURCE_STATE_PRESENT);
 
 		Descriptor handle = device->GetDescriptorPool(D3D12_DESCRIPTOR_HEAP_TYPE_RTV).GetNextDescriptor();
 		device->GetDevice()->CreateRenderTargetView(mResource[i].Get(), nullptr, *handle);
@@ -19,10 +19,5 @@ void RenderTarget::CreateFromSwapchain(Device* device)
 
 void RenderTarget::Transition(ID3D12GraphicsCommandList* cl, D3D12_RESOURCE_STATES new_states)
 {
-	if (mStates != new_states)
-	{
-		CD3DX12_RESOURCE_BARRIER transitions[] = { CD3DX12_RESOURCE_BARRIER::Transition(GetResource().Get(), mStates, new_states) };
-		cl->ResourceBarrier(1, transitions);
-		mStates = new_states;
-	}
+	ResourceStateTracker::Transition(cl, *mStates[sCurrentResourceBufferIndex % kResourceBufferCount], new_states);
 }
\ No newline at end of file
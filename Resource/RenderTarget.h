@@ -1,6 +1,7 @@
 #pragma once
 #include "BufferedResource.h"
 #include "DescriptorPool.h"
+#include "ResourceStateTracker.h"
 
 namespace FrameDX12
 {
@@ -9,6 +10,7 @@ namespace FrameDX12
 	class RenderTarget : public BufferedResource<ComPtr<ID3D12Resource>>
 	{
 	public:
+		// Transitions the current buffer. See CommitedResource::Transition
 		void Transition(ID3D12GraphicsCommandList* cl, D3D12_RESOURCE_STATES new_states);
 
 		// Creates the render target taking the buffers from the swap chain
@@ -18,7 +20,7 @@ namespace FrameDX12
 		void CreateFromSwapchain(Device* device);
 		Descriptor GetHandle() const { return *mHandle; }
 	private:
-		D3D12_RESOURCE_STATES mStates;
+		std::unique_ptr<ResourceStates> mStates[kResourceBufferCount]; // Each buffer has its own states
 		BufferedResource<Descriptor> mHandle;
 	};
 }
\ No newline at end of file
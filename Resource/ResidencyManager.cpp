@@ -0,0 +1,191 @@
+#include "ResidencyManager.h"
+#include <algorithm>
+
+using namespace FrameDX12;
+
+ResidencyManager::~ResidencyManager()
+{
+	for (Object* object : mObjects)
+		delete object;
+}
+
+ResidencyManager::Object* ResidencyManager::Register(void* pageable, uint64_t size)
+{
+	Object* object = new Object(pageable, size, mFrameNumber.load(std::memory_order_relaxed));
+
+	std::scoped_lock lock(mLock);
+	mObjects.insert(object);
+	mResidentBytes += size;
+
+	return object;
+}
+
+void ResidencyManager::Unregister(Object* object)
+{
+	if (!object)
+		return;
+
+	std::scoped_lock lock(mLock);
+	if (object->pending)
+		mToMakeResident.erase(std::find(mToMakeResident.begin(), mToMakeResident.end(), object));
+
+	if (object->resident)
+		mResidentBytes -= object->size;
+	else
+		mEvictedBytes -= object->size;
+
+	mObjects.erase(object);
+	delete object;
+}
+
+void ResidencyManager::MarkUsed(Object* object)
+{
+	// Sequentially consistent, PrepareSubmit does the opposite (clears resident, then reads the frame), so at least one of them sees the other
+	object->last_used_frame.store(mFrameNumber.load(std::memory_order_relaxed));
+	if (object->resident.load())
+		return;
+
+	std::scoped_lock lock(mLock);
+	if (!object->pending)
+	{
+		object->pending = true;
+		mToMakeResident.push_back(object);
+	}
+}
+
+void ResidencyManager::AdvanceFrame(uint64_t frame_number)
+{
+	mFrameNumber.store(frame_number, std::memory_order_relaxed);
+
+	if (mQueryBudget)
+	{
+		Budget budget = mQueryBudget();
+
+		std::scoped_lock lock(mLock);
+		mOSBudget = budget;
+		mUsageSinceQuery = 0;
+	}
+}
+
+uint64_t ResidencyManager::GetExcess(uint64_t incoming_bytes) const
+{
+	uint64_t excess = 0;
+
+	if (mBudgetLimit != 0 && mResidentBytes + incoming_bytes > mBudgetLimit)
+		excess = mResidentBytes + incoming_bytes - mBudgetLimit;
+
+	// The OS usage includes memory the manager doesn't know about (swapchain, other processes on the same segment)
+	int64_t os_usage = (int64_t)mOSBudget.usage + mUsageSinceQuery + (int64_t)incoming_bytes;
+	if (os_usage > 0 && (uint64_t)os_usage > mOSBudget.budget)
+		excess = std::max(excess, (uint64_t)os_usage - mOSBudget.budget);
+
+	return excess;
+}
+
+void ResidencyManager::PrepareSubmit()
+{
+	std::scoped_lock lock(mLock);
+
+	// Objects that are pending and were already restored by someone else are skipped
+	uint64_t incoming_bytes = 0;
+	size_t restores_count = 0;
+	for (Object* object : mToMakeResident)
+	{
+		object->pending = false;
+		if (!object->resident)
+		{
+			mToMakeResident[restores_count++] = object;
+			incoming_bytes += object->size;
+		}
+	}
+	mToMakeResident.resize(restores_count);
+
+	uint64_t excess = GetExcess(incoming_bytes);
+	if (excess > 0)
+	{
+		uint64_t frame = mFrameNumber.load(std::memory_order_relaxed);
+		uint64_t last_evictable_frame = frame >= mFramesInFlight ? frame - mFramesInFlight : 0;
+
+		mCandidates.clear();
+		for (Object* object : mObjects)
+		{
+			if (object->resident && object->last_used_frame.load(std::memory_order_relaxed) < last_evictable_frame)
+				mCandidates.push_back(object);
+		}
+
+		// Least recently used first
+		std::sort(mCandidates.begin(), mCandidates.end(), [](const Object* a, const Object* b)
+		{
+			return a->last_used_frame.load(std::memory_order_relaxed) < b->last_used_frame.load(std::memory_order_relaxed);
+		});
+
+		mPageables.clear();
+		uint64_t evicted_bytes = 0;
+		for (Object* object : mCandidates)
+		{
+			if (evicted_bytes >= excess)
+				break;
+
+			object->resident.store(false);
+
+			// Someone started recording with it after the candidates were taken
+			if (object->last_used_frame.load() >= last_evictable_frame)
+			{
+				object->resident.store(true);
+				continue;
+			}
+
+			mPageables.push_back(object->pageable);
+			evicted_bytes += object->size;
+		}
+
+		if (!mPageables.empty())
+		{
+			mEvict(mPageables);
+
+			mResidentBytes -= evicted_bytes;
+			mEvictedBytes += evicted_bytes;
+			mUsageSinceQuery -= (int64_t)evicted_bytes;
+			mEvictions += mPageables.size();
+		}
+	}
+
+	if (!mToMakeResident.empty())
+	{
+		mPageables.clear();
+		for (Object* object : mToMakeResident)
+			mPageables.push_back(object->pageable);
+
+		mMakeResident(mPageables);
+
+		for (Object* object : mToMakeResident)
+			object->resident.store(true);
+
+		mResidentBytes += incoming_bytes;
+		mEvictedBytes -= incoming_bytes;
+		mUsageSinceQuery += (int64_t)incoming_bytes;
+		mRestores += mToMakeResident.size();
+		mToMakeResident.clear();
+	}
+}
+
+void ResidencyManager::SetBudget(uint64_t size_in_bytes)
+{
+	std::scoped_lock lock(mLock);
+	mBudgetLimit = size_in_bytes;
+}
+
+ResidencyManager::Stats ResidencyManager::GetStats()
+{
+	std::scoped_lock lock(mLock);
+
+	Stats stats;
+	stats.objects_count = mObjects.size();
+	stats.resident_bytes = mResidentBytes;
+	stats.evicted_bytes = mEvictedBytes;
+	stats.budget_bytes = mBudgetLimit != 0 ? std::min(mBudgetLimit, mOSBudget.budget) : mOSBudget.budget;
+	stats.evictions = mEvictions;
+	stats.restores = mRestores;
+
+	return stats;
+}
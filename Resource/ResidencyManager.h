@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <unordered_set>
+#include <functional>
+#include <mutex>
+#include <atomic>
+
+// No D3D on this file, the objects are opaque pointers and the budget comes from a callback, so the policy can be used against a fake budget
+
+namespace FrameDX12
+{
+	// Keeps the video memory used by the GPU objects (heaps, committed resources) under a budget, evicting the least recently used ones
+	// Each object is registered with its size, and marked as used by the frames that record command lists referencing it
+	// PrepareSubmit is called before executing command lists. It makes resident the evicted objects that were used since the last call, and
+	//  if the resident objects don't fit on the budget it evicts the ones unused for the longest time. Both are done with a single batched call
+	// Objects used on the last frames_in_flight frames are never evicted, as the GPU could still be reading them
+	// Thread safe. MarkUsed is lock free unless the object is evicted
+	class ResidencyManager
+	{
+	public:
+		// Values reported by the OS for the memory segment, in bytes
+		struct Budget
+		{
+			uint64_t budget;
+			uint64_t usage;
+		};
+
+		struct Object
+		{
+			Object(void* pageable, uint64_t size, uint64_t frame) : pageable(pageable), size(size), last_used_frame(frame) {}
+
+			void* pageable;
+			uint64_t size;
+			std::atomic<uint64_t> last_used_frame;
+			std::atomic<bool> resident = true;
+			bool pending = false; // On the make resident list, only touched with the lock taken
+		};
+
+		struct Stats
+		{
+			uint64_t objects_count;
+			uint64_t resident_bytes;
+			uint64_t evicted_bytes;
+			uint64_t budget_bytes; // The smallest of the configured budget and the OS one
+			uint64_t evictions; // Objects evicted since the start
+			uint64_t restores; // Objects made resident again since the start
+		};
+
+		using PageablesCallback = std::function<void(const std::vector<void*>&)>;
+
+		// query_budget is called once per frame, on AdvanceFrame. It can be null if only the configured budget is used
+		// evict and make_resident get all the objects of a submit at once
+		ResidencyManager(uint32_t frames_in_flight, std::function<Budget()> query_budget, PageablesCallback evict, PageablesCallback make_resident) :
+			mFramesInFlight(frames_in_flight),
+			mQueryBudget(std::move(query_budget)),
+			mEvict(std::move(evict)),
+			mMakeResident(std::move(make_resident))
+		{}
+		ResidencyManager(const ResidencyManager&) = delete;
+		ResidencyManager& operator=(const ResidencyManager&) = delete;
+		~ResidencyManager();
+
+		// New objects are resident, and count as used on the current frame
+		Object* Register(void* pageable, uint64_t size);
+		// The object can't be used after this. It's not evicted, destroying the pageable is up to the caller
+		void Unregister(Object* object);
+
+		// Call it when recording commands that reference the object
+		void MarkUsed(Object* object);
+
+		// Updates the frame used to stamp the objects and queries the OS budget
+		void AdvanceFrame(uint64_t frame_number);
+
+		// Makes resident the objects needed by the lists about to be submitted and evicts the least recently used ones if over budget
+		void PrepareSubmit();
+
+		// Limit for the memory of the registered objects, on top of the OS budget. 0 means only the OS budget is used
+		void SetBudget(uint64_t size_in_bytes);
+
+		Stats GetStats();
+	private:
+		// Bytes that need to be evicted so the resident objects, plus incoming_bytes, fit on the budget
+		uint64_t GetExcess(uint64_t incoming_bytes) const;
+
+		std::mutex mLock;
+
+		uint32_t mFramesInFlight;
+		std::atomic<uint64_t> mFrameNumber = 0;
+
+		std::function<Budget()> mQueryBudget;
+		PageablesCallback mEvict;
+		PageablesCallback mMakeResident;
+
+		std::unordered_set<Object*> mObjects;
+		std::vector<Object*> mToMakeResident;
+		uint64_t mResidentBytes = 0;
+		uint64_t mEvictedBytes = 0;
+
+		uint64_t mBudgetLimit = 0;
+		Budget mOSBudget = { UINT64_MAX, 0 };
+		int64_t mUsageSinceQuery = 0; // What the manager evicted and restored since the OS budget was queried
+
+		uint64_t mEvictions = 0;
+		uint64_t mRestores = 0;
+
+		// Scratch
+		std::vector<Object*> mCandidates;
+		std::vector<void*> mPageables;
+	};
+}
@@ -0,0 +1,236 @@
+#include "ResourceStateTracker.h"
+
+using namespace FrameDX12;
+
+std::recursive_mutex ResourceStateTracker::sGlobalStatesLock;
+std::vector<ResourceStateTracker::Decay> ResourceStateTracker::sDecays;
+std::mutex ResourceStateTracker::sListTrackersLock;
+std::unordered_map<ID3D12CommandList*, std::unique_ptr<ResourceStateTracker>> ResourceStateTracker::sListTrackers;
+
+namespace
+{
+	struct CurrentTracker
+	{
+		ID3D12GraphicsCommandList* cl = nullptr;
+		ResourceStateTracker* tracker = nullptr;
+	};
+	thread_local CurrentTracker tCurrentTracker;
+
+	// Buffers and simultaneous access textures can be promoted to any state, other textures only to the shader resource and copy ones
+	bool CanPromote(const ResourceStates& resource, D3D12_RESOURCE_STATES states)
+	{
+		constexpr D3D12_RESOURCE_STATES texture_states = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE |
+														 D3D12_RESOURCE_STATE_COPY_DEST | D3D12_RESOURCE_STATE_COPY_SOURCE;
+		return resource.stateless || (states & ~texture_states) == 0;
+	}
+
+	bool IsReadOnly(D3D12_RESOURCE_STATES states)
+	{
+		constexpr D3D12_RESOURCE_STATES write_states = D3D12_RESOURCE_STATE_RENDER_TARGET | D3D12_RESOURCE_STATE_UNORDERED_ACCESS |
+													   D3D12_RESOURCE_STATE_DEPTH_WRITE | D3D12_RESOURCE_STATE_STREAM_OUT |
+													   D3D12_RESOURCE_STATE_COPY_DEST | D3D12_RESOURCE_STATE_RESOLVE_DEST;
+		return (states & write_states) == 0;
+	}
+
+	// Adds the barriers needed to go from the states on from to new_states
+	// Subresources with unknown states don't get a barrier, they are set on pending instead (if provided)
+	void AddTransitions(ID3D12Resource* resource, const SubresourceStates& from, D3D12_RESOURCE_STATES new_states, UINT subresource,
+						std::vector<D3D12_RESOURCE_BARRIER>& barriers, SubresourceStates* pending)
+	{
+		auto add = [&](UINT target_subresource, D3D12_RESOURCE_STATES before)
+		{
+			if (before == SubresourceStates::kUnknown)
+			{
+				if (pending) pending->Set(target_subresource, new_states);
+			}
+			else if (before != new_states)
+			{
+				barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, before, new_states, target_subresource));
+			}
+		};
+
+		if (subresource != D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+		{
+			add(subresource, from.Get(subresource));
+		}
+		else if (from.IsUniform())
+		{
+			add(D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, from.Get(0));
+		}
+		else
+		{
+			for (uint32_t idx = 0; idx < from.GetCount(); idx++)
+				add(idx, from.Get(idx));
+		}
+	}
+}
+
+void SubresourceStates::Set(uint32_t subresource, D3D12_RESOURCE_STATES states)
+{
+	if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+	{
+		mAll = states;
+		mPerSubresource.clear();
+		return;
+	}
+
+	if (IsUniform())
+	{
+		if (mAll == states)
+			return;
+		mPerSubresource.assign(mCount, mAll);
+	}
+
+	mPerSubresource[subresource] = states;
+
+	// Go back to a single value if all the subresources match again
+	if (std::all_of(mPerSubresource.begin(), mPerSubresource.end(), [states](D3D12_RESOURCE_STATES other) { return other == states; }))
+	{
+		mAll = states;
+		mPerSubresource.clear();
+	}
+}
+
+void ResourceStateTracker::SetCurrent(ID3D12GraphicsCommandList* cl, ResourceStateTracker* tracker)
+{
+	tCurrentTracker.cl = cl;
+	tCurrentTracker.tracker = tracker;
+}
+
+void ResourceStateTracker::Transition(ID3D12GraphicsCommandList* cl, ResourceStates& resource, D3D12_RESOURCE_STATES new_states, UINT subresource)
+{
+	TransitionRequest request = { &resource, new_states, subresource };
+	Transition(cl, std::span<const TransitionRequest>(&request, 1));
+}
+
+void ResourceStateTracker::Transition(ID3D12GraphicsCommandList* cl, std::span<const TransitionRequest> requests)
+{
+	if (tCurrentTracker.cl == cl && tCurrentTracker.tracker)
+	{
+		tCurrentTracker.tracker->Record(cl, requests);
+		return;
+	}
+
+	// A list is only recorded from one thread at a time, so only the lookup needs the lock
+	ResourceStateTracker* tracker;
+	{
+		std::scoped_lock lock(sListTrackersLock);
+		auto& list_tracker = sListTrackers[cl];
+		if (!list_tracker)
+			list_tracker = std::make_unique<ResourceStateTracker>();
+		tracker = list_tracker.get();
+	}
+	tracker->Record(cl, requests);
+}
+
+void ResourceStateTracker::Record(ID3D12GraphicsCommandList* cl, std::span<const TransitionRequest> requests)
+{
+	mBarriers.clear();
+
+	for (const TransitionRequest& request : requests)
+	{
+		ResourceStates& resource = *request.resource;
+
+		auto [entry_it, inserted] = mEntries.try_emplace(&resource);
+		Entry& entry = entry_it->second;
+		if (inserted)
+		{
+			entry.resource = &resource;
+			entry.pending = SubresourceStates(resource.states.GetCount(), SubresourceStates::kUnknown);
+			entry.current = SubresourceStates(resource.states.GetCount(), SubresourceStates::kUnknown);
+		}
+
+		// The first use of each subresource doesn't get a barrier here, Resolve takes care of it
+		AddTransitions(resource.resource, entry.current, request.new_states, request.subresource, mBarriers, &entry.pending);
+		entry.current.Set(request.subresource, request.new_states);
+	}
+
+	if (!mBarriers.empty())
+		cl->ResourceBarrier(mBarriers.size(), mBarriers.data());
+}
+
+void ResourceStateTracker::Resolve(std::vector<D3D12_RESOURCE_BARRIER>& barriers, bool copy_queue)
+{
+	for (auto& [key, entry] : mEntries)
+	{
+		ResourceStates& resource = *entry.resource;
+		SubresourceStates& global = resource.states;
+
+		// Whole resource barriers while both sides are uniform, per subresource otherwise
+		bool uniform = entry.pending.IsUniform() && global.IsUniform();
+		uint32_t count = uniform ? 1 : entry.pending.GetCount();
+		for (uint32_t idx = 0; idx < count; idx++)
+		{
+			UINT subresource = uniform ? D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES : idx;
+			D3D12_RESOURCE_STATES needed = entry.pending.Get(idx);
+			D3D12_RESOURCE_STATES before = global.Get(idx);
+			if (needed == SubresourceStates::kUnknown || needed == before)
+				continue;
+
+			if (before == D3D12_RESOURCE_STATE_COMMON && CanPromote(resource, needed))
+			{
+				// Promoted to a read only state goes back to COMMON after the submission, unless the list moved it on
+				if (IsReadOnly(needed) && entry.current.Get(idx) == needed)
+					sDecays.push_back({ &resource, subresource });
+				continue;
+			}
+
+			barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource.resource, before, needed, subresource));
+		}
+
+		// After the list the subresources it used are on their final states
+		// Stateless resources, and everything used on the copy queue, decay to COMMON when the submission ends
+		bool decays = resource.stateless || copy_queue;
+		if (entry.current.IsUniform())
+		{
+			if (entry.current.Get(0) != SubresourceStates::kUnknown)
+			{
+				global.Set(D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, entry.current.Get(0));
+				if (decays) sDecays.push_back({ &resource, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES });
+			}
+		}
+		else
+		{
+			for (uint32_t idx = 0; idx < entry.current.GetCount(); idx++)
+			{
+				if (entry.current.Get(idx) != SubresourceStates::kUnknown)
+				{
+					global.Set(idx, entry.current.Get(idx));
+					if (decays) sDecays.push_back({ &resource, idx });
+				}
+			}
+		}
+	}
+
+	mEntries.clear();
+}
+
+bool ResourceStateTracker::ResolveList(ID3D12CommandList* cl, std::vector<D3D12_RESOURCE_BARRIER>& barriers, bool copy_queue)
+{
+	std::unique_ptr<ResourceStateTracker> tracker;
+	{
+		std::scoped_lock lock(sListTrackersLock);
+		auto entry = sListTrackers.find(cl);
+		if (entry == sListTrackers.end())
+			return false;
+
+		tracker = std::move(entry->second);
+		sListTrackers.erase(entry);
+	}
+
+	tracker->Resolve(barriers, copy_queue);
+	return true;
+}
+
+void ResourceStateTracker::DiscardList(ID3D12CommandList* cl)
+{
+	std::scoped_lock lock(sListTrackersLock);
+	sListTrackers.erase(cl);
+}
+
+void ResourceStateTracker::FinishSubmit()
+{
+	for (const Decay& decay : sDecays)
+		decay.resource->states.Set(decay.subresource, D3D12_RESOURCE_STATE_COMMON);
+	sDecays.clear();
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include "../Core/stdafx.h"
+
+namespace FrameDX12
+{
+	// States of all the subresources of a resource. Stored as a single value while all the subresources share it
+	class SubresourceStates
+	{
+	public:
+		static constexpr D3D12_RESOURCE_STATES kUnknown = (D3D12_RESOURCE_STATES)-1;
+
+		SubresourceStates() = default;
+		SubresourceStates(uint32_t subresources_count, D3D12_RESOURCE_STATES states) :
+			mCount(subresources_count),
+			mAll(states)
+		{}
+
+		uint32_t GetCount() const { return mCount; }
+		bool IsUniform() const { return mPerSubresource.empty(); }
+		D3D12_RESOURCE_STATES Get(uint32_t subresource) const { return IsUniform() ? mAll : mPerSubresource[subresource]; }
+
+		// Use D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES to set all of them
+		void Set(uint32_t subresource, D3D12_RESOURCE_STATES states);
+	private:
+		uint32_t mCount = 1;
+		D3D12_RESOURCE_STATES mAll = kUnknown;
+		std::vector<D3D12_RESOURCE_STATES> mPerSubresource; // Empty while uniform
+	};
+
+	// Global states of a resource, the ones it has after all the submitted work
+	// Trackers keep pointers to it, so the owner should keep it on the heap to have a stable address
+	struct ResourceStates
+	{
+		ResourceStates(ID3D12Resource* resource, uint32_t subresources_count, D3D12_RESOURCE_STATES initial_states) :
+			resource(resource),
+			states(subresources_count, initial_states)
+		{}
+
+		ID3D12Resource* resource;
+		SubresourceStates states;
+		std::atomic<uint32_t> used_queues = 0; // Device::GetQueueBit of the queues whose lists used it, see CommitedResource::MarkUsed
+		std::atomic<bool> needs_discard = false; // Placed render target or depth buffer not initialized yet, see CommitedResource::Transition
+		bool stateless = false; // Buffers and simultaneous access textures, promoted to anything from COMMON and decayed after every submission
+	};
+
+	// Tracks the transitions recorded on a command list without touching the global states, so lists can be recorded in parallel
+	// The first state each subresource needs on the list is kept as pending. When submitting, Resolve returns the barriers needed to get
+	//  there from the global states, and those go on a fix-up list executed right before
+	// CommandGraph gives a tracker to each worker list. Lists recorded elsewhere get one on their first transition, which
+	//  Device::ExecuteCommandLists resolves
+	// The implicit promotion from COMMON and the decay back to it at the end of each ExecuteCommandLists are modelled, so the global
+	//  states match the GPU ones after the submission
+	class ResourceStateTracker
+	{
+	public:
+		// Adds the barriers needed to get the subresource to new_states to the list
+		// Goes to the tracker the calling thread set for the list (see SetCurrent), or to the one of the list if there's none
+		static void Transition(ID3D12GraphicsCommandList* cl, ResourceStates& resource, D3D12_RESOURCE_STATES new_states, UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+
+		struct TransitionRequest
+		{
+			ResourceStates* resource;
+			D3D12_RESOURCE_STATES new_states;
+			UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		};
+
+		// Same, for many resources at once. All the barriers go on a single ResourceBarrier call
+		static void Transition(ID3D12GraphicsCommandList* cl, std::span<const TransitionRequest> requests);
+
+		// Sets the tracker used for the list on the calling thread
+		static void SetCurrent(ID3D12GraphicsCommandList* cl, ResourceStateTracker* tracker);
+
+		// Adds to barriers the transitions needed before the list, so the global states match the pending states of the tracker
+		// Then updates the global states with the final states of the list, and clears the tracker
+		// Lists need to be resolved in the same order they are submitted, hold GetSubmitLock from the first resolve until FinishSubmit
+		void Resolve(std::vector<D3D12_RESOURCE_BARRIER>& barriers, bool copy_queue);
+
+		// Same, for the tracker of a list recorded without one set (see Transition). Returns false if the list has none
+		static bool ResolveList(ID3D12CommandList* cl, std::vector<D3D12_RESOURCE_BARRIER>& barriers, bool copy_queue);
+
+		// Drops the tracker of a list recorded without one set. Call it if you reset such a list without submitting it
+		static void DiscardList(ID3D12CommandList* cl);
+
+		// Moves the resources that decay to COMMON there. Call it right after the ExecuteCommandLists of the resolved lists
+		static void FinishSubmit();
+
+		// Recursive, so code holding it while resolving can submit through Device::ExecuteCommandLists
+		static std::recursive_mutex& GetSubmitLock() { return sGlobalStatesLock; }
+	private:
+		struct Entry
+		{
+			ResourceStates* resource;
+			SubresourceStates pending; // First state needed on the list, unknown for the subresources not used
+			SubresourceStates current; // State at the end of what was recorded so far
+		};
+
+		// Records the transitions on the tracker, with barriers only for the subresources the list already used
+		void Record(ID3D12GraphicsCommandList* cl, std::span<const TransitionRequest> requests);
+
+		std::unordered_map<ResourceStates*, Entry> mEntries;
+		std::vector<D3D12_RESOURCE_BARRIER> mBarriers; // Scratch, to avoid allocating on every transition
+
+		// Guards the global states
+		static std::recursive_mutex sGlobalStatesLock;
+
+		// Subresources that go back to COMMON when the submission being resolved ends. Guarded by the global states lock
+		struct Decay
+		{
+			ResourceStates* resource;
+			UINT subresource;
+		};
+		static std::vector<Decay> sDecays;
+
+		// Trackers of the lists recorded without one set
+		static std::mutex sListTrackersLock;
+		static std::unordered_map<ID3D12CommandList*, std::unique_ptr<ResourceStateTracker>> sListTrackers;
+	};
+}
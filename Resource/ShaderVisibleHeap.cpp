@@ -0,0 +1,198 @@
+#include "ShaderVisibleHeap.h"
+#include "BufferedResource.h"
+#include "../Device/Device.h"
+#include "../Core/Log.h"
+
+using namespace FrameDX12;
+
+void ShaderVisibleHeap::Initialize(Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, UINT size, UINT bindless_size)
+{
+	mDevicePtr = device;
+	mType = type;
+
+	D3D12_DESCRIPTOR_HEAP_DESC desc;
+	desc.NodeMask = 0;
+	desc.NumDescriptors = size;
+	desc.Type = type;
+	desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	ThrowIfFailed(mDevicePtr->GetDevice()->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&mHeap)));
+
+	mEntrySize = device->GetDevice()->GetDescriptorHandleIncrementSize(type);
+	mSize = size;
+	mTop = bindless_size; // Tables start after the bindless range
+	mBindlessIndexes.Initialize(bindless_size);
+	mCPUHeapStart = mHeap->GetCPUDescriptorHandleForHeapStart();
+	mGPUHeapStart = mHeap->GetGPUDescriptorHandleForHeapStart();
+}
+
+ShaderVisibleHeap::~ShaderVisibleHeap()
+{
+	if (mHeap) mHeap->Release();
+}
+
+UINT ShaderVisibleHeap::GetSizeClass(UINT count)
+{
+	UINT size_class = 0;
+	while ((1u << size_class) < count) ++size_class;
+	return size_class;
+}
+
+size_t ShaderVisibleHeap::KeyHash::operator()(const std::vector<uint64_t>& key) const
+{
+	// The ids are unique, so just mix them
+	size_t hash_val = 14695981039346656037ull;
+	for (uint64_t id : key)
+	{
+		hash_val ^= id;
+		hash_val *= 1099511628211ull;
+	}
+	return hash_val;
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE ShaderVisibleHeap::GetTable(const Descriptor* descriptors, UINT count)
+{
+	using namespace std;
+
+	// Reuse the key storage so lookups of existing tables don't allocate
+	thread_local vector<uint64_t> key;
+	key.resize(count);
+	for (UINT i = 0; i < count; i++)
+		key[i] = descriptors[i].GetId();
+
+	{
+		shared_lock lock(mLock);
+
+		auto entry = mTables.find(key);
+		if (entry != mTables.end())
+		{
+			entry->second.last_used_frame = mFrameNumber;
+			return CD3DX12_GPU_DESCRIPTOR_HANDLE(mGPUHeapStart, entry->second.offset, mEntrySize);
+		}
+	}
+
+	unique_lock lock(mLock);
+
+	// Someone may have built the same table while we were waiting for the lock
+	auto entry = mTables.find(key);
+	if (entry != mTables.end())
+	{
+		entry->second.last_used_frame = mFrameNumber;
+		return CD3DX12_GPU_DESCRIPTOR_HANDLE(mGPUHeapStart, entry->second.offset, mEntrySize);
+	}
+
+	if (!LogAssertAndContinue(count > 0 && GetSizeClass(count) < kSizeClasses, LogCategory::Error))
+		return CD3DX12_GPU_DESCRIPTOR_HANDLE(D3D12_DEFAULT);
+
+	UINT size_class = GetSizeClass(count);
+	UINT offset;
+	if (!mFreeBlocks[size_class].empty())
+	{
+		offset = mFreeBlocks[size_class].back();
+		mFreeBlocks[size_class].pop_back();
+	}
+	else
+	{
+		if (!LogAssertAndContinue(mTop + (1u << size_class) <= mSize, LogCategory::Error))
+		{
+			++mFailedAllocations;
+			return CD3DX12_GPU_DESCRIPTOR_HANDLE(D3D12_DEFAULT);
+		}
+
+		offset = mTop;
+		mTop += 1u << size_class;
+	}
+
+	auto& table = mTables.try_emplace(key).first->second;
+	table.offset = offset;
+	table.size_class = size_class;
+	table.last_used_frame = mFrameNumber;
+
+	// Queue the copy
+	mPendingDestStarts.push_back(CD3DX12_CPU_DESCRIPTOR_HANDLE(mCPUHeapStart, offset, mEntrySize));
+	mPendingDestSizes.push_back(count);
+	for (UINT i = 0; i < count; i++)
+	{
+		Descriptor& source = mPendingSources.emplace_back(descriptors[i]);
+		mPendingSrcStarts.push_back(*source);
+	}
+
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(mGPUHeapStart, offset, mEntrySize);
+}
+
+BindlessIndex ShaderVisibleHeap::PublishBindless(const Descriptor& descriptor)
+{
+	BindlessIndex index;
+
+	uint32_t slot = mBindlessIndexes.Allocate();
+	if (!LogAssertAndContinue(slot != BindlessIndexAllocator::kInvalidIndex, LogCategory::Error))
+		return index;
+
+	index.mRefCount = new std::atomic_int(1);
+	index.mHeap = this;
+	index.mIndex = slot;
+
+	std::unique_lock lock(mLock);
+
+	mPendingDestStarts.push_back(CD3DX12_CPU_DESCRIPTOR_HANDLE(mCPUHeapStart, slot, mEntrySize));
+	mPendingDestSizes.push_back(1);
+	Descriptor& source = mPendingSources.emplace_back(descriptor);
+	mPendingSrcStarts.push_back(*source);
+
+	return index;
+}
+
+void ShaderVisibleHeap::FlushCopies()
+{
+	std::unique_lock lock(mLock);
+
+	if (mPendingDestStarts.empty())
+		return;
+
+	// The sources are all single descriptors, so no need for the source sizes
+	mDevicePtr->GetDevice()->CopyDescriptors(
+		(UINT)mPendingDestStarts.size(), mPendingDestStarts.data(), mPendingDestSizes.data(),
+		(UINT)mPendingSrcStarts.size(), mPendingSrcStarts.data(), nullptr,
+		mType);
+
+	mPendingDestStarts.resize(0);
+	mPendingDestSizes.resize(0);
+	mPendingSrcStarts.resize(0);
+	mPendingSources.resize(0);
+}
+
+ShaderVisibleHeap::Stats ShaderVisibleHeap::GetStats()
+{
+	std::shared_lock lock(mLock);
+
+	Stats stats;
+	stats.capacity = mSize;
+	stats.cached_tables = (UINT)mTables.size();
+	stats.table_range_top = mTop - mBindlessIndexes.GetCapacity();
+	stats.free_blocks = 0;
+	for (auto& blocks : mFreeBlocks)
+		stats.free_blocks += (UINT)blocks.size();
+	stats.bindless_used = mBindlessIndexes.GetUsedCount();
+	stats.failed_allocations = mFailedAllocations;
+
+	return stats;
+}
+
+void ShaderVisibleHeap::AdvanceFrame(uint64_t frame_number)
+{
+	std::unique_lock lock(mLock);
+
+	mFrameNumber = frame_number;
+
+	for (auto entry = mTables.begin(); entry != mTables.end();)
+	{
+		if (entry->second.last_used_frame + kResourceBufferCount <= frame_number)
+		{
+			mFreeBlocks[entry->second.size_class].push_back(entry->second.offset);
+			entry = mTables.erase(entry);
+		}
+		else
+		{
+			++entry;
+		}
+	}
+}
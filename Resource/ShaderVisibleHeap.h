@@ -0,0 +1,111 @@
+#pragma once
+#include "../Core/stdafx.h"
+#include "DescriptorPool.h"
+#include "BindlessIndex.h"
+#include <shared_mutex>
+
+namespace FrameDX12
+{
+	// Shader visible heap where the descriptor tables are assembled
+	// Views are written on the (CPU only) staging pools, and copied here when a table that uses them is requested
+	// The heap is write-combined memory, so it's never read from nor written one view at a time
+	// ------------------------------------------------------------------------------------------------------------------
+	// Tables are cached by the ids of their source descriptors. Requesting a table that was already built returns the same
+	//  handle without copying anything, so tables that didn't change since last frame are free
+	// A table is released after it wasn't used for kResourceBufferCount frames, so it assumes that you wait for the work
+	//  of a frame before reusing that frame resources (the same assumption BufferedResource makes)
+	// ------------------------------------------------------------------------------------------------------------------
+	// Optionally the start of the heap can be reserved as a bindless range. Descriptors published there get a stable index
+	//  that shaders use to access an unbounded array (a single table starting at GetBindlessTable)
+	// ------------------------------------------------------------------------------------------------------------------
+	// As only one shader visible heap of each type can be bound, this heap never grows. Running out logs an error and
+	//  returns a null handle, GetStats reports how close you are to that
+	class ShaderVisibleHeap
+	{
+		friend class BindlessIndex;
+	public:
+		struct Stats
+		{
+			UINT capacity;
+			UINT cached_tables;
+			UINT table_range_top; // High water mark of the tables range
+			UINT free_blocks; // Blocks released and waiting to be reused
+			UINT bindless_used;
+			uint64_t failed_allocations;
+		};
+
+		~ShaderVisibleHeap();
+		// The first bindless_size entries of the heap are reserved for the bindless range, the rest are used for tables
+		void Initialize(class Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, UINT size, UINT bindless_size = 0);
+
+		// Returns a handle to a table with copies of the provided descriptors, in the same order
+		// All the descriptors need to be from a staging pool of the same type as the heap
+		// The copy is not done here but batched on FlushCopies, so you need to call it before executing the command lists that use the table
+		// Thread safe
+		CD3DX12_GPU_DESCRIPTOR_HANDLE GetTable(const Descriptor* descriptors, UINT count);
+		CD3DX12_GPU_DESCRIPTOR_HANDLE GetTable(std::initializer_list<Descriptor> descriptors) { return GetTable(descriptors.begin(), (UINT)descriptors.size()); }
+
+		// Copies the descriptor to a free slot on the bindless range and returns its index
+		// The index is valid until the last copy of the returned object is destroyed
+		// As with tables, the copy is done on FlushCopies
+		// Thread safe
+		BindlessIndex PublishBindless(const Descriptor& descriptor);
+
+		// Returns the handle to the start of the bindless range, to be bound as an unbounded table
+		CD3DX12_GPU_DESCRIPTOR_HANDLE GetBindlessTable() const { return CD3DX12_GPU_DESCRIPTOR_HANDLE(mGPUHeapStart); }
+		const BindlessIndexAllocator& GetBindlessIndexes() const { return mBindlessIndexes; }
+
+		// Copies all the tables and bindless descriptors requested since the last flush with a single CopyDescriptors call
+		void FlushCopies();
+
+		// Releases the tables that weren't used on the last kResourceBufferCount frames
+		// NOT thread safe, no one can be requesting tables while this runs
+		void AdvanceFrame(uint64_t frame_number);
+
+		ID3D12DescriptorHeap* GetHeap() const { return mHeap; }
+
+		// Thread safe
+		Stats GetStats();
+	private:
+		// Tables are allocated in power of two blocks, with a free list per size
+		static constexpr UINT kSizeClasses = 16;
+		static UINT GetSizeClass(UINT count);
+
+		struct KeyHash
+		{
+			size_t operator()(const std::vector<uint64_t>& key) const;
+		};
+
+		struct CachedTable
+		{
+			UINT offset;
+			UINT size_class;
+			std::atomic<uint64_t> last_used_frame;
+		};
+
+		std::shared_mutex mLock;
+		std::unordered_map<std::vector<uint64_t>, CachedTable, KeyHash> mTables;
+		std::vector<UINT> mFreeBlocks[kSizeClasses];
+		UINT mTop = 0;
+		uint64_t mFrameNumber = 0;
+		uint64_t mFailedAllocations = 0;
+
+		BindlessIndexAllocator mBindlessIndexes;
+
+		// Pending copies, stored as ranges ready to be passed to CopyDescriptors
+		// The source descriptors are kept alive until the copy is done
+		std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> mPendingDestStarts;
+		std::vector<UINT> mPendingDestSizes;
+		std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> mPendingSrcStarts;
+		std::vector<Descriptor> mPendingSources;
+
+		ID3D12DescriptorHeap* mHeap = nullptr;
+		D3D12_CPU_DESCRIPTOR_HANDLE mCPUHeapStart;
+		D3D12_GPU_DESCRIPTOR_HANDLE mGPUHeapStart;
+		D3D12_DESCRIPTOR_HEAP_TYPE mType;
+		UINT mEntrySize;
+		UINT mSize;
+
+		class Device* mDevicePtr;
+	};
+}
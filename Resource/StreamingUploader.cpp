@@ -0,0 +1,128 @@
+#include "StreamingUploader.h"
+#include "CommitedResource.h"
+#include "../Device/Device.h"
+#include "../Core/Log.h"
+
+using namespace FrameDX12;
+
+UploadTicket StreamingUploader::Enqueue(uint64_t size_in_bytes, Priority priority, RecordFunction record)
+{
+	UploadTicket ticket;
+	ticket.mState = std::make_shared<UploadTicket::State>();
+
+	std::scoped_lock lock(mLock);
+	mRequests.Push((int)priority, size_in_bytes, { std::move(record), ticket.mState });
+
+	return ticket;
+}
+
+UploadTicket StreamingUploader::UploadBuffer(CommitedResource& destination, uint64_t destination_offset, const void* data, uint64_t size_in_bytes, Priority priority)
+{
+	// The request can be recorded some frames later, so it keeps its own copy
+	// It can't go to the upload ring yet, as the ring batch could be retired by a signal of the queue before the copy is submitted
+	auto staged = std::make_shared<std::vector<uint8_t>>(reinterpret_cast<const uint8_t*>(data), reinterpret_cast<const uint8_t*>(data) + size_in_bytes);
+
+	return Enqueue(size_in_bytes, priority, [&destination, destination_offset, staged](ID3D12GraphicsCommandList*, UploadBatch& batch)
+	{
+		batch.Add(destination, destination_offset, staged->data(), staged->size(), D3D12_RESOURCE_STATE_COMMON);
+	});
+}
+
+void StreamingUploader::QueueWait(QueueType queue, const UploadTicket& ticket)
+{
+	// Nothing to wait for
+	if (!ticket.IsValid())
+		return;
+
+	uint64_t fence_value = ticket.GetFenceValue();
+	if (fence_value == 0)
+	{
+		std::scoped_lock lock(mLock);
+		if (ticket.mState->fence_value == 0)
+			Submit(true, ticket.mState.get());
+		fence_value = ticket.mState->fence_value;
+	}
+
+	mDevice->QueueWaitForWork(queue, QueueType::Copy, fence_value);
+}
+
+void StreamingUploader::Pump(bool force)
+{
+	std::scoped_lock lock(mLock);
+
+	CompleteFinished();
+	Submit(force);
+}
+
+void StreamingUploader::CompleteFinished()
+{
+	uint64_t completed = mDevice->GetCompletedWork(QueueType::Copy);
+	while (!mInFlight.empty() && mInFlight.front()->fence_value <= completed)
+	{
+		mInFlight.front()->promise.set_value(mInFlight.front()->fence_value);
+		mInFlight.pop_front();
+	}
+}
+
+void StreamingUploader::Submit(bool force, const UploadTicket::State* up_to)
+{
+	mTaken.clear();
+	if (up_to)
+		mBytesLastPump = mRequests.TakeUntil([up_to](const Request& request) { return request.ticket.get() == up_to; }, mTaken);
+	else
+		mBytesLastPump = mRequests.Take(mBudgetPerFrame, force, mTaken);
+
+	if (mTaken.empty())
+		return;
+
+	// Reuse the oldest allocator if the GPU is done with it
+	ComPtr<ID3D12CommandAllocator> allocator;
+	if (!mAllocators.empty() && mAllocators.front().fence_value <= mDevice->GetCompletedWork(QueueType::Copy))
+	{
+		allocator = std::move(mAllocators.front().allocator);
+		mAllocators.pop_front();
+		ThrowIfFailed(allocator->Reset());
+	}
+	else
+	{
+		ThrowIfFailed(mDevice->GetDevice()->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&allocator)));
+	}
+
+	if (!mCommandList)
+		ThrowIfFailed(mDevice->GetDevice()->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, allocator.Get(), nullptr, IID_PPV_ARGS(&mCommandList)));
+	else
+		ThrowIfFailed(mCommandList->Reset(allocator.Get(), nullptr));
+
+	for (Request& request : mTaken)
+		request.record(mCommandList.Get(), mBatch);
+	mBatch.Record(mCommandList.Get());
+
+	ThrowIfFailed(mCommandList->Close());
+
+	mDevice->GetResidencyManager().PrepareSubmit();
+
+	ID3D12CommandList* lists[] = { mCommandList.Get() };
+	mDevice->ExecuteCommandLists(QueueType::Copy, 1, lists);
+	uint64_t fence_value = mDevice->SignalQueueWork(QueueType::Copy);
+
+	mAllocators.push_back({ std::move(allocator), fence_value });
+	for (Request& request : mTaken)
+	{
+		request.ticket->fence_value = fence_value;
+		mInFlight.push_back(std::move(request.ticket));
+	}
+	mTaken.clear();
+}
+
+StreamingUploader::Stats StreamingUploader::GetStats()
+{
+	std::scoped_lock lock(mLock);
+
+	Stats stats = {};
+	stats.pending_requests = mRequests.GetCount();
+	stats.pending_bytes = mRequests.GetPendingBytes();
+	stats.in_flight_requests = mInFlight.size();
+	stats.bytes_last_pump = mBytesLastPump;
+
+	return stats;
+}
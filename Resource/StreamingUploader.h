@@ -0,0 +1,126 @@
+#pragma once
+#include "../Core/stdafx.h"
+#include "UploadBatch.h"
+#include "UploadRequestQueue.h"
+
+namespace FrameDX12
+{
+	enum class QueueType;
+
+	// Handle to an upload requested to the StreamingUploader
+	class UploadTicket
+	{
+	public:
+		// Default tickets (like the one of a mesh that failed to load) are invalid, and behave as an upload that is already done
+		bool IsValid() const { return mState != nullptr; }
+
+		// Fence value of the copy queue that signals the end of the upload. 0 while the upload wasn't submitted, or if invalid
+		uint64_t GetFenceValue() const { return IsValid() ? mState->fence_value.load() : 0; }
+
+		// Becomes ready, with the fence value, once the uploader sees that the GPU finished the upload. Ready with 0 if invalid
+		std::shared_future<uint64_t> GetFuture() const
+		{
+			if (IsValid())
+				return mState->future;
+
+			std::promise<uint64_t> done;
+			done.set_value(0);
+			return done.get_future().share();
+		}
+		bool IsDone() const { return !IsValid() || mState->future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+	private:
+		friend class StreamingUploader;
+
+		struct State
+		{
+			State() : future(promise.get_future().share()) {}
+
+			std::atomic<uint64_t> fence_value = 0;
+			std::promise<uint64_t> promise;
+			std::shared_future<uint64_t> future;
+		};
+		std::shared_ptr<State> mState;
+	};
+
+	// Streams data to GPU resources on the copy queue, so loading doesn't stall the render loop
+	// Requests are accepted from any thread. Pump (called from Device::AdvanceFrame) records them by priority on a copy list,
+	//  up to the per frame budget, and submits them
+	// Each request returns a ticket, the graphics queue can wait for it on the GPU with QueueWait
+	// The copy queue leaves the resources on COMMON after using them
+	// Thread safe
+	class StreamingUploader
+	{
+	public:
+		enum class Priority { High, Normal, Low, COUNT };
+
+		static constexpr uint64_t kDefaultBudgetPerFrame = 32 * 1024 * 1024;
+
+		StreamingUploader(class Device* device) :
+			mDevice(device)
+		{}
+
+		// Generic request. record adds the copies to the copy list or to the batch, size_in_bytes is what counts against the budget
+		// The batch is shared by all the requests of a Pump, so their buffer copies get coalesced. It's recorded after all the requests
+		// Anything record uses needs to be alive until it's called
+		using RecordFunction = std::function<void(ID3D12GraphicsCommandList*, UploadBatch&)>;
+		UploadTicket Enqueue(uint64_t size_in_bytes, Priority priority, RecordFunction record);
+
+		// Copies the data to the buffer at the offset. The data is copied, so it can be freed after this returns
+		// The resource needs to be alive until the ticket is done
+		UploadTicket UploadBuffer(CommitedResource& destination, uint64_t destination_offset, const void* data, uint64_t size_in_bytes, Priority priority = Priority::Normal);
+
+		// Makes the queue wait on the GPU until the upload is done
+		// If the upload is still pending it's submitted right away, without waiting for the next Pump, together with the requests that
+		//  go before it. The rest stay for the next Pump
+		// Invalid tickets are ignored
+		void QueueWait(QueueType queue, const UploadTicket& ticket);
+
+		// Submits the pending requests up to the budget, and completes the tickets of the finished uploads
+		// There's always at least one request submitted per call, so requests bigger than the budget aren't stuck forever
+		// If force is true the budget is ignored
+		void Pump(bool force = false);
+
+		void SetBudgetPerFrame(uint64_t size_in_bytes) { mBudgetPerFrame = size_in_bytes; }
+
+		struct Stats
+		{
+			uint64_t pending_requests;
+			uint64_t pending_bytes;
+			uint64_t in_flight_requests;
+			uint64_t bytes_last_pump;
+		};
+		Stats GetStats();
+	private:
+		struct Request
+		{
+			RecordFunction record;
+			std::shared_ptr<UploadTicket::State> ticket;
+		};
+
+		// Both need to be called with the lock taken
+		// If up_to is set, Submit takes the requests up to the one of that ticket instead of the ones that fit on the budget
+		void Submit(bool force, const UploadTicket::State* up_to = nullptr);
+		void CompleteFinished();
+
+		std::mutex mLock;
+
+		static_assert((int)Priority::COUNT == UploadRequestQueue<Request>::kPriorities);
+		UploadRequestQueue<Request> mRequests;
+		std::deque<std::shared_ptr<UploadTicket::State>> mInFlight; // In submission order
+		uint64_t mBudgetPerFrame = kDefaultBudgetPerFrame;
+		uint64_t mBytesLastPump = 0;
+
+		// Allocators are reused once the fence of their last submission completes
+		struct Allocator
+		{
+			ComPtr<ID3D12CommandAllocator> allocator;
+			uint64_t fence_value;
+		};
+		std::deque<Allocator> mAllocators;
+		ComPtr<ID3D12GraphicsCommandList> mCommandList;
+		UploadBatch mBatch;
+		std::vector<Request> mTaken; // Kept until the batch is recorded, as it can point to their data
+
+		class Device* mDevice;
+	};
+}
@@ -1,20 +1,45 @@
 #pragma once
 #include "CommitedResource.h"
+#include "UploadBatch.h"
+#include "BufferedResource.h"
+#include "../Core/StreamingCopy.h"
 
 namespace FrameDX12
 {
+	// Buffer of DataT elements, either on an upload heap that is written through a mapping (will_be_updated) or on the DEFAULT heap
+	// Updates are compared with a CPU copy of the data in pages of kDirtyPageSize, and only the pages that changed are written
+	// Mapped buffers get the changed pages written right away, DEFAULT ones get them copied by RecordUpdates
+	// Mapped buffers have a copy of the data per buffered frame, and the CPU only writes the one of the current frame, so updating them
+	//  never races with the GPU reading older frames. GetSRV returns the view of the current frame copy
+	// The mapped memory is write combined, so it is only written with StreamingCopy, never read
+	// Mapped buffers whose whole content is written every frame (rewritten_every_frame) skip the CPU copy and the comparison, the writes
+	//  go straight to the current frame copy and the other copies are left alone, as their frames write them too
 	template<typename DataT>
 	class StructuredBuffer : private CommitedResource
 	{
 	public:
-		void Create(Device* device, size_t size, bool needs_uav = false, bool will_be_updated = true, const std::vector<DataT>& initial_data = {}, ID3D12GraphicsCommandList* cl = nullptr)
+		static constexpr size_t kDirtyPageSize = 4096;
+		static constexpr size_t kElementsPerPage = std::max<size_t>(1, kDirtyPageSize / sizeof(DataT));
+
+		void Create(Device* device, size_t size, bool needs_uav = false, bool will_be_updated = true, const std::vector<DataT>& initial_data = {}, ID3D12GraphicsCommandList* cl = nullptr,
+					bool rewritten_every_frame = false)
 		{
 			mSize = size;
+			mIsMappable = will_be_updated;
+			mRewrittenEveryFrame = rewritten_every_frame && LogAssertAndContinue(will_be_updated, LogCategory::Warning);
+
+			// Buffers rewritten every frame only keep the initial data until it's written to the copies on the first Map
+			mShadow = initial_data;
+			if (!mRewrittenEveryFrame || !mShadow.empty())
+				mShadow.resize(mSize);
+			mDirtyPages.assign((mSize + kElementsPerPage - 1) / kElementsPerPage, false);
+			mCopies.Initialize(mDirtyPages.size());
+			uint32_t copies_count = mIsMappable ? kResourceBufferCount : 1;
 
 			D3D12_RESOURCE_FLAGS flags = needs_uav ? D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS : D3D12_RESOURCE_FLAG_NONE;
 			D3D12_RESOURCE_STATES initial_state = initial_data.size() > 0 ? D3D12_RESOURCE_STATE_COPY_DEST : D3D12_RESOURCE_STATE_GENERIC_READ;
 			D3D12_HEAP_TYPE heap_type = will_be_updated ? D3D12_HEAP_TYPE_UPLOAD : D3D12_HEAP_TYPE_DEFAULT;
-			CommitedResource::Create(device, CD3DX12_RESOURCE_DESC::Buffer(sizeof(DataT) * mSize, flags), initial_state, nullptr, heap_type);
+			CommitedResource::Create(device, CD3DX12_RESOURCE_DESC::Buffer(sizeof(DataT) * mSize * copies_count, flags), initial_state, nullptr, heap_type);
 
 			if (initial_data.size() > 0)
 			{
@@ -27,7 +52,12 @@ namespace FrameDX12
 			srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 			srv_desc.Buffer.NumElements = mSize;
 			srv_desc.Buffer.StructureByteStride = sizeof(DataT);
-			CreateSRV(&srv_desc);
+			mSRVs.Construct([&](uint8_t copy)
+			{
+				srv_desc.Buffer.FirstElement = (copy % copies_count) * mSize;
+				CreateSRV(&srv_desc);
+				return CopyView{ CommitedResource::GetSRV(), CommitedResource::GetSRVIndex() };
+			});
 
 			if (needs_uav)
 			{
@@ -41,10 +71,24 @@ namespace FrameDX12
 		}
 
 		// Maps the resource so it can be updated from the CPU. Optionally it can also map it so it can be read too
+		// Reading from the upload heap is really slow, as the memory is write combined. Use Readback to get GPU results
+		// The first time, the memory gets the data the CPU copy has, so the pages skipped by Update are valid
 		void Map(bool map_for_read = false)
 		{
 			CD3DX12_RANGE empty_range(0, 0);
 			mResource->Map(0, map_for_read ? nullptr : &empty_range, (void**)&mMappedMem);
+
+			if (!mMappedOnce)
+			{
+				if (!mShadow.empty())
+				{
+					for (uint8_t copy = 0; copy < kResourceBufferCount; copy++)
+						StreamingCopy(mMappedMem + copy * mSize, mShadow.data(), sizeof(DataT) * mSize);
+				}
+				if (mRewrittenEveryFrame)
+					mShadow = {};
+				mMappedOnce = true;
+			}
 		}
 
 		void Unmap()
@@ -53,28 +97,232 @@ namespace FrameDX12
 			mResource->Unmap(0, nullptr);
 		}
 
+		// Mapped buffers need to be mapped. Only the pages with changes are written (or marked for RecordUpdates)
+		// Buffers rewritten every frame get the data streamed to the current copy without comparing
 		void Update(const DataT& new_data, size_t index = 0)
 		{
-			if (LogAssertAndContinue(mMappedMem != nullptr, LogCategory::Warning))
+			if (LogAssertAndContinue(index < mSize, LogCategory::Warning))
 			{
-				memcpy(mMappedMem + index, &new_data, sizeof(DataT));
+				WriteRange(&new_data, index, 1);
 			}
 		}
 		void Update(const std::vector<DataT>& new_data, size_t base_index = 0)
 		{
-			if (LogAssertAndContinue(mMappedMem != nullptr && base_index + new_data.size() <= mSize, LogCategory::Warning))
+			if (LogAssertAndContinue(base_index + new_data.size() <= mSize, LogCategory::Warning))
+			{
+				WriteRange(new_data.data(), base_index, new_data.size());
+			}
+		}
+
+		// Writes count elements from base_index without a staging vector on the caller side
+		// generate(DataT* elements, size_t first_index, size_t element_count) fills the elements in place on the CPU copy, a page at a time,
+		//  so each page is still in the cache when it's streamed to the mapped memory (or marked for RecordUpdates)
+		// The pages aren't compared with the old data, use it for data that changes every frame, like per instance transforms
+		// On buffers rewritten every frame the elements are a scratch page instead, with undefined content, and it doesn't take any lock,
+		//  so different ranges can be generated in parallel
+		template<typename F>
+		void Generate(size_t base_index, size_t count, F&& generate)
+		{
+			if (!LogAssertAndContinue(base_index + count <= mSize, LogCategory::Warning))
+				return;
+
+			if (mRewrittenEveryFrame)
+			{
+				if (!LogAssertAndContinue(mMappedMem != nullptr, LogCategory::Warning))
+					return;
+
+				thread_local std::vector<DataT> scratch;
+				scratch.resize(kElementsPerPage);
+
+				DataT* current_copy = mMappedMem + BufferedCopiesTracker::GetCurrentCopy() * mSize;
+				for (size_t page_start = base_index; page_start < base_index + count;)
+				{
+					size_t page_end = std::min(base_index + count, page_start + kElementsPerPage);
+					generate(scratch.data(), page_start, page_end - page_start);
+					StreamingCopyNoFence(current_copy + page_start, scratch.data(), (page_end - page_start) * sizeof(DataT));
+					page_start = page_end;
+				}
+				StreamingFence();
+				return;
+			}
+
+			std::unique_lock<std::mutex> lock;
+			DataT* current_copy;
+			if (!BeginWrite(lock, current_copy))
+				return;
+
+			size_t end = base_index + count;
+			size_t page_start = base_index;
+			while (page_start < end)
+			{
+				size_t page_end = std::min(end, (page_start / kElementsPerPage + 1) * kElementsPerPage);
+				generate(mShadow.data() + page_start, page_start, page_end - page_start);
+				CommitPage(current_copy, page_start, page_end);
+				page_start = page_end;
+			}
+
+			if (current_copy)
+				StreamingFence();
+		}
+
+		// Copies the pages changed by Update since the last call to the buffer, contiguous pages on a single copy. Only for DEFAULT heap buffers
+		// If a batch is provided the copies are added there, so they are coalesced with other uploads. The batch reads the CPU copy of the data,
+		//  so record it before updating the buffer again
+		void RecordUpdates(ID3D12GraphicsCommandList* cl, D3D12_RESOURCE_STATES final_states = D3D12_RESOURCE_STATE_GENERIC_READ, UploadBatch* batch = nullptr)
+		{
+			UploadBatch local_batch;
+			UploadBatch& target = batch ? *batch : local_batch;
+
+			size_t page = 0;
+			while (page < mDirtyPages.size())
 			{
-				memcpy(mMappedMem + base_index, new_data.data(), sizeof(DataT)*new_data.size());
+				if (!mDirtyPages[page])
+				{
+					++page;
+					continue;
+				}
+
+				size_t first_page = page;
+				while (page < mDirtyPages.size() && mDirtyPages[page])
+					mDirtyPages[page++] = false;
+
+				size_t begin = first_page * kElementsPerPage;
+				size_t end = std::min(mSize, page * kElementsPerPage);
+				target.Add(*this, begin * sizeof(DataT), mShadow.data() + begin, (end - begin) * sizeof(DataT), final_states);
 			}
+
+			if (!batch)
+				local_batch.Record(cl);
 		}
 
-		DataT* GetMappedPointer() const { return mMappedMem; }
+		// Copies the elements back to the CPU without stalling. Read them with ReadbackData::GetDataAs<DataT> once the future is ready
+		ReadbackFuture Readback(ID3D12GraphicsCommandList* cl, size_t base_index = 0, size_t count = 0)
+		{
+			if (count == 0) count = mSize - base_index;
+			size_t copy_base = mIsMappable ? BufferedCopiesTracker::GetCurrentCopy() * mSize : 0;
+			return ReadbackBuffer(cl, (copy_base + base_index) * sizeof(DataT), count * sizeof(DataT));
+		}
 
-		Descriptor GetSRV() const { return CommitedResource::GetSRV(); }
+		// Memory of the current frame copy. Writes through it skip the tracking, so they don't reach the copies of other frames
+		DataT* GetMappedPointer()
+		{
+			Sync();
+			return mMappedMem ? mMappedMem + BufferedCopiesTracker::GetCurrentCopy() * mSize : nullptr;
+		}
+
+		// View and bindless index of the current frame copy
+		Descriptor GetSRV()
+		{
+			Sync();
+			MarkUsed();
+			return (*mSRVs).srv;
+		}
+		uint32_t GetSRVIndex()
+		{
+			Sync();
+			MarkUsed();
+			return (*mSRVs).srv_index;
+		}
 		Descriptor GetUAV() const { return CommitedResource::GetUAV(); }
 		ID3D12Resource* operator->() { return mResource.Get(); }
 	private:
+		// Locks the copies of mapped buffers and returns the one of the current frame, null for DEFAULT ones
+		bool BeginWrite(std::unique_lock<std::mutex>& lock, DataT*& current_copy)
+		{
+			current_copy = nullptr;
+			if (!LogAssertAndContinue(mMappedMem != nullptr || !mIsMappable, LogCategory::Warning))
+				return false;
+
+			if (mMappedMem)
+			{
+				lock = mCopies.SyncAndLock(mDevice->GetFrameNumber(), WritePageFunction());
+				current_copy = mMappedMem + BufferedCopiesTracker::GetCurrentCopy() * mSize;
+			}
+			return true;
+		}
+
+		// The range of the CPU copy goes to the current copy, or gets marked for RecordUpdates. It needs to be inside a page
+		void CommitPage(DataT* current_copy, size_t page_start, size_t page_end)
+		{
+			if (current_copy)
+			{
+				StreamingCopyNoFence(current_copy + page_start, mShadow.data() + page_start, (page_end - page_start) * sizeof(DataT));
+				mCopies.MarkWritten(page_start / kElementsPerPage);
+			}
+			else
+			{
+				mDirtyPages[page_start / kElementsPerPage] = true;
+			}
+		}
+
+		void WriteRange(const DataT* data, size_t base_index, size_t count)
+		{
+			if (mRewrittenEveryFrame)
+			{
+				if (LogAssertAndContinue(mMappedMem != nullptr, LogCategory::Warning))
+					StreamingCopy(mMappedMem + BufferedCopiesTracker::GetCurrentCopy() * mSize + base_index, data, count * sizeof(DataT));
+				return;
+			}
+
+			std::unique_lock<std::mutex> lock;
+			DataT* current_copy;
+			if (!BeginWrite(lock, current_copy))
+				return;
+
+			size_t end = base_index + count;
+			size_t page_start = base_index;
+			while (page_start < end)
+			{
+				size_t page_end = std::min(end, (page_start / kElementsPerPage + 1) * kElementsPerPage);
+				size_t page_bytes = (page_end - page_start) * sizeof(DataT);
+				const DataT* page_data = data + (page_start - base_index);
+
+				if (memcmp(mShadow.data() + page_start, page_data, page_bytes) != 0)
+				{
+					memcpy(mShadow.data() + page_start, page_data, page_bytes);
+					CommitPage(current_copy, page_start, page_end);
+				}
+
+				page_start = page_end;
+			}
+
+			if (current_copy)
+				StreamingFence();
+		}
+
+		// The copy of the current frame gets the pages updated on other frames
+		void Sync()
+		{
+			if (mMappedMem && !mRewrittenEveryFrame)
+				mCopies.Sync(mDevice->GetFrameNumber(), WritePageFunction());
+		}
+
+		auto WritePageFunction()
+		{
+			return [this](uint8_t copy, size_t page)
+			{
+				size_t begin = page * kElementsPerPage;
+				size_t end = std::min(mSize, begin + kElementsPerPage);
+				StreamingCopy(mMappedMem + copy * mSize + begin, mShadow.data() + begin, (end - begin) * sizeof(DataT));
+			};
+		}
+
 		size_t  mSize;
-		DataT* mMappedMem = nullptr;
+		DataT* mMappedMem = nullptr; // All the copies
+		bool mIsMappable = true;
+		bool mMappedOnce = false;
+		bool mRewrittenEveryFrame = false;
+
+		std::vector<DataT> mShadow; // What the GPU buffer has (or will have after RecordUpdates). Empty on buffers rewritten every frame
+		std::vector<bool> mDirtyPages;
+
+		// Each copy has its own view, and its own index on the bindless range
+		struct CopyView
+		{
+			Descriptor srv;
+			uint32_t srv_index;
+		};
+		BufferedResource<CopyView> mSRVs;
+		BufferedCopiesTracker mCopies; // Only used by mapped buffers
 	};
 }
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "UploadBatch.h"
+#include "CommitedResource.h"
+#include "../Device/Device.h"
+#include "../Core/StreamingCopy.h"
+#include "UploadBatchPlan.h"
+
+using namespace FrameDX12;
+
+void UploadBatch::Add(CommitedResource& destination, uint64_t destination_offset, const void* data, uint64_t size_in_bytes, D3D12_RESOURCE_STATES final_states)
+{
+	if (size_in_bytes == 0)
+		return;
+
+	mCopies.push_back({ &destination, destination_offset, data, size_in_bytes, final_states, (uint32_t)mCopies.size() });
+	mTotalBytes += size_in_bytes;
+}
+
+void UploadBatch::Record(ID3D12GraphicsCommandList* cl)
+{
+	mStats = {};
+	if (mCopies.empty())
+		return;
+
+	SortCopies(mCopies);
+
+	// All the destinations to COPY_DEST at once
+	mTransitions.clear();
+	for (size_t idx = 0; idx < mCopies.size(); idx++)
+	{
+		if (idx == 0 || mCopies[idx].destination != mCopies[idx - 1].destination)
+		{
+			mCopies[idx].destination->MarkUsed(cl);
+			mTransitions.push_back({ &mCopies[idx].destination->GetStates(), D3D12_RESOURCE_STATE_COPY_DEST });
+		}
+	}
+	ResourceStateTracker::Transition(cl, mTransitions);
+
+	// QueueType uses the same values as the command list types
+	Device* device = mCopies.front().destination->GetDevice();
+	auto staging = device->GetUploadRing((QueueType)cl->GetType()).Allocate(cl, mTotalBytes);
+
+	// The data is packed in the sorted order, so a run of contiguous destination ranges is also contiguous on the staging memory
+	mStats.copies_recorded = ForEachCopyRun(mCopies, [&](size_t first, size_t end, uint64_t staging_offset, uint64_t run_size)
+	{
+		uint8_t* packed = staging.cpu_ptr + staging_offset;
+		for (size_t idx = first; idx < end; idx++)
+		{
+			StreamingCopyNoFence(packed, mCopies[idx].data, mCopies[idx].size_in_bytes);
+			packed += mCopies[idx].size_in_bytes;
+		}
+
+		const Copy& copy = mCopies[first];
+		cl->CopyBufferRegion(copy.destination->Get(), copy.destination_offset, staging.resource, staging.offset + staging_offset, run_size);
+	});
+
+	StreamingFence();
+
+	// And to their final states at once, taking the states of the last copy added to each
+	mTransitions.clear();
+	uint32_t latest_order = 0;
+	for (size_t idx = 0; idx < mCopies.size(); idx++)
+	{
+		if (idx == 0 || mCopies[idx].destination != mCopies[idx - 1].destination)
+		{
+			mTransitions.push_back({ &mCopies[idx].destination->GetStates(), mCopies[idx].final_states });
+			latest_order = mCopies[idx].order;
+		}
+		else if (mCopies[idx].order > latest_order)
+		{
+			mTransitions.back().new_states = mCopies[idx].final_states;
+			latest_order = mCopies[idx].order;
+		}
+	}
+	ResourceStateTracker::Transition(cl, mTransitions);
+
+	mStats.copies_added = mCopies.size();
+	mStats.destinations = mTransitions.size();
+	mStats.bytes = mTotalBytes;
+
+	mCopies.clear();
+	mTotalBytes = 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "../Core/stdafx.h"
+#include "ResourceStateTracker.h"
+
+namespace FrameDX12
+{
+	class CommitedResource;
+
+	// Collects buffer copies and records them together
+	// On Record the copies are sorted by destination and their data packed on a single allocation of the upload ring, in the same order,
+	//  so copies to contiguous ranges of a buffer become a single CopyBufferRegion. The transitions of all the destinations go on
+	//  one barrier call before the copies and one after
+	// The data is read on Record, it needs to be alive until then
+	// Copies to overlapping ranges of a buffer are not supported
+	// Not thread safe, use a batch per thread
+	class UploadBatch
+	{
+	public:
+		struct Stats
+		{
+			uint32_t copies_added;
+			uint32_t copies_recorded; // CopyBufferRegion calls, after merging
+			uint32_t destinations;
+			uint64_t bytes;
+		};
+
+		// The destination ends on final_states. If a buffer gets copies with different final states the last one added is used
+		void Add(CommitedResource& destination, uint64_t destination_offset, const void* data, uint64_t size_in_bytes, D3D12_RESOURCE_STATES final_states);
+
+		// Records everything on the list and empties the batch
+		void Record(ID3D12GraphicsCommandList* cl);
+
+		bool IsEmpty() const { return mCopies.empty(); }
+
+		// Stats of the last Record
+		const Stats& GetStats() const { return mStats; }
+	private:
+		struct Copy
+		{
+			CommitedResource* destination;
+			uint64_t destination_offset;
+			const void* data;
+			uint64_t size_in_bytes;
+			D3D12_RESOURCE_STATES final_states;
+			uint32_t order;
+		};
+
+		std::vector<Copy> mCopies;
+		uint64_t mTotalBytes = 0;
+		Stats mStats = {};
+
+		// Scratch
+		std::vector<ResourceStateTracker::TransitionRequest> mTransitions;
+	};
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+// No D3D on this file, the planning of an UploadBatch is plain CPU code and can be built and timed on its own
+
+namespace FrameDX12
+{
+	// Sorts the copies by destination and offset, so copies to contiguous ranges of a buffer end up next to each other
+	// Copy needs destination (any pointer), destination_offset and size_in_bytes members
+	template<typename Copy>
+	void SortCopies(std::vector<Copy>& copies)
+	{
+		std::sort(copies.begin(), copies.end(), [](const Copy& a, const Copy& b)
+		{
+			if (a.destination != b.destination) return a.destination < b.destination;
+			return a.destination_offset < b.destination_offset;
+		});
+	}
+
+	// Walks the sorted copies as packed one after the other on the staging memory, and calls
+	//  emit(first, end, staging_offset, run_size) for each run of copies [first, end) to contiguous ranges of the same destination
+	// staging_offset is where the data of the first copy of the run is packed. Returns the number of runs
+	template<typename Copy, typename Emit>
+	uint32_t ForEachCopyRun(const std::vector<Copy>& copies, Emit&& emit)
+	{
+		uint32_t runs = 0;
+		uint64_t staging_offset = 0;
+		size_t run_start = 0;
+		for (size_t idx = 0; idx < copies.size(); idx++)
+		{
+			const Copy& copy = copies[idx];
+			bool last_of_run = idx + 1 == copies.size() ||
+							   copies[idx + 1].destination != copy.destination ||
+							   copies[idx + 1].destination_offset != copy.destination_offset + copy.size_in_bytes;
+			if (last_of_run)
+			{
+				uint64_t run_size = copy.destination_offset + copy.size_in_bytes - copies[run_start].destination_offset;
+				emit(run_start, idx + 1, staging_offset, run_size);
+
+				staging_offset += run_size;
+				run_start = idx + 1;
+				++runs;
+			}
+		}
+		return runs;
+	}
+}
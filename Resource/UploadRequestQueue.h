@@ -0,0 +1,120 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// No D3D on this file, the requests are opaque so the policy can be tested on its own
+
+namespace FrameDX12
+{
+	// Pending requests of the StreamingUploader, one FIFO per priority, and the policy that picks the ones of each submission
+	// Requests are always taken in priority order, lower priorities only once the higher ones are empty
+	// Not thread safe, the uploader guards it with its lock
+	template<typename T>
+	class UploadRequestQueue
+	{
+	public:
+		static constexpr int kPriorities = 3;
+
+		void Push(int priority, uint64_t size_in_bytes, T request)
+		{
+			mQueues[priority].push_back({ size_in_bytes, std::move(request) });
+			mPendingBytes += size_in_bytes;
+		}
+
+		// Moves to out the requests of the next submission, until the next one doesn't fit on the budget
+		// At least one is taken, so requests bigger than the budget aren't stuck forever. If force is true the budget is ignored
+		// Returns the bytes taken
+		uint64_t Take(uint64_t budget, bool force, std::vector<T>& out)
+		{
+			uint64_t taken_bytes = 0;
+			bool taken_any = false;
+			for (auto& queue : mQueues)
+			{
+				while (!queue.empty() && (force || !taken_any || taken_bytes + queue.front().size_in_bytes <= budget))
+				{
+					taken_bytes += TakeFront(queue, out);
+					taken_any = true;
+				}
+
+				if (!queue.empty())
+					break;
+			}
+			return taken_bytes;
+		}
+
+		// Moves to out the requests up to the first one matching the predicate, including it, ignoring the budget
+		// Those are the ones that would be submitted before it, so the priority order is kept. Takes nothing if none matches
+		// Returns the bytes taken
+		template<typename Predicate>
+		uint64_t TakeUntil(Predicate&& predicate, std::vector<T>& out)
+		{
+			int last_queue = -1;
+			size_t last_index = 0;
+			for (int idx = 0; idx < kPriorities && last_queue < 0; idx++)
+			{
+				for (size_t request_idx = 0; request_idx < mQueues[idx].size(); request_idx++)
+				{
+					if (predicate(mQueues[idx][request_idx].request))
+					{
+						last_queue = idx;
+						last_index = request_idx;
+						break;
+					}
+				}
+			}
+
+			uint64_t taken_bytes = 0;
+			for (int idx = 0; idx < last_queue; idx++)
+			{
+				while (!mQueues[idx].empty())
+					taken_bytes += TakeFront(mQueues[idx], out);
+			}
+			if (last_queue >= 0)
+			{
+				for (size_t request_idx = 0; request_idx <= last_index; request_idx++)
+					taken_bytes += TakeFront(mQueues[last_queue], out);
+			}
+			return taken_bytes;
+		}
+
+		bool IsEmpty() const
+		{
+			for (auto& queue : mQueues)
+			{
+				if (!queue.empty())
+					return false;
+			}
+			return true;
+		}
+
+		uint64_t GetCount() const
+		{
+			uint64_t count = 0;
+			for (auto& queue : mQueues)
+				count += queue.size();
+			return count;
+		}
+
+		uint64_t GetPendingBytes() const { return mPendingBytes; }
+	private:
+		struct Entry
+		{
+			uint64_t size_in_bytes;
+			T request;
+		};
+
+		uint64_t TakeFront(std::deque<Entry>& queue, std::vector<T>& out)
+		{
+			uint64_t size_in_bytes = queue.front().size_in_bytes;
+			out.push_back(std::move(queue.front().request));
+			queue.pop_front();
+			mPendingBytes -= size_in_bytes;
+			return size_in_bytes;
+		}
+
+		std::deque<Entry> mQueues[kPriorities];
+		uint64_t mPendingBytes = 0;
+	};
+}
@@ -0,0 +1,179 @@
+#include "UploadRing.h"
+#include "../Device/Device.h"
+#include "../Core/Log.h"
+
+using namespace FrameDX12;
+
+void UploadRing::Initialize(Device* device, QueueType queue, uint64_t size)
+{
+	mDevice = device;
+	mQueue = queue;
+	mSize = size;
+}
+
+UploadRing::Allocation UploadRing::Allocate(ID3D12CommandList* cl, uint64_t size, uint64_t alignment)
+{
+	std::unique_lock lock(mLock);
+
+	if (size > mSize)
+		return AllocateDedicated(cl, size);
+
+	if (!mResource)
+	{
+		auto heap_props = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+		auto buffer_desc = CD3DX12_RESOURCE_DESC::Buffer(mSize);
+		ThrowIfFailed(mDevice->GetDevice()->CreateCommittedResource(
+			&heap_props,
+			D3D12_HEAP_FLAG_NONE,
+			&buffer_desc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&mResource)));
+
+		CD3DX12_RANGE empty_range(0, 0); // Write only
+		ThrowIfFailed(mResource->Map(0, &empty_range, reinterpret_cast<void**>(&mMappedMem)));
+	}
+
+	auto find_start = [&]()
+	{
+		uint64_t start = (mHead + alignment - 1) / alignment * alignment;
+
+		// Allocations can't wrap around, skip to the start of the ring
+		if (start % mSize + size > mSize)
+			start = (start / mSize + 1) * mSize;
+
+		return start;
+	};
+
+	uint64_t start = find_start();
+	if (start + size - mTail > mSize)
+	{
+		// Retiring can move the head, so need to find the start again
+		Retire(mDevice->GetCompletedWork(mQueue));
+		start = find_start();
+
+		// Wait for the oldest allocations until there's space
+		// If what's blocking was not submitted or signaled yet there's nothing to wait for
+		HANDLE event = nullptr;
+		while (start + size - mTail > mSize && !mSpans.empty() && mSpans.front().fence_value != 0)
+		{
+			uint64_t fence_value = mSpans.front().fence_value;
+
+			// Other threads keep allocating from the ring while this one waits. Own event, as they can be waiting too
+			lock.unlock();
+			if (!event) event = CreateEventEx(nullptr, FALSE, FALSE, EVENT_ALL_ACCESS);
+			mDevice->WaitForWork(mQueue, fence_value, event);
+			lock.lock();
+
+			Retire(mDevice->GetCompletedWork(mQueue));
+			start = find_start();
+		}
+		if (event) CloseHandle(event);
+
+		if (start + size - mTail > mSize)
+		{
+			LogMsg(L"Upload ring full with work that wasn't submitted, using a dedicated resource", LogCategory::Warning);
+			return AllocateDedicated(cl, size);
+		}
+	}
+
+	mHead = start + size;
+	if (!mSpans.empty() && mSpans.back().list == cl && !mSpans.back().submitted)
+		mSpans.back().end = mHead;
+	else
+		mSpans.push_back({ mHead, cl, false, 0 });
+
+	Allocation allocation;
+	allocation.resource = mResource.Get();
+	allocation.offset = start % mSize;
+	allocation.cpu_ptr = mMappedMem + allocation.offset;
+	allocation.gpu_address = mResource->GetGPUVirtualAddress() + allocation.offset;
+
+	return allocation;
+}
+
+UploadRing::Allocation UploadRing::AllocateDedicated(ID3D12CommandList* cl, uint64_t size)
+{
+	ComPtr<ID3D12Resource> resource;
+
+	auto heap_props = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	auto buffer_desc = CD3DX12_RESOURCE_DESC::Buffer(size);
+	ThrowIfFailed(mDevice->GetDevice()->CreateCommittedResource(
+		&heap_props,
+		D3D12_HEAP_FLAG_NONE,
+		&buffer_desc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&resource)));
+
+	Allocation allocation;
+	CD3DX12_RANGE empty_range(0, 0);
+	ThrowIfFailed(resource->Map(0, &empty_range, reinterpret_cast<void**>(&allocation.cpu_ptr)));
+	allocation.resource = resource.Get();
+	allocation.offset = 0;
+	allocation.gpu_address = resource->GetGPUVirtualAddress();
+
+	mDedicated.push_back({ std::move(resource), cl, false });
+
+	return allocation;
+}
+
+void UploadRing::Submit(ID3D12CommandList* const* lists, UINT count)
+{
+	std::scoped_lock lock(mLock);
+
+	auto is_submitted = [lists, count](ID3D12CommandList* list) { return std::find(lists, lists + count, list) != lists + count; };
+
+	for (Span& span : mSpans)
+	{
+		if (!span.submitted && is_submitted(span.list))
+			span.submitted = true;
+	}
+
+	for (Dedicated& dedicated : mDedicated)
+	{
+		if (!dedicated.submitted && is_submitted(dedicated.list))
+			dedicated.submitted = true;
+	}
+}
+
+void UploadRing::CloseBatch(uint64_t fence_value)
+{
+	std::scoped_lock lock(mLock);
+
+	// Only what was submitted before this signal, lists still being recorded wait for a later one
+	for (Span& span : mSpans)
+	{
+		if (span.submitted && span.fence_value == 0)
+			span.fence_value = fence_value;
+	}
+
+	std::vector<ComPtr<ID3D12Resource>> signaled;
+	size_t kept = 0;
+	for (Dedicated& dedicated : mDedicated)
+	{
+		if (dedicated.submitted)
+			signaled.push_back(std::move(dedicated.resource));
+		else
+			mDedicated[kept++] = std::move(dedicated);
+	}
+	mDedicated.resize(kept);
+	if (!signaled.empty())
+		mDevice->DeferRelease(mQueue, fence_value, std::move(signaled));
+
+	// Take the chance to release old stuff
+	Retire(mDevice->GetCompletedWork(mQueue));
+}
+
+void UploadRing::Retire(uint64_t completed_value)
+{
+	while (!mSpans.empty() && mSpans.front().fence_value != 0 && mSpans.front().fence_value <= completed_value)
+	{
+		mTail = mSpans.front().end;
+		mSpans.pop_front();
+	}
+
+	// If everything was retired restart from the beginning, so small allocations don't need to skip the end of the ring
+	if (mSpans.empty())
+		mHead = mTail = 0;
+}
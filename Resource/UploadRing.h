@@ -0,0 +1,75 @@
+#pragma once
+#include "../Core/stdafx.h"
+
+namespace FrameDX12
+{
+	enum class QueueType;
+
+	// Persistently mapped upload buffer used as a ring, to stage data that is copied to GPU only resources
+	// Allocations are tagged with the command list that records them. Device::ExecuteCommandLists marks the ones of the submitted lists,
+	//  and the next signal of the queue tags them with its fence value (the Device calls CloseBatch when signaling). They are released
+	//  when the fence reaches it. Lists that are recorded but not submitted keep their allocations whatever the queue signals meanwhile,
+	//  so submit every list that allocated, or the ring stays blocked behind it
+	// If the ring is full it waits for the oldest allocations. Allocations that don't fit at all get a dedicated resource, also retired by fence
+	// Thread safe
+	class UploadRing
+	{
+	public:
+		struct Allocation
+		{
+			uint8_t* cpu_ptr; // Write only memory
+			ID3D12Resource* resource;
+			uint64_t offset; // Offset of the allocation on the resource
+			D3D12_GPU_VIRTUAL_ADDRESS gpu_address;
+		};
+
+		// The buffer is created on the first allocation, so unused rings don't take memory
+		void Initialize(class Device* device, QueueType queue, uint64_t size);
+
+		// The allocation is in use until the list that records its copy is submitted and the queue signals after it
+		Allocation Allocate(ID3D12CommandList* cl, uint64_t size, uint64_t alignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+		// Marks the allocations of the lists as submitted. Called by Device::ExecuteCommandLists after the lists are on the queue
+		void Submit(ID3D12CommandList* const* lists, UINT count);
+
+		// Tags the allocations submitted since the last call with the fence value
+		void CloseBatch(uint64_t fence_value);
+	private:
+		// Releases all the allocations whose fence was already reached. Needs to be called with the lock taken
+		void Retire(uint64_t completed_value);
+		Allocation AllocateDedicated(ID3D12CommandList* cl, uint64_t size);
+
+		std::mutex mLock;
+
+		ComPtr<ID3D12Resource> mResource;
+		uint8_t* mMappedMem = nullptr;
+		uint64_t mSize = 0;
+
+		// Virtual offsets, they only increase. The physical offset is the virtual one modulo the size
+		uint64_t mHead = 0; // Where the next allocation goes
+		uint64_t mTail = 0; // Start of the oldest allocation still in use
+
+		// Consecutive allocations of the same list, in ring order. They are retired in order, so a list that is not submitted
+		//  holds back the ones after it
+		struct Span
+		{
+			uint64_t end;
+			ID3D12CommandList* list;
+			bool submitted;
+			uint64_t fence_value; // Zero until the queue signals after the submission
+		};
+		std::deque<Span> mSpans;
+
+		// Allocations that didn't fit on the ring. They go to the device deferred release queue when their list is signaled
+		struct Dedicated
+		{
+			ComPtr<ID3D12Resource> resource;
+			ID3D12CommandList* list;
+			bool submitted;
+		};
+		std::vector<Dedicated> mDedicated;
+
+		QueueType mQueue;
+		class Device* mDevice = nullptr;
+	};
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "../Core/stdafx.h"
+#include "VertexPacking.h"
+
+namespace FrameDX12
+{
+	struct CPUVertex
+	{
+
+		DirectX::XMFLOAT3 position;
+		DirectX::XMFLOAT3 normal;
+		DirectX::XMFLOAT4 tangent;
+		DirectX::XMFLOAT3 bitangent;
+		DirectX::XMFLOAT2 uv;
+
+		bool operator==(const CPUVertex& other) const
+		{
+			using namespace DirectX;
+
+			return XMVector3Equal(XMLoadFloat3(&position), XMLoadFloat3(&other.position)) &&
+				XMVector3Equal(XMLoadFloat3(&normal), XMLoadFloat3(&other.normal)) &&
+				XMVector4Equal(XMLoadFloat4(&tangent), XMLoadFloat4(&other.tangent)) &&
+				XMVector3Equal(XMLoadFloat3(&bitangent), XMLoadFloat3(&other.bitangent)) &&
+				XMVector2Equal(XMLoadFloat2(&uv), XMLoadFloat2(&other.uv));
+		}
+	};
+
+	constexpr DXGI_FORMAT GetDXGIFormat(VertexFormat format)
+	{
+		switch (format)
+		{
+		case VertexFormat::Float2:    return DXGI_FORMAT_R32G32_FLOAT;
+		case VertexFormat::Float3:    return DXGI_FORMAT_R32G32B32_FLOAT;
+		case VertexFormat::Float4:    return DXGI_FORMAT_R32G32B32A32_FLOAT;
+		case VertexFormat::Half2:     return DXGI_FORMAT_R16G16_FLOAT;
+		case VertexFormat::Half4:     return DXGI_FORMAT_R16G16B16A16_FLOAT;
+		case VertexFormat::UNorm16x2: return DXGI_FORMAT_R16G16_UNORM;
+		case VertexFormat::SNorm16x4: return DXGI_FORMAT_R16G16B16A16_SNORM;
+		default:                      return DXGI_FORMAT_R16G16_SNORM; // SNorm16x2 and Octahedral16
+		}
+	}
+
+	// Vertex layout known at compile time, as a list of VertexElement in the order they are on the vertex
+	// The offsets, the size and the input layout are constexpr, so they can't drift from each other, and Convert is a single loop
+	//  with the element writes inlined, instead of a call through a std::function per vertex
+	// Use MakeVertexDesc to get a VertexDesc of it
+	template<typename... Elements>
+	struct VertexLayout : VertexPacking<Elements...>
+	{
+		using Packing = VertexPacking<Elements...>;
+		using Packing::kElementCount;
+		using Packing::kVertexSize;
+		using Packing::kOffsets;
+
+		static constexpr std::array<D3D12_INPUT_ELEMENT_DESC, kElementCount> kInputElements = []()
+		{
+			constexpr VertexSemantic semantics[] = { Elements::kSemantic... };
+			constexpr VertexFormat formats[] = { Elements::kFormat... };
+			constexpr uint32_t semantic_indices[] = { Elements::kSemanticIndex... };
+			std::array<D3D12_INPUT_ELEMENT_DESC, kElementCount> elements = {};
+			for (uint32_t idx = 0; idx < kElementCount; idx++)
+				elements[idx] = { GetSemanticName(semantics[idx]), semantic_indices[idx], GetDXGIFormat(formats[idx]), 0, kOffsets[idx], D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
+			return elements;
+		}();
+
+		static D3D12_INPUT_LAYOUT_DESC GetGPUDesc()
+		{
+			return { kInputElements.data(), kElementCount };
+		}
+
+		// Writes count vertices to output, which needs count * kVertexSize bytes
+		static void Convert(const CPUVertex* vertices, size_t count, void* output)
+		{
+			Packing::Convert(vertices, count, output);
+		}
+
+		// Same signature as VertexDesc::AppendVertex
+		static void* AppendVertex(void* output, const CPUVertex& vertex)
+		{
+			Packing::Convert(&vertex, 1, output);
+			return static_cast<uint8_t*>(output) + kVertexSize;
+		}
+
+		// Same signature as VertexDesc::ReadVertex
+		static void ReadVertex(const void* input, CPUVertex& vertex)
+		{
+			vertex = {};
+			Packing::Read(input, vertex);
+		}
+	};
+}
@@ -0,0 +1,282 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <string>
+#include <string_view>
+#include <utility>
+#include "VertexQuantization.h"
+
+// No D3D on this file, it's only how the elements of a VertexLayout are packed. VertexLayout adds the input layout on top
+
+namespace FrameDX12
+{
+	// The vertex member an element is read from. The enum name is the HLSL semantic
+	enum class VertexSemantic
+	{
+		Position,
+		PositionBitangentSign, // POSITION too, xyz is the position and w the sign of the bitangent, for layouts that drop the tangent w
+		Normal,
+		Tangent,               // w is the sign of the bitangent
+		UV
+	};
+
+	enum class VertexFormat
+	{
+		Float2,
+		Float3,
+		Float4,
+		Half2,
+		Half4,
+		UNorm16x2,
+		SNorm16x2,
+		SNorm16x4,
+		Octahedral16 // A unit vector on 2 snorm16 with the octahedral mapping (see EncodeOctahedral). Only for Normal and Tangent
+	};
+
+	constexpr const char* GetSemanticName(VertexSemantic semantic)
+	{
+		switch (semantic)
+		{
+		case VertexSemantic::Position:
+		case VertexSemantic::PositionBitangentSign: return "POSITION";
+		case VertexSemantic::Normal:                return "NORMAL";
+		case VertexSemantic::Tangent:               return "TANGENT";
+		default:                                    return "UV";
+		}
+	}
+
+	constexpr uint32_t GetComponentCount(VertexSemantic semantic)
+	{
+		switch (semantic)
+		{
+		case VertexSemantic::PositionBitangentSign:
+		case VertexSemantic::Tangent: return 4;
+		case VertexSemantic::UV:      return 2;
+		default:                      return 3;
+		}
+	}
+
+	// Components stored on the vertex
+	constexpr uint32_t GetComponentCount(VertexFormat format)
+	{
+		switch (format)
+		{
+		case VertexFormat::Float3:    return 3;
+		case VertexFormat::Float4:
+		case VertexFormat::Half4:
+		case VertexFormat::SNorm16x4: return 4;
+		default:                      return 2;
+		}
+	}
+
+	constexpr bool IsFloatFormat(VertexFormat format)
+	{
+		return format == VertexFormat::Float2 || format == VertexFormat::Float3 || format == VertexFormat::Float4;
+	}
+
+	constexpr uint32_t GetFormatSize(VertexFormat format)
+	{
+		return GetComponentCount(format) * (IsFloatFormat(format) ? 4 : 2);
+	}
+
+	constexpr const char* GetFormatName(VertexFormat format)
+	{
+		switch (format)
+		{
+		case VertexFormat::Float2:    return "Float2";
+		case VertexFormat::Float3:    return "Float3";
+		case VertexFormat::Float4:    return "Float4";
+		case VertexFormat::Half2:     return "Half2";
+		case VertexFormat::Half4:     return "Half4";
+		case VertexFormat::UNorm16x2: return "UNorm16x2";
+		case VertexFormat::SNorm16x2: return "SNorm16x2";
+		case VertexFormat::SNorm16x4: return "SNorm16x4";
+		default:                      return "Octahedral16";
+		}
+	}
+
+	// An element of a VertexLayout
+	// If the format has more components than the source, the extra ones are written as 0, and 1 for the 4th, like the IA expands them
+	// SemanticIndex tells apart elements with the same semantic name, like NORMAL1 in HLSL. The data still comes from the member of
+	//  the semantic
+	// Vertex is CPUVertex, or anything with position, normal, tangent and uv members laid out like it
+	template<VertexSemantic Semantic, VertexFormat Format, uint32_t SemanticIndex = 0>
+	struct VertexElement
+	{
+		static_assert(Format != VertexFormat::Octahedral16 || Semantic == VertexSemantic::Normal || Semantic == VertexSemantic::Tangent,
+					  "The octahedral format is only for unit vectors");
+
+		static constexpr VertexSemantic kSemantic = Semantic;
+		static constexpr VertexFormat kFormat = Format;
+		static constexpr uint32_t kSemanticIndex = SemanticIndex;
+		static constexpr uint32_t kSize = GetFormatSize(Format);
+
+		template<typename Vertex>
+		static void Write(const Vertex& vertex, uint8_t* output)
+		{
+			constexpr uint32_t source_count = GetComponentCount(Semantic);
+			constexpr uint32_t count = GetComponentCount(Format);
+
+			float source[4];
+			if constexpr (Semantic == VertexSemantic::Position || Semantic == VertexSemantic::PositionBitangentSign)
+			{
+				memcpy(source, &vertex.position.x, 3 * sizeof(float));
+				source[3] = vertex.tangent.w < 0.0f ? -1.0f : 1.0f;
+			}
+			else if constexpr (Semantic == VertexSemantic::Normal) memcpy(source, &vertex.normal.x, 3 * sizeof(float));
+			else if constexpr (Semantic == VertexSemantic::Tangent) memcpy(source, &vertex.tangent.x, 4 * sizeof(float));
+			else memcpy(source, &vertex.uv.x, 2 * sizeof(float));
+
+			if constexpr (Format == VertexFormat::Octahedral16)
+			{
+				int16_t encoded[2];
+				EncodeOctahedral(source, encoded);
+				memcpy(output, encoded, sizeof(encoded));
+				return;
+			}
+			else
+			{
+				float values[count];
+				for (uint32_t idx = 0; idx < count; idx++)
+					values[idx] = idx < source_count ? source[idx] : (idx == 3 ? 1.0f : 0.0f);
+
+				if constexpr (IsFloatFormat(Format))
+				{
+					memcpy(output, values, sizeof(values));
+				}
+				else
+				{
+					uint16_t packed[count];
+					for (uint32_t idx = 0; idx < count; idx++)
+					{
+						if constexpr (Format == VertexFormat::UNorm16x2) packed[idx] = FloatToUNorm16(values[idx]);
+						else if constexpr (Format == VertexFormat::SNorm16x2 || Format == VertexFormat::SNorm16x4) packed[idx] = (uint16_t)FloatToSNorm16(values[idx]);
+						else packed[idx] = FloatToHalf(values[idx]);
+					}
+					memcpy(output, packed, sizeof(packed));
+				}
+			}
+		}
+
+		// The inverse of Write, for the components it stores. Octahedral tangents leave w alone
+		template<typename Vertex>
+		static void Read(const uint8_t* input, Vertex& vertex)
+		{
+			float values[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+			uint32_t count = GetComponentCount(Format);
+			if constexpr (Format == VertexFormat::Octahedral16)
+			{
+				int16_t encoded[2];
+				memcpy(encoded, input, sizeof(encoded));
+				DecodeOctahedral(encoded, values);
+				count = 3;
+			}
+			else if constexpr (IsFloatFormat(Format))
+			{
+				memcpy(values, input, count * sizeof(float));
+			}
+			else
+			{
+				uint16_t packed[4];
+				memcpy(packed, input, count * sizeof(uint16_t));
+				for (uint32_t idx = 0; idx < count; idx++)
+				{
+					if constexpr (Format == VertexFormat::UNorm16x2) values[idx] = UNorm16ToFloat(packed[idx]);
+					else if constexpr (Format == VertexFormat::SNorm16x2 || Format == VertexFormat::SNorm16x4) values[idx] = SNorm16ToFloat((int16_t)packed[idx]);
+					else values[idx] = HalfToFloat(packed[idx]);
+				}
+			}
+
+			float* destination;
+			if constexpr (Semantic == VertexSemantic::Position || Semantic == VertexSemantic::PositionBitangentSign) destination = &vertex.position.x;
+			else if constexpr (Semantic == VertexSemantic::Normal) destination = &vertex.normal.x;
+			else if constexpr (Semantic == VertexSemantic::Tangent) destination = &vertex.tangent.x;
+			else destination = &vertex.uv.x;
+
+			if constexpr (Semantic == VertexSemantic::PositionBitangentSign)
+			{
+				memcpy(destination, values, std::min(count, 3u) * sizeof(float));
+				if (count == 4)
+					vertex.tangent.w = values[3];
+			}
+			else
+			{
+				memcpy(destination, values, std::min(count, GetComponentCount(Semantic)) * sizeof(float));
+			}
+		}
+	};
+
+	// How the elements of a VertexLayout are packed, in the order they are on the vertex
+	// The offsets and the size are constexpr, and Convert is a single loop with the element writes inlined
+	template<typename... Elements>
+	struct VertexPacking
+	{
+		static constexpr uint32_t kElementCount = sizeof...(Elements);
+		static constexpr uint32_t kVertexSize = (Elements::kSize + ...);
+		static_assert(kVertexSize % 4 == 0, "The elements need to stay 4 byte aligned");
+
+		// Only float formats, so reading back the vertices gives the same values
+		static constexpr bool kIsLossless = (IsFloatFormat(Elements::kFormat) && ...);
+
+		static constexpr std::array<uint32_t, kElementCount> kOffsets = []()
+		{
+			constexpr uint32_t sizes[] = { Elements::kSize... };
+			std::array<uint32_t, kElementCount> offsets = {};
+			for (uint32_t idx = 1; idx < kElementCount; idx++)
+				offsets[idx] = offsets[idx - 1] + sizes[idx - 1];
+			return offsets;
+		}();
+
+		// The input layout can't have two elements with the same semantic name and index
+		static constexpr bool kHasDuplicateSemantics = []()
+		{
+			constexpr std::string_view names[] = { GetSemanticName(Elements::kSemantic)... };
+			constexpr uint32_t indices[] = { Elements::kSemanticIndex... };
+			for (uint32_t a = 0; a < kElementCount; a++)
+				for (uint32_t b = a + 1; b < kElementCount; b++)
+					if (names[a] == names[b] && indices[a] == indices[b])
+						return true;
+			return false;
+		}();
+		static_assert(!kHasDuplicateSemantics, "Two elements have the same semantic name and index, give one of them another SemanticIndex");
+
+		// Writes count vertices to output, which needs count * kVertexSize bytes
+		template<typename Vertex>
+		static void Convert(const Vertex* vertices, size_t count, void* output)
+		{
+			uint8_t* vertex_output = static_cast<uint8_t*>(output);
+			for (size_t idx = 0; idx < count; idx++, vertex_output += kVertexSize)
+				WriteVertex(vertices[idx], vertex_output, std::index_sequence_for<Elements...>());
+		}
+
+		// Reads back a vertex written by Convert. The members the layout doesn't have are left alone
+		template<typename Vertex>
+		static void Read(const void* input, Vertex& vertex)
+		{
+			ReadVertex(static_cast<const uint8_t*>(input), vertex, std::index_sequence_for<Elements...>());
+		}
+
+		// Unique for each layout, e.g. POSITION_Float3_UV_Half2. Elements with a semantic index get it after the name, like UV1
+		static std::string GetName()
+		{
+			std::string name;
+			((name += std::string(name.empty() ? "" : "_") + GetSemanticName(Elements::kSemantic) +
+					  (Elements::kSemanticIndex ? std::to_string(Elements::kSemanticIndex) : "") + "_" + GetFormatName(Elements::kFormat)), ...);
+			return name;
+		}
+	private:
+		template<typename Vertex, size_t... Indices>
+		static void WriteVertex(const Vertex& vertex, uint8_t* output, std::index_sequence<Indices...>)
+		{
+			(Elements::Write(vertex, output + kOffsets[Indices]), ...);
+		}
+
+		template<typename Vertex, size_t... Indices>
+		static void ReadVertex(const uint8_t* input, Vertex& vertex, std::index_sequence<Indices...>)
+		{
+			(Elements::Read(input + kOffsets[Indices], vertex), ...);
+		}
+	};
+}
@@ -0,0 +1,199 @@
+#include "VertexQuantization.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+using namespace FrameDX12;
+
+namespace
+{
+	float SignNotZero(float value)
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	void Normalize(float vector[3])
+	{
+		float length = std::sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+		if (length > 0.0f)
+		{
+			for (int axis = 0; axis < 3; axis++)
+				vector[axis] /= length;
+		}
+	}
+
+	// 0 if either vector is zero
+	float AngleInDegrees(const float a[3], const float b[3])
+	{
+		float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+		float lengths = std::sqrt((a[0] * a[0] + a[1] * a[1] + a[2] * a[2]) * (b[0] * b[0] + b[1] * b[1] + b[2] * b[2]));
+		if (lengths == 0.0f)
+			return 0.0f;
+		return std::acos(std::clamp(dot / lengths, -1.0f, 1.0f)) * (180.0f / 3.14159265f);
+	}
+}
+
+uint16_t FrameDX12::FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(float));
+
+	uint16_t sign = (bits >> 16) & 0x8000;
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+
+	// Infinity and NaN keep being that
+	if (magnitude >= 0x7F800000)
+		return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+
+	// 65520 and up round over the largest half
+	if (magnitude >= 0x477FF000)
+		return sign | 0x7C00;
+
+	// Under 2^-14 it's a subnormal half, the implicit 1 of the float goes on the mantissa
+	if (magnitude < 0x38800000)
+	{
+		if (magnitude < 0x33000000)
+			return sign;
+
+		uint32_t shift = 126 - (magnitude >> 23);
+		uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+		uint32_t half = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1)))
+			half++;
+		return sign | half;
+	}
+
+	// Rebias the exponent from 127 to 15. A rounding carry goes to the exponent, which is still the right value
+	uint32_t rebased = magnitude - 0x38000000;
+	uint32_t half = rebased >> 13;
+	uint32_t remainder = rebased & 0x1FFF;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		half++;
+	return sign | half;
+}
+
+float FrameDX12::HalfToFloat(uint16_t value)
+{
+	uint32_t sign = (value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+
+	if (exponent == 0)
+	{
+		float magnitude = mantissa * (1.0f / 16777216.0f);
+		return sign ? -magnitude : magnitude;
+	}
+
+	uint32_t bits = sign | (exponent == 31 ? 0x7F800000 : (exponent + 112) << 23) | (mantissa << 13);
+	float result;
+	memcpy(&result, &bits, sizeof(float));
+	return result;
+}
+
+int16_t FrameDX12::FloatToSNorm16(float value)
+{
+	return (int16_t)std::lrint(std::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+float FrameDX12::SNorm16ToFloat(int16_t value)
+{
+	// -32768 and -32767 are both -1, same as the GPU does
+	return std::max(value / 32767.0f, -1.0f);
+}
+
+uint16_t FrameDX12::FloatToUNorm16(float value)
+{
+	return (uint16_t)std::lrint(std::clamp(value, 0.0f, 1.0f) * 65535.0f);
+}
+
+float FrameDX12::UNorm16ToFloat(uint16_t value)
+{
+	return value / 65535.0f;
+}
+
+void FrameDX12::EncodeOctahedral(const float vector[3], int16_t encoded[2])
+{
+	float l1_norm = std::abs(vector[0]) + std::abs(vector[1]) + std::abs(vector[2]);
+	if (l1_norm == 0.0f)
+	{
+		encoded[0] = encoded[1] = 0;
+		return;
+	}
+
+	float u = vector[0] / l1_norm;
+	float v = vector[1] / l1_norm;
+	if (vector[2] < 0.0f)
+	{
+		float folded_u = (1.0f - std::abs(v)) * SignNotZero(u);
+		float folded_v = (1.0f - std::abs(u)) * SignNotZero(v);
+		u = folded_u;
+		v = folded_v;
+	}
+
+	float direction[3] = { vector[0], vector[1], vector[2] };
+	Normalize(direction);
+
+	float best_dot = -2.0f;
+	float u_scaled = u * 32767.0f;
+	float v_scaled = v * 32767.0f;
+	for (float u_rounded : { std::floor(u_scaled), std::ceil(u_scaled) })
+	{
+		for (float v_rounded : { std::floor(v_scaled), std::ceil(v_scaled) })
+		{
+			int16_t candidate[2] = { (int16_t)std::clamp(u_rounded, -32767.0f, 32767.0f), (int16_t)std::clamp(v_rounded, -32767.0f, 32767.0f) };
+			float decoded[3];
+			DecodeOctahedral(candidate, decoded);
+
+			float dot = decoded[0] * direction[0] + decoded[1] * direction[1] + decoded[2] * direction[2];
+			if (dot > best_dot)
+			{
+				best_dot = dot;
+				encoded[0] = candidate[0];
+				encoded[1] = candidate[1];
+			}
+		}
+	}
+}
+
+void FrameDX12::DecodeOctahedral(const int16_t encoded[2], float vector[3])
+{
+	float u = SNorm16ToFloat(encoded[0]);
+	float v = SNorm16ToFloat(encoded[1]);
+
+	vector[0] = u;
+	vector[1] = v;
+	vector[2] = 1.0f - std::abs(u) - std::abs(v);
+	if (vector[2] < 0.0f)
+	{
+		vector[0] = (1.0f - std::abs(v)) * SignNotZero(u);
+		vector[1] = (1.0f - std::abs(u)) * SignNotZero(v);
+	}
+	Normalize(vector);
+}
+
+void QuantizationError::AddPosition(const float original[3], const float decoded[3])
+{
+	float distance_squared = 0.0f;
+	for (int axis = 0; axis < 3; axis++)
+		distance_squared += (original[axis] - decoded[axis]) * (original[axis] - decoded[axis]);
+	position = std::max(position, std::sqrt(distance_squared));
+}
+
+void QuantizationError::AddNormal(const float original[3], const float decoded[3])
+{
+	normal = std::max(normal, AngleInDegrees(original, decoded));
+}
+
+void QuantizationError::AddTangent(const float original[4], const float decoded[4])
+{
+	tangent = std::max(tangent, AngleInDegrees(original, decoded));
+	if (SignNotZero(original[3]) != SignNotZero(decoded[3]))
+		tangent_sign++;
+}
+
+void QuantizationError::AddUV(const float original[2], const float decoded[2])
+{
+	uv = std::max({ uv, std::abs(original[0] - decoded[0]), std::abs(original[1] - decoded[1]) });
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+
+// No D3D on this file, it's only the packing math of the quantized vertex formats
+
+namespace FrameDX12
+{
+	// IEEE half, rounding to the nearest even. Out of range values become infinity
+	uint16_t FloatToHalf(float value);
+	float HalfToFloat(uint16_t value);
+
+	// Values out of [-1, 1] and [0, 1] are clamped
+	int16_t FloatToSNorm16(float value);
+	float SNorm16ToFloat(int16_t value);
+	uint16_t FloatToUNorm16(float value);
+	float UNorm16ToFloat(uint16_t value);
+
+	// Unit vector to 2 snorm16 with the octahedral mapping: the vector is projected to the octahedron |x| + |y| + |z| = 1 and the lower
+	//  half is folded over the upper one, so the whole sphere fits on a square with an almost uniform precision
+	// Of the 4 roundings around the exact value, the one that decodes closer to the input is used
+	void EncodeOctahedral(const float vector[3], int16_t encoded[2]);
+	void DecodeOctahedral(const int16_t encoded[2], float vector[3]);
+
+	// Largest error of each attribute over the vertices added
+	struct QuantizationError
+	{
+		float position = 0.0f;     // Distance, in the units of the mesh
+		float normal = 0.0f;       // Angle in degrees
+		float tangent = 0.0f;      // Angle in degrees
+		float uv = 0.0f;           // Largest difference on u or v
+		uint32_t tangent_sign = 0; // Vertices that got the wrong bitangent sign
+
+		void AddPosition(const float original[3], const float decoded[3]);
+		// Zero vectors are skipped, they come from OBJs without normals
+		void AddNormal(const float original[3], const float decoded[3]);
+		void AddTangent(const float original[4], const float decoded[4]);
+		void AddUV(const float original[2], const float decoded[2]);
+	};
+}
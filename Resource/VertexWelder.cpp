@@ -0,0 +1,201 @@
+#include "VertexWelder.h"
+#include <cmath>
+#include <emmintrin.h>
+
+using namespace FrameDX12;
+
+namespace
+{
+	// Open addressing map from 3 uint32 to an uint32, with linear probing
+	// Grows when half full, so the probes stay short
+	class TripletMap
+	{
+	public:
+		static constexpr uint32_t kEmpty = UINT32_MAX;
+
+		explicit TripletMap(size_t expected_entries)
+		{
+			size_t capacity = 16;
+			while (capacity < expected_entries * 2)
+				capacity *= 2;
+			mEntries.assign(capacity, { { 0, 0, 0 }, kEmpty });
+		}
+
+		// Returns the value of the key, inserting the given one if the key wasn't there
+		uint32_t FindOrInsert(uint32_t a, uint32_t b, uint32_t c, uint32_t value)
+		{
+			if ((mCount + 1) * 2 > mEntries.size())
+				Grow();
+
+			Entry& entry = Probe(a, b, c);
+			if (entry.value == kEmpty)
+			{
+				entry = { { a, b, c }, value };
+				++mCount;
+			}
+			return entry.value;
+		}
+
+		// kEmpty if the key isn't there
+		uint32_t Find(uint32_t a, uint32_t b, uint32_t c)
+		{
+			return Probe(a, b, c).value;
+		}
+	private:
+		struct Entry
+		{
+			uint32_t key[3];
+			uint32_t value;
+		};
+
+		static size_t Hash(uint32_t a, uint32_t b, uint32_t c)
+		{
+			uint64_t hash = a * 0x9E3779B97F4A7C15ull;
+			hash ^= b * 0xC2B2AE3D27D4EB4Full + (hash << 6) + (hash >> 2);
+			hash ^= c * 0x165667B19E3779F9ull + (hash << 6) + (hash >> 2);
+			return hash ^ (hash >> 32);
+		}
+
+		// The entry of the key, or the empty one where it would go
+		Entry& Probe(uint32_t a, uint32_t b, uint32_t c)
+		{
+			size_t mask = mEntries.size() - 1;
+			for (size_t slot = Hash(a, b, c) & mask;; slot = (slot + 1) & mask)
+			{
+				Entry& entry = mEntries[slot];
+				if (entry.value == kEmpty || (entry.key[0] == a && entry.key[1] == b && entry.key[2] == c))
+					return entry;
+			}
+		}
+
+		void Grow()
+		{
+			std::vector<Entry> old_entries(mEntries.size() * 2, { { 0, 0, 0 }, kEmpty });
+			std::swap(old_entries, mEntries);
+			for (const Entry& entry : old_entries)
+			{
+				if (entry.value != kEmpty)
+					Probe(entry.key[0], entry.key[1], entry.key[2]) = entry;
+			}
+		}
+
+		std::vector<Entry> mEntries;
+		size_t mCount = 0;
+	};
+
+	// Cells further than this from the origin are clamped, so the cell of the neighbours can't overflow
+	// Values out of the range share the border cells, and only the first one kept on a cell is found there, so far away values may not merge
+	constexpr float kMaxCell = 1 << 30;
+
+	// For each attribute of components floats (2 or 3), the one it's merged with (itself if it's kept)
+	std::vector<uint32_t> WeldAttribute(const std::vector<float>& values, uint32_t components, float tolerance)
+	{
+		// Grid cell of each coordinate, floor(value / tolerance). The component boundaries don't matter, so it goes 4 floats at a time
+		std::vector<int32_t> cells(values.size());
+		const float inverse_tolerance = 1.0f / tolerance;
+		const __m128 inverse_tolerance4 = _mm_set1_ps(inverse_tolerance);
+		const __m128 max_cell = _mm_set1_ps(kMaxCell), min_cell = _mm_set1_ps(-kMaxCell);
+		size_t idx = 0;
+		for (; idx + 4 <= values.size(); idx += 4)
+		{
+			// min returns the second operand on NaN, so NaN goes to the max cell
+			__m128 scaled = _mm_mul_ps(_mm_loadu_ps(values.data() + idx), inverse_tolerance4);
+			scaled = _mm_max_ps(_mm_min_ps(scaled, max_cell), min_cell);
+
+			// SSE2 only truncates, so 1 is subtracted where that rounded up (the compare gives -1 there)
+			__m128i truncated = _mm_cvttps_epi32(scaled);
+			__m128i rounded_up = _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(truncated), scaled));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(cells.data() + idx), _mm_add_epi32(truncated, rounded_up));
+		}
+		for (; idx < values.size(); idx++)
+		{
+			float scaled = values[idx] * inverse_tolerance;
+			scaled = scaled < kMaxCell ? scaled : kMaxCell;
+			scaled = scaled > -kMaxCell ? scaled : -kMaxCell;
+			cells[idx] = (int32_t)std::floor(scaled);
+		}
+
+		auto is_close = [&](uint32_t a, uint32_t b)
+		{
+			for (uint32_t component = 0; component < components; component++)
+			{
+				if (!(std::abs(values[components * a + component] - values[components * b + component]) <= tolerance))
+					return false;
+			}
+			return true;
+		};
+
+		// Cell to the first value kept on it. 2 component values use the z 0 cells
+		size_t count = values.size() / components;
+		int32_t z_range = components == 3 ? 1 : 0;
+		TripletMap kept(count);
+		std::vector<uint32_t> remap(count);
+		for (uint32_t value = 0; value < count; value++)
+		{
+			const int32_t* cell = cells.data() + components * value;
+			int32_t cell_z = components == 3 ? cell[2] : 0;
+			uint32_t own_cell = kept.Find(cell[0], cell[1], cell_z);
+
+			uint32_t found = TripletMap::kEmpty;
+			if (own_cell != TripletMap::kEmpty && is_close(own_cell, value))
+				found = own_cell;
+
+			// Values closer than the tolerance can be on the cells around
+			for (int32_t dx = -1; dx <= 1 && found == TripletMap::kEmpty; dx++)
+				for (int32_t dy = -1; dy <= 1 && found == TripletMap::kEmpty; dy++)
+					for (int32_t dz = -z_range; dz <= z_range && found == TripletMap::kEmpty; dz++)
+					{
+						uint32_t candidate = kept.Find(cell[0] + dx, cell[1] + dy, cell_z + dz);
+						if (candidate != TripletMap::kEmpty && is_close(candidate, value))
+							found = candidate;
+					}
+
+			if (found != TripletMap::kEmpty)
+			{
+				remap[value] = found;
+			}
+			else
+			{
+				remap[value] = value;
+				if (own_cell == TripletMap::kEmpty)
+					kept.FindOrInsert(cell[0], cell[1], cell_z, value);
+			}
+		}
+
+		return remap;
+	}
+}
+
+void FrameDX12::WeldOBJ(const OBJData& obj, std::vector<OBJData::Corner>& vertices, std::vector<uint32_t>& indices, float tolerance)
+{
+	std::vector<uint32_t> position_remap, normal_remap, texcoord_remap;
+	if (tolerance > 0.0f)
+	{
+		position_remap = WeldAttribute(obj.positions, 3, tolerance);
+		normal_remap = WeldAttribute(obj.normals, 3, tolerance);
+		texcoord_remap = WeldAttribute(obj.texcoords, 2, tolerance);
+	}
+
+	vertices.clear();
+	indices.resize(obj.corners.size());
+
+	// Closed meshes usually have around a vertex per 6 corners
+	TripletMap welded(obj.corners.size() / 4);
+	for (size_t idx = 0; idx < obj.corners.size(); idx++)
+	{
+		OBJData::Corner corner = obj.corners[idx];
+		if (tolerance > 0.0f)
+		{
+			corner.position = position_remap[corner.position];
+			if (corner.normal != OBJData::kMissing) corner.normal = normal_remap[corner.normal];
+			if (corner.texcoord != OBJData::kMissing) corner.texcoord = texcoord_remap[corner.texcoord];
+		}
+
+		uint32_t new_vertex = vertices.size();
+		uint32_t vertex = welded.FindOrInsert(corner.position, corner.normal, corner.texcoord, new_vertex);
+		if (vertex == new_vertex)
+			vertices.push_back(corner);
+
+		indices[idx] = vertex;
+	}
+}
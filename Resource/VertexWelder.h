@@ -0,0 +1,17 @@
+#pragma once
+#include "OBJParser.h"
+
+// No D3D on this file, it works on the indices of the parsed OBJ
+
+namespace FrameDX12
+{
+	// Merges the corners of an OBJ that end up as the same vertex
+	// Two corners are the same vertex if they use the same position, normal and texcoord indices, so the welding never needs to look at
+	//  the attribute values. The triplets go on an open addressing hash map, with no allocations per corner
+	// With a tolerance, the attribute values closer than it on every component are merged first (fuzzy welding), for OBJs that repeat
+	//  values with slightly different bits, or that write a normal or texcoord per corner. That pass snaps the values to a grid of the
+	//  tolerance size 4 floats at a time with SSE, and looks for an already kept value on the cells around each one. Which value is kept
+	//  depends on the order of the file
+	// Output: a corner per unique vertex, pointing at the attributes to use, and an index per corner of the input
+	void WeldOBJ(const OBJData& obj, std::vector<OBJData::Corner>& vertices, std::vector<uint32_t>& indices, float tolerance = 0.0f);
+}
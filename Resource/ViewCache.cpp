@@ -0,0 +1,81 @@
+#include "ViewCache.h"
+#include "../Device/Device.h"
+
+using namespace FrameDX12;
+
+ViewCache::Shard& ViewCache::GetShard(ID3D12Resource* resource)
+{
+	// Resources are at least 8 bytes aligned, drop the low bits before picking the shard
+	return mShards[(reinterpret_cast<uintptr_t>(resource) >> 4) % kShardsCount];
+}
+
+ViewCache::View ViewCache::FindOrCreate(ID3D12Resource* resource, const Key& key, const std::function<void(D3D12_CPU_DESCRIPTOR_HANDLE)>& create)
+{
+	Shard& shard = GetShard(resource);
+	std::scoped_lock lock(shard.lock);
+
+	auto& views = shard.views[resource];
+	for (auto& cached : views)
+	{
+		if (memcmp(&cached.key, &key, sizeof(Key)) == 0)
+			return cached.view;
+	}
+
+	CachedView& cached = views.emplace_back();
+	cached.key = key;
+	cached.view.descriptor = mDevice->GetDescriptorPool(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV).GetNextDescriptor();
+	create(*cached.view.descriptor);
+
+	if (mDevice->IsBindlessEnabled())
+		cached.view.bindless_index = mDevice->GetShaderVisibleHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV).PublishBindless(cached.view.descriptor);
+
+	return cached.view;
+}
+
+ViewCache::View ViewCache::GetSRV(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* desc)
+{
+	// Zero everything so the padding compares equal
+	Key key;
+	memset(&key, 0, sizeof(Key));
+	key.type = ViewType::SRV;
+	key.has_desc = desc != nullptr;
+	if (desc) key.srv = *desc;
+
+	return FindOrCreate(resource, key, [&](D3D12_CPU_DESCRIPTOR_HANDLE handle)
+	{
+		mDevice->GetDevice()->CreateShaderResourceView(resource, desc, handle);
+	});
+}
+
+ViewCache::View ViewCache::GetUAV(ID3D12Resource* resource, ID3D12Resource* counter, const D3D12_UNORDERED_ACCESS_VIEW_DESC* desc)
+{
+	Key key;
+	memset(&key, 0, sizeof(Key));
+	key.type = ViewType::UAV;
+	key.has_desc = desc != nullptr;
+	key.counter = counter;
+	if (desc) key.uav = *desc;
+
+	return FindOrCreate(resource, key, [&](D3D12_CPU_DESCRIPTOR_HANDLE handle)
+	{
+		mDevice->GetDevice()->CreateUnorderedAccessView(resource, counter, desc, handle);
+	});
+}
+
+std::vector<ViewCache::View> ViewCache::Evict(ID3D12Resource* resource)
+{
+	Shard& shard = GetShard(resource);
+	std::scoped_lock lock(shard.lock);
+
+	std::vector<View> evicted;
+	auto entry = shard.views.find(resource);
+	if (entry == shard.views.end())
+		return evicted;
+
+	evicted.reserve(entry->second.size());
+	for (auto& cached : entry->second)
+		evicted.push_back(std::move(cached.view));
+	shard.views.erase(entry);
+
+	return evicted;
+}
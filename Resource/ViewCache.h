@@ -0,0 +1,74 @@
+#pragma once
+#include "../Core/stdafx.h"
+#include "DescriptorPool.h"
+#include "BindlessIndex.h"
+
+namespace FrameDX12
+{
+	// Deduplicates SRVs and UAVs, so asking for the same view of the same resource from many places returns the same descriptor
+	//  instead of using a new slot and calling Create*View again
+	// The cache keeps a reference to the views, so they live until the resource is evicted
+	// Entries are split in shards by resource, each shard with its own lock, so concurrent lookups of different resources don't contend
+	// ------------------------------------------------------------------------------------------------------------------
+	// Views are compared with the raw bytes of the desc. Garbage on the unused parts of the union can make two equal views miss,
+	//  but never makes two different views match
+	class ViewCache
+	{
+	public:
+		struct View
+		{
+			Descriptor descriptor;
+			BindlessIndex bindless_index; // Only valid if the device has bindless enabled
+		};
+
+		ViewCache(class Device* device) :
+			mDevice(device)
+		{}
+
+		// Returns the view for the resource and desc, creating it if it's not cached
+		// Thread safe
+		View GetSRV(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* desc);
+		View GetUAV(ID3D12Resource* resource, ID3D12Resource* counter, const D3D12_UNORDERED_ACCESS_VIEW_DESC* desc);
+
+		// Removes all the views of the resource from the cache and returns them, so the caller decides when they are released
+		// Needs to be called when the resource is destroyed, as a new one can get the same address. CommitedResource does it on
+		//  destruction, and defers the returned views together with the resource
+		// Thread safe
+		std::vector<View> Evict(ID3D12Resource* resource);
+	private:
+		enum class ViewType : uint32_t { SRV, UAV };
+
+		struct Key
+		{
+			ViewType type;
+			bool has_desc;
+			ID3D12Resource* counter;
+			union
+			{
+				D3D12_SHADER_RESOURCE_VIEW_DESC srv;
+				D3D12_UNORDERED_ACCESS_VIEW_DESC uav;
+			};
+		};
+
+		struct CachedView
+		{
+			Key key;
+			View view;
+		};
+
+		static constexpr size_t kShardsCount = 16;
+		struct Shard
+		{
+			std::mutex lock;
+			// Resources usually only have a handful of views, so they are just searched linearly
+			std::unordered_map<ID3D12Resource*, std::vector<CachedView>> views;
+		} mShards[kShardsCount];
+
+		Shard& GetShard(ID3D12Resource* resource);
+
+		// Looks for the key on the resource views, and calls create to make the view if it's not there
+		View FindOrCreate(ID3D12Resource* resource, const Key& key, const std::function<void(D3D12_CPU_DESCRIPTOR_HANDLE)>& create);
+
+		class Device* mDevice;
+	};
+}
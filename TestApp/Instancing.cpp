@@ -1,4 +1,3 @@
-#if 1
 #define WIN32_LEAN_AND_MEAN // Exclude rarely used stuff from Windows headers
 #define NOMINMAX
 #include <Windows.h>
@@ -12,6 +11,7 @@
 #include "../Resource/Mesh.h"
 #include "../Resource/ConstantBuffer.h"
 #include "../Resource/StructuredBuffer.h"
+#include "../Resource/InstanceTransforms.h"
 #include <iostream>
 #include "pix3.h"
 
@@ -22,7 +22,7 @@ using namespace DirectX;
 
 constexpr int kWorkerCount = 4;
 
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, int showCmd)
+int RunInstancing(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, int showCmd)
 {
     // Enable run-time memory check for debug builds.
 #if defined(DEBUG) | defined(_DEBUG)
@@ -114,10 +114,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
     LogErrorBlob(error_blob);
 
     // Load mesh
-    CommandGraph copy_graph(kWorkerCount, QueueType::Copy, &dev);
-
+    // The copy is streamed on the copy queue, the render loop only waits for it on the GPU
     Mesh monkey;
-    monkey.BuildFromOBJ(&dev, copy_graph, "monkey.obj");
+    UploadTicket monkey_upload = monkey.StreamFromOBJ(&dev, "monkey.obj");
     constexpr uint32_t kInstancesCount = 10000;
 
     // Define pipeline state 
@@ -137,9 +136,6 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
     pipeline_state.DSVFormat = DXGI_FORMAT_D32_FLOAT;
     pipeline_state.SampleDesc.Count = 1;
 
-    copy_graph.Build(&dev);
-    copy_graph.Execute(&dev);
-
     // Create CB
     /*struct alignas(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT) CBData
     {
@@ -148,15 +144,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
     };
     ConstantBuffer<CBData> cb;
     cb.Create(&dev);*/
-    struct InstanceData
-    {
-        XMFLOAT4X4 World;
-        XMFLOAT4X4 WVP;
-    };
-    StructuredBuffer<InstanceData> instances_data_buffer;
-    vector<InstanceData> instances_data(kInstancesCount);
-    instances_data_buffer.Create(&dev, kInstancesCount);
-    instances_data_buffer.Map();
+    // The matrices are computed on the graph workers and written straight to a mapped buffer
+    InstanceTransforms instances;
+    instances.Create(&dev, kInstancesCount);
 
     // -------------------------------
     //      Render setup
@@ -165,7 +155,31 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
     // Create the command graph
     CommandGraph commands(kWorkerCount, QueueType::Graphics, &dev);
 
-    // For this demo we can do everything on one node
+    // Moves the instances, writing their position and rotation streams a chunk per repeat
+    float game_seconds = 0;
+    commands.AddNode("Animate", nullptr, [&](ID3D12GraphicsCommandList*, uint32_t chunk)
+    {
+        float* position_x = instances.GetStream(InstanceTransforms::PositionX);
+        float* position_y = instances.GetStream(InstanceTransforms::PositionY);
+        float* position_z = instances.GetStream(InstanceTransforms::PositionZ);
+        float* rotation_y = instances.GetStream(InstanceTransforms::RotationY);
+        float* rotation_w = instances.GetStream(InstanceTransforms::RotationW);
+
+        for (uint32_t idx = instances.GetChunkStart(chunk); idx < instances.GetChunkEnd(chunk); idx++)
+        {
+            float yaw = sin(idx + game_seconds * 0.5);
+            rotation_y[idx] = sin(yaw * 0.5f);
+            rotation_w[idx] = cos(yaw * 0.5f);
+
+            position_x[idx] = cos(idx + game_seconds * 0.75) * 2;
+            position_y[idx] = sin(idx + game_seconds * 0.6) * 2.5;
+            position_z[idx] = (float)idx;
+        }
+    }, {}, instances.GetChunkCount());
+
+    instances.AddUpdateNode(commands, "Instance Transforms", { "Animate" });
+
+    // The rest can go on one node
     commands.AddNode("Clear Draw Present", nullptr, [&](ID3D12GraphicsCommandList* cl, uint32_t)
     {
         // Clear
@@ -186,17 +200,15 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
         D3D12_CPU_DESCRIPTOR_HANDLE dsv = *depth_buffer.GetDSV();
         cl->OMSetRenderTargets(1, rts, false, &dsv);
 
-        // TODO : Move this to a function on the device that sets all the heaps
-        ID3D12DescriptorHeap* desc_vec[] = { dev.GetDescriptorPool(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV).GetHeap() };
-        cl->SetDescriptorHeaps(1, desc_vec);
+        dev.SetDescriptorHeaps(cl);
 
         //cl->SetGraphicsRootDescriptorTable(0, cb.GetView().GetGPUDescriptor());
-        cl->SetGraphicsRootDescriptorTable(0, instances_data_buffer.GetSRV().GetGPUDescriptor());
+        cl->SetGraphicsRootDescriptorTable(0, dev.GetDescriptorTable({ instances.GetSRV() }));
         monkey.Draw(cl, kInstancesCount);
 
         // Present
         backbuffer.Transition(cl, D3D12_RESOURCE_STATE_PRESENT);
-    }, {});
+    }, { "Instance Transforms" });
 
     commands.Build(&dev);
 
@@ -204,11 +216,15 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
     auto view_matrix = XMMatrixLookAtRH(XMVectorSet(0, 1, -2, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
     auto proj_matrix = XMMatrixPerspectiveFovRH(90_deg, window.GetSizeX() / (float)window.GetSizeY(), 0.01, 1000);
 
+    // The scale doesn't change
+    for (uint32_t idx = 0; idx < kInstancesCount; idx++)
+        instances.SetTransform(idx, XMVectorZero(), XMQuaternionIdentity(), XMVectorReplicate(0.75f));
+
     // -------------------------------
     //      Render loop
     // -------------------------------
-    // Make sure all transfers finished
-    dev.WaitForQueue(QueueType::Copy);
+    // The graphics queue waits for the mesh upload, the CPU keeps going
+    dev.GetStreamingUploader().QueueWait(QueueType::Graphics, monkey_upload);
 
     // To print some debug metrics
     float execute_cl_time, frame_time;
@@ -229,31 +245,17 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
     // Enter the render loop
     window.CallDuringIdle([&](double elapsed_time)
     {
+        // Make sure the GPU finished the last frame that used this frame resources
+        // Usually it did long ago, the buffers have a copy per frame so updating them doesn't need anything else
+        dev.WaitForWork(QueueType::Graphics, execute_ids[sCurrentResourceBufferIndex]);
+
         float delta_seconds = elapsed_time / 1000.0f;
-        static float game_seconds = 0;
         game_seconds += delta_seconds;
 
-        for (int idx = 0; idx < kInstancesCount; idx++)
-        {
-            auto wvp = XMMatrixScaling(0.75, 0.75, 0.75);
-            wvp = XMMatrixMultiply(wvp, XMMatrixRotationRollPitchYaw(0, sin(idx + game_seconds * 0.5), 0));
-            wvp = XMMatrixMultiply(wvp, XMMatrixTranslation(cos(idx + game_seconds * 0.75) * 2, sin(idx + game_seconds * 0.6) * 2.5, idx));
-
-            XMStoreFloat4x4(&instances_data[idx].World, XMMatrixTranspose(wvp));
-
-            wvp = XMMatrixMultiply(wvp, view_matrix);
-            wvp = XMMatrixMultiply(wvp, proj_matrix);
-
-            XMStoreFloat4x4(&instances_data[idx].WVP, XMMatrixTranspose(wvp));
-        }
-
-        instances_data_buffer.Update(instances_data);
+        instances.BeginFrame(XMMatrixMultiply(view_matrix, proj_matrix));
 
         frame_time = elapsed_time;
 
-        // Make sure we are finished with this frame resources before executing
-        dev.WaitForWork(QueueType::Graphics, execute_ids[sCurrentResourceBufferIndex]);
-
         auto start = chrono::high_resolution_clock::now();
         execute_ids[sCurrentResourceBufferIndex] = commands.Execute(&dev, dev.GetPSO(pipeline_state));
         auto end = chrono::high_resolution_clock::now();
@@ -262,11 +264,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
         dev.GetSwapChain()->Present(0, 0);
 
         // Advance buffer index
-        sCurrentResourceBufferIndex = (sCurrentResourceBufferIndex + 1) % kResourceBufferCount;
+        dev.AdvanceFrame();
 
         return false;
     });
 
     return 0;
 }
-#endif // 1
@@ -0,0 +1,17 @@
+#define WIN32_LEAN_AND_MEAN // Exclude rarely used stuff from Windows headers
+#define NOMINMAX
+#include <Windows.h>
+#include <cstring>
+
+// The samples, each on its own file
+int RunInstancing(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, int showCmd);
+int RunMultipleMeshRendering(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, int showCmd);
+
+// Runs the instancing sample by default, pass "meshes" on the command line for the multiple mesh one
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, int showCmd)
+{
+    if (cmdLine && strstr(cmdLine, "meshes"))
+        return RunMultipleMeshRendering(hInstance, prevInstance, cmdLine, showCmd);
+
+    return RunInstancing(hInstance, prevInstance, cmdLine, showCmd);
+}
@@ -1,4 +1,3 @@
-#if 0
 #define WIN32_LEAN_AND_MEAN // Exclude rarely used stuff from Windows headers
 #define NOMINMAX
 #include <Windows.h>
@@ -10,7 +9,7 @@
 #include "../Resource/RenderTarget.h"
 #include "../Resource/CommitedResource.h"
 #include "../Resource/Mesh.h"
-#include "../Resource/ConstantBuffer.h"
+#include "../Core/StreamingCopy.h"
 #include <iostream>
 #include "pix3.h"
 
@@ -21,7 +20,7 @@ using namespace DirectX;
 
 constexpr int kWorkerCount = 4;
 
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, int showCmd)
+int RunMultipleMeshRendering(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, int showCmd)
 {
     // Enable run-time memory check for debug builds.
 #if defined(DEBUG) | defined(_DEBUG)
@@ -77,11 +76,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
     //  Create root signature
     ComPtr<ID3D12RootSignature> root_signature;
     {
-        CD3DX12_DESCRIPTOR_RANGE ranges[1]; // Perfomance TIP: Order from most frequent to least frequent.
-        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0);		// 1 frequently changed constant buffer.
-
-        CD3DX12_ROOT_PARAMETER rootParameters[1];
-        rootParameters[0].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_ALL);
+        // The per draw constants of the frame go on a root SRV, and the indirect draws write the index of theirs to the root constant
+        CD3DX12_ROOT_PARAMETER rootParameters[2];
+        rootParameters[0].InitAsShaderResourceView(0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+        rootParameters[1].InitAsConstants(1, 0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
 
         CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
         rootSignatureDesc.Init(_countof(rootParameters), rootParameters, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
@@ -142,23 +140,30 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
     // Model loading takes a good time on debug
     vector<unique_ptr<Mesh>> monkeys(3);
 #endif
+    // All the monkeys share the same vertex and index buffers
+    MeshCollection mesh_collection(&dev);
     for (auto& m : monkeys)
     {
         m = make_unique<Mesh>();
-        m->BuildFromOBJ(&dev, copy_graph, "monkey.obj");
+        m->BuildFromOBJ(&dev, copy_graph, "monkey.obj", mesh_collection);
     }
 
     copy_graph.Build(&dev);
     copy_graph.Execute(&dev);
 
-    // Create CB
-    struct alignas(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT) CBData
+    // Per draw constants, computed each frame and copied to the frame constants allocator before recording
+    struct CBData
     {
         XMFLOAT4X4 World;
         XMFLOAT4X4 WVP;
     };
-    ConstantBuffer<CBData> cb;
-    cb.Create(&dev, monkeys.size());
+    vector<CBData> monkey_constants(monkeys.size());
+    D3D12_GPU_VIRTUAL_ADDRESS monkey_constants_address = 0;
+
+    // All the monkeys go on a single multi-draw, with their index as the draw id
+    vector<MeshCollection::IndirectDraw> monkey_draws(monkeys.size());
+    for (uint32_t idx = 0; idx < monkeys.size(); idx++)
+        monkey_draws[idx] = { &monkeys[idx]->GetRange(), 0, idx };
 
     // -------------------------------
     //      Render setup
@@ -189,18 +194,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
         D3D12_CPU_DESCRIPTOR_HANDLE dsv = *depth_buffer.GetDSV();
         cl->OMSetRenderTargets(1, rts, false, &dsv);
 
-        // TODO : Move this to a function on the device that sets all the heaps
-        ID3D12DescriptorHeap* desc_vec[] = { dev.GetDescriptorPool(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV).GetHeap() };
-        cl->SetDescriptorHeaps(1, desc_vec);
-    },
-    [&](ID3D12GraphicsCommandList* cl, uint32_t idx)
-    {
-        idx %= monkeys.size();
+        dev.SetDescriptorHeaps(cl);
 
-        cl->SetGraphicsRootDescriptorTable(0, cb.GetView(idx).GetGPUDescriptor());
-
-        monkeys[idx]->Draw(cl);
-    }, { "Clear" }, monkeys.size());
+        // A single PSO, set by Execute
+        cl->SetGraphicsRootShaderResourceView(0, monkey_constants_address);
+        mesh_collection.DrawIndirect(cl, monkey_draws.data(), monkey_draws.size(), 1, root_signature.Get(), 1, [](ID3D12GraphicsCommandList*, uint32_t) {});
+    }, nullptr, { "Clear" });
 
     commands.AddNode("Present", [&](ID3D12GraphicsCommandList* cl)
     {
@@ -238,6 +237,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
     // Enter the render loop
     window.CallDuringIdle([&](double elapsed_time)
     {
+        // Make sure we are finished with this frame resources before writing them. This also covers the frame constants region
+        dev.WaitForWork(QueueType::Graphics, execute_ids[sCurrentResourceBufferIndex]);
+
         float delta_seconds = elapsed_time / 1000.0f;
         static float game_seconds = 0;
         game_seconds += delta_seconds;
@@ -256,13 +258,14 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
 
             XMStoreFloat4x4(&data.WVP, XMMatrixTranspose(wvp));
 
-            cb.Update(data, idx);
+            monkey_constants[idx] = data;
         }
 
-        frame_time = elapsed_time;
+        auto constants = dev.GetFrameConstants().Allocate(monkey_constants.size() * sizeof(CBData));
+        StreamingCopy(constants.cpu_ptr, monkey_constants.data(), monkey_constants.size() * sizeof(CBData));
+        monkey_constants_address = constants.gpu_address;
 
-        // Make sure we are finished with this frame resources before executing
-        dev.WaitForWork(QueueType::Graphics, execute_ids[sCurrentResourceBufferIndex]);
+        frame_time = elapsed_time;
 
         auto start = chrono::high_resolution_clock::now();
         execute_ids[sCurrentResourceBufferIndex] = commands.Execute(&dev, dev.GetPSO(pipeline_state));
@@ -272,11 +275,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
         dev.GetSwapChain()->Present(0, 0);
 
         // Advance buffer index
-        sCurrentResourceBufferIndex = (sCurrentResourceBufferIndex + 1) % kResourceBufferCount;
+        dev.AdvanceFrame();
 
         return false;
     });
 
     return 0;
 }
-#endif // 1
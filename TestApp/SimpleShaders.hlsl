@@ -1,8 +1,15 @@
-cbuffer ConstantBuffer : register(b0)
+struct DrawConstants
 {
 	float4x4 World;
 	float4x4 WVP;
 };
+StructuredBuffer<DrawConstants> Draws : register(t0);
+
+// Written by the indirect draw
+cbuffer DrawIndex : register(b0)
+{
+	uint DrawId;
+};
 
 struct VSIn
 {
@@ -21,10 +28,11 @@ struct PSIn
 PSIn VSMain(VSIn input)
 {
 	PSIn output = (PSIn)0;
+	DrawConstants draw = Draws[DrawId];
 
-	output.spos = mul(float4(input.pos, 1.0f), WVP);
+	output.spos = mul(float4(input.pos, 1.0f), draw.WVP);
 
-	output.normal = mul(input.normal, (float3x3)World);
+	output.normal = mul(input.normal, (float3x3)draw.World);
 	return output;
 }
 
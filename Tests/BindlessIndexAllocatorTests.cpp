@@ -0,0 +1,108 @@
+#include "Resource/BindlessIndexAllocator.h"
+#include "Resource/DeferredReleaseQueue.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <tuple>
+
+using namespace FrameDX12;
+
+namespace
+{
+	// Same as BindlessIndex::RetiredIndex, returns the index when the deferred release queue destroys it
+	struct RetiredIndex
+	{
+		RetiredIndex(BindlessIndexAllocator* allocator, uint32_t index) : allocator(allocator), index(index) {}
+		RetiredIndex(RetiredIndex&& other) : allocator(std::exchange(other.allocator, nullptr)), index(other.index) {}
+		~RetiredIndex() { if (allocator) allocator->Release(index); }
+
+		BindlessIndexAllocator* allocator;
+		uint32_t index;
+	};
+
+	DeferredReleaseQueue::FenceValues Fences(uint64_t graphics, uint64_t compute = 0, uint64_t copy = 0)
+	{
+		DeferredReleaseQueue::FenceValues fences;
+		fences.values[0] = graphics;
+		fences.values[1] = compute;
+		fences.values[2] = copy;
+		return fences;
+	}
+}
+
+TEST(BindlessIndexAllocator, AllocatesUntilFull)
+{
+	BindlessIndexAllocator allocator;
+	allocator.Initialize(3);
+
+	EXPECT_EQ(allocator.Allocate(), 0u);
+	EXPECT_EQ(allocator.Allocate(), 1u);
+	EXPECT_EQ(allocator.Allocate(), 2u);
+	EXPECT_EQ(allocator.Allocate(), BindlessIndexAllocator::kInvalidIndex);
+	EXPECT_EQ(allocator.GetUsedCount(), 3u);
+}
+
+TEST(BindlessIndexAllocator, ReusesReleasedIndexes)
+{
+	BindlessIndexAllocator allocator;
+	allocator.Initialize(2);
+
+	uint32_t first = allocator.Allocate();
+	allocator.Allocate();
+	allocator.Release(first);
+	allocator.Release(BindlessIndexAllocator::kInvalidIndex);
+
+	EXPECT_EQ(allocator.GetUsedCount(), 1u);
+	EXPECT_EQ(allocator.Allocate(), first);
+}
+
+TEST(BindlessIndexAllocator, DeferredIndexIsNotReusedBeforeTheFence)
+{
+	BindlessIndexAllocator allocator;
+	allocator.Initialize(1);
+	DeferredReleaseQueue releases;
+
+	uint32_t index = allocator.Allocate();
+	releases.Enqueue(Fences(5), RetiredIndex(&allocator, index));
+
+	EXPECT_EQ(releases.Drain(Fences(4)), 0u);
+	EXPECT_EQ(allocator.Allocate(), BindlessIndexAllocator::kInvalidIndex);
+
+	EXPECT_EQ(releases.Drain(Fences(5)), 1u);
+	EXPECT_EQ(allocator.Allocate(), index);
+}
+
+TEST(BindlessIndexAllocator, DeferredIndexWaitsForEveryUsedQueue)
+{
+	BindlessIndexAllocator allocator;
+	allocator.Initialize(1);
+	DeferredReleaseQueue releases;
+
+	releases.Enqueue(Fences(2, 0, 7), RetiredIndex(&allocator, allocator.Allocate()));
+
+	EXPECT_EQ(releases.Drain(Fences(10, 0, 6)), 0u);
+	EXPECT_EQ(allocator.GetUsedCount(), 1u);
+	EXPECT_EQ(releases.Drain(Fences(10, 0, 7)), 1u);
+	EXPECT_EQ(allocator.GetUsedCount(), 0u);
+}
+
+// CommitedResource takes the views out of the view cache and defers them together with its own indexes, so the last
+//  reference is always the deferred one, whichever order the copies are dropped in
+TEST(BindlessIndexAllocator, SharedIndexLivesUntilTheDeferredCopyIsReleased)
+{
+	BindlessIndexAllocator allocator;
+	allocator.Initialize(1);
+	DeferredReleaseQueue releases;
+
+	auto cached = std::make_shared<RetiredIndex>(&allocator, allocator.Allocate());
+	auto resource_copy = cached;
+
+	releases.Enqueue(Fences(3), std::make_tuple(std::move(cached), std::move(resource_copy)));
+	EXPECT_EQ(allocator.GetUsedCount(), 1u);
+
+	releases.Drain(Fences(2));
+	EXPECT_EQ(allocator.GetUsedCount(), 1u);
+
+	releases.Drain(Fences(3));
+	EXPECT_EQ(allocator.GetUsedCount(), 0u);
+	EXPECT_EQ(releases.GetPendingCount(), 0u);
+}
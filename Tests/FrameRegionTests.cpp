@@ -0,0 +1,125 @@
+#include "Resource/FrameRegion.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace FrameDX12;
+
+namespace
+{
+	constexpr uint64_t kRegionSize = 1024;
+	constexpr uint64_t kPageSize = 512;
+
+	// Stands for the upload resource of an overflow page
+	struct FakePage
+	{
+		int id;
+		uint64_t size;
+	};
+
+	struct FakePages
+	{
+		int created = 0;
+
+		FrameRegion<FakePage> MakeRegion()
+		{
+			return FrameRegion<FakePage>(kRegionSize, kPageSize, [this](uint64_t size) { return FakePage{ created++, size }; });
+		}
+	};
+}
+
+TEST(FrameRegion, TakesChunksFromTheRegionFirst)
+{
+	FakePages pages;
+	auto region = pages.MakeRegion();
+
+	auto a = region.TakeChunk(256);
+	auto b = region.TakeChunk(256);
+	EXPECT_EQ(a.page, nullptr);
+	EXPECT_EQ(a.offset, 0u);
+	EXPECT_EQ(b.page, nullptr);
+	EXPECT_EQ(b.offset, 256u);
+	EXPECT_EQ(region.GetUsedBytes(), 512u);
+	EXPECT_EQ(pages.created, 0);
+}
+
+TEST(FrameRegion, OverflowsToPages)
+{
+	FakePages pages;
+	auto region = pages.MakeRegion();
+
+	region.TakeChunk(kRegionSize);
+	auto first = region.TakeChunk(256);
+	auto second = region.TakeChunk(256);
+	auto third = region.TakeChunk(256);
+
+	ASSERT_NE(first.page, nullptr);
+	EXPECT_EQ(first.page, second.page);
+	EXPECT_EQ(second.offset, 256u);
+	ASSERT_NE(third.page, nullptr);
+	EXPECT_NE(third.page, first.page);
+	EXPECT_EQ(third.offset, 0u);
+	EXPECT_EQ(pages.created, 2);
+	EXPECT_EQ(region.GetUsedBytes(), kRegionSize + 768);
+}
+
+TEST(FrameRegion, BigChunksGetAPageOfTheirSize)
+{
+	FakePages pages;
+	auto region = pages.MakeRegion();
+
+	region.TakeChunk(kRegionSize);
+	auto chunk = region.TakeChunk(4 * kPageSize);
+	ASSERT_NE(chunk.page, nullptr);
+	EXPECT_EQ(chunk.page->size, 4 * kPageSize);
+}
+
+TEST(FrameRegion, ResetKeepsAndReusesThePages)
+{
+	FakePages pages;
+	auto region = pages.MakeRegion();
+
+	region.TakeChunk(kRegionSize);
+	const FakePage* page = region.TakeChunk(256).page;
+
+	region.Reset();
+	EXPECT_EQ(region.GetUsedBytes(), 0u);
+	EXPECT_EQ(region.TakeChunk(256).page, nullptr);
+
+	region.TakeChunk(kRegionSize - 256);
+	auto reused = region.TakeChunk(256);
+	EXPECT_EQ(reused.page, page);
+	EXPECT_EQ(reused.offset, 0u);
+	EXPECT_EQ(pages.created, 1);
+	EXPECT_EQ(region.GetOverflowPagesCount(), 1u);
+}
+
+TEST(FrameRegion, ParallelChunksDontOverlap)
+{
+	FakePages pages;
+	auto region = pages.MakeRegion();
+
+	constexpr int kThreads = 4;
+	constexpr int kChunksPerThread = 64;
+	std::vector<std::vector<FrameRegion<FakePage>::Chunk>> chunks(kThreads);
+	std::vector<std::thread> threads;
+	for (int thread = 0; thread < kThreads; thread++)
+	{
+		threads.emplace_back([&, thread]()
+		{
+			for (int idx = 0; idx < kChunksPerThread; idx++)
+				chunks[thread].push_back(region.TakeChunk(64));
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+
+	// Every 64 byte slot of the region and the pages is handed out once
+	std::vector<std::pair<const FakePage*, uint64_t>> slots;
+	for (auto& thread_chunks : chunks)
+		for (auto& chunk : thread_chunks)
+			slots.emplace_back(chunk.page, chunk.offset);
+	std::sort(slots.begin(), slots.end());
+	EXPECT_EQ(std::adjacent_find(slots.begin(), slots.end()), slots.end());
+	EXPECT_EQ(region.GetUsedBytes(), kThreads * kChunksPerThread * 64u);
+}
@@ -0,0 +1,137 @@
+#include "Resource/HeapSuballocator.h"
+#include <gtest/gtest.h>
+
+using namespace FrameDX12;
+
+namespace
+{
+	constexpr uint64_t kSmallAlignment = 4 * 1024;
+	constexpr uint64_t kBufferAlignment = 64 * 1024;
+	constexpr uint64_t kBlockSize = 1024 * 1024;
+
+	// Counts the blocks, as the device creating and releasing heaps would
+	struct FakeHeaps
+	{
+		uint32_t created = 0;
+		uint32_t released = 0;
+		uint32_t max_blocks = ~0u;
+
+		HeapSuballocator MakeAllocator(uint64_t min_allocation)
+		{
+			return HeapSuballocator(kBlockSize, min_allocation,
+				[this](uint32_t block_idx) { if (block_idx >= max_blocks) return false; ++created; return true; },
+				[this](uint32_t) { ++released; });
+		}
+	};
+}
+
+TEST(BuddyAllocator, RoundsUpToPowersOfTwo)
+{
+	BuddyAllocator buddy(kBlockSize, kSmallAlignment);
+
+	uint64_t allocated_size;
+	uint64_t offset = buddy.Allocate(5000, kSmallAlignment, &allocated_size);
+	EXPECT_EQ(offset, 0u);
+	EXPECT_EQ(allocated_size, 8192u);
+	EXPECT_EQ(buddy.GetAllocatedSize(), 8192u);
+}
+
+TEST(BuddyAllocator, AlignsToTheRequestedAlignment)
+{
+	BuddyAllocator buddy(kBlockSize, kSmallAlignment);
+
+	buddy.Allocate(kSmallAlignment, kSmallAlignment);
+	uint64_t offset = buddy.Allocate(kSmallAlignment, kBufferAlignment);
+	EXPECT_EQ(offset % kBufferAlignment, 0u);
+	EXPECT_NE(offset, 0u);
+}
+
+TEST(BuddyAllocator, MergesBuddiesOnFree)
+{
+	BuddyAllocator buddy(kBlockSize, kSmallAlignment);
+
+	uint64_t first = buddy.Allocate(kSmallAlignment, kSmallAlignment);
+	uint64_t second = buddy.Allocate(kSmallAlignment, kSmallAlignment);
+	EXPECT_LT(buddy.GetLargestFreeBlock(), kBlockSize);
+
+	buddy.Free(first);
+	buddy.Free(second);
+	EXPECT_TRUE(buddy.IsEmpty());
+	EXPECT_EQ(buddy.GetLargestFreeBlock(), kBlockSize);
+	EXPECT_EQ(buddy.Allocate(kBlockSize, kSmallAlignment), 0u);
+}
+
+TEST(BuddyAllocator, FailsWhenFull)
+{
+	BuddyAllocator buddy(kBlockSize, kSmallAlignment);
+
+	EXPECT_EQ(buddy.Allocate(kBlockSize / 2, kSmallAlignment), 0u);
+	EXPECT_EQ(buddy.Allocate(kBlockSize / 2, kSmallAlignment), kBlockSize / 2);
+	EXPECT_EQ(buddy.Allocate(kSmallAlignment, kSmallAlignment), BuddyAllocator::kInvalidOffset);
+	EXPECT_EQ(buddy.Allocate(kBlockSize * 2, kSmallAlignment), BuddyAllocator::kInvalidOffset);
+}
+
+// Small textures pack at 4KB, while a buffer takes a whole 64KB slot
+TEST(HeapSuballocator, SmallAlignmentPacksTighter)
+{
+	FakeHeaps heaps;
+	HeapSuballocator textures = heaps.MakeAllocator(kSmallAlignment);
+
+	for (int i = 0; i < 16; i++)
+		EXPECT_TRUE(textures.Allocate(kSmallAlignment, kSmallAlignment).IsValid());
+	EXPECT_EQ(textures.GetStats().allocated_bytes, 16 * kSmallAlignment);
+
+	HeapSuballocator buffers = heaps.MakeAllocator(kBufferAlignment);
+	auto buffer = buffers.Allocate(256, kBufferAlignment);
+	EXPECT_EQ(buffer.allocated_size, kBufferAlignment);
+	EXPECT_EQ(buffers.GetStats().GetInternalWaste(), kBufferAlignment - 256);
+}
+
+TEST(HeapSuballocator, GrowsAndReusesBlocks)
+{
+	FakeHeaps heaps;
+	HeapSuballocator allocator = heaps.MakeAllocator(kSmallAlignment);
+
+	auto first = allocator.Allocate(kBlockSize, kSmallAlignment);
+	auto second = allocator.Allocate(kBlockSize, kSmallAlignment);
+	EXPECT_EQ(first.block, 0u);
+	EXPECT_EQ(second.block, 1u);
+	EXPECT_EQ(heaps.created, 2u);
+
+	allocator.Free(first);
+	auto third = allocator.Allocate(kSmallAlignment, kSmallAlignment);
+	EXPECT_EQ(third.block, 0u);
+	EXPECT_EQ(heaps.created, 2u);
+}
+
+TEST(HeapSuballocator, TrimReleasesEmptyBlocksOnly)
+{
+	FakeHeaps heaps;
+	HeapSuballocator allocator = heaps.MakeAllocator(kSmallAlignment);
+
+	auto first = allocator.Allocate(kBlockSize, kSmallAlignment);
+	auto second = allocator.Allocate(kBlockSize, kSmallAlignment);
+	allocator.Free(first);
+	allocator.Trim();
+
+	EXPECT_EQ(heaps.released, 1u);
+	EXPECT_EQ(allocator.GetStats().blocks_count, 1u);
+
+	// The index of the released block is reused
+	auto third = allocator.Allocate(kBlockSize, kSmallAlignment);
+	EXPECT_EQ(third.block, 0u);
+	allocator.Free(second);
+	allocator.Free(third);
+}
+
+TEST(HeapSuballocator, FailsWhenBlocksCantBeCreated)
+{
+	FakeHeaps heaps;
+	heaps.max_blocks = 1;
+	HeapSuballocator allocator = heaps.MakeAllocator(kSmallAlignment);
+
+	EXPECT_TRUE(allocator.Allocate(kBlockSize, kSmallAlignment).IsValid());
+	EXPECT_FALSE(allocator.Allocate(kSmallAlignment, kSmallAlignment).IsValid());
+	EXPECT_FALSE(allocator.Allocate(kBlockSize * 2, kSmallAlignment).IsValid());
+	EXPECT_EQ(allocator.GetStats().failed_allocations, 2u);
+}
@@ -0,0 +1,63 @@
+#include "Resource/IndirectArgs.h"
+#include <gtest/gtest.h>
+
+using namespace FrameDX12;
+
+namespace
+{
+	IndirectDrawItem MakeItem(uint32_t bucket, uint32_t draw_id)
+	{
+		IndirectDrawItem item = {};
+		item.bucket = bucket;
+		item.draw_id = draw_id;
+		item.index_count = 3;
+		item.instance_count = 1;
+		return item;
+	}
+}
+
+TEST(IndirectArgs, GroupsByBucketKeepingTheOrder)
+{
+	// Enough draws for several chunks
+	const size_t count = kIndirectArgsChunkSize * 3 + 17;
+	const uint32_t bucket_count = 5;
+
+	std::vector<IndirectDrawArgs> args(count);
+	std::vector<uint32_t> offsets(bucket_count + 1);
+	size_t written = BuildIndirectArgs(count, bucket_count, [](size_t idx) { return MakeItem((idx * 7) % bucket_count, (uint32_t)idx); },
+									   args.data(), offsets.data());
+
+	ASSERT_EQ(written, count);
+	EXPECT_EQ(offsets[0], 0u);
+	EXPECT_EQ(offsets[bucket_count], count);
+	for (uint32_t bucket = 0; bucket < bucket_count; bucket++)
+	{
+		for (uint32_t idx = offsets[bucket]; idx < offsets[bucket + 1]; idx++)
+		{
+			EXPECT_EQ((args[idx].draw_id * 7) % bucket_count, bucket);
+			if (idx > offsets[bucket])
+				EXPECT_LT(args[idx - 1].draw_id, args[idx].draw_id);
+		}
+	}
+}
+
+TEST(IndirectArgs, SkipsBucketsOutOfRange)
+{
+	const size_t count = 100;
+	const uint32_t bucket_count = 2;
+
+	// Sentinel past the written range, to catch writes out of bounds
+	std::vector<IndirectDrawArgs> args(count + 1);
+	args[count].draw_id = 0xdeadbeef;
+	std::vector<uint32_t> offsets(bucket_count + 2, 0xdeadbeef);
+
+	size_t written = BuildIndirectArgs(count, bucket_count, [](size_t idx) { return MakeItem(idx % 4 == 0 ? 7 : (uint32_t)idx % 2, (uint32_t)idx); },
+									   args.data(), offsets.data());
+
+	EXPECT_EQ(written, 75u);
+	EXPECT_EQ(offsets[bucket_count], 75u);
+	EXPECT_EQ(offsets[bucket_count + 1], 0xdeadbeef);
+	EXPECT_EQ(args[count].draw_id, 0xdeadbeef);
+	for (size_t idx = 0; idx < written; idx++)
+		EXPECT_NE(args[idx].draw_id % 4, 0u);
+}
@@ -0,0 +1,71 @@
+#include "Resource/InstanceMatrices.h"
+#include "Core/StreamingCopy.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace FrameDX12;
+
+// The frame update of InstanceTransforms : chunks of 4096 instances, each computed a page of 32 instances at a time on a cached
+//  scratch page that is streamed to the destination, as StructuredBuffer::Generate does on buffers rewritten every frame
+// Single threaded. On the graph the chunks are repeats of the update node, so the time is split between the workers
+namespace
+{
+	constexpr size_t kChunkSize = 4096;
+	constexpr size_t kPageInstances = 32;
+	constexpr size_t kFloatsPerInstance = 32;
+
+	struct Instances
+	{
+		std::vector<float> streams[kInstanceStreamCount];
+		std::vector<float> matrices;
+		float view_projection[4][4] = {};
+
+		Instances(size_t count) : matrices(count * kFloatsPerInstance)
+		{
+			std::mt19937 random(42);
+			std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+			for (auto& stream : streams)
+			{
+				stream.resize((count + 3) / 4 * 4);
+				for (float& element : stream)
+					element = value(random);
+			}
+			for (int row = 0; row < 4; row++)
+				for (int column = 0; column < 4; column++)
+					view_projection[row][column] = value(random);
+		}
+	};
+
+	void BM_InstanceMatrices(benchmark::State& state)
+	{
+		size_t count = state.range(0);
+		Instances instances(count);
+
+		std::vector<float> scratch(kPageInstances * kFloatsPerInstance);
+		for (auto _ : state)
+		{
+			const float* streams[kInstanceStreamCount];
+			for (int stream = 0; stream < kInstanceStreamCount; stream++)
+				streams[stream] = instances.streams[stream].data();
+
+			size_t chunks = (count + kChunkSize - 1) / kChunkSize;
+			for (size_t chunk = 0; chunk < chunks; chunk++)
+			{
+				size_t chunk_end = std::min(count, (chunk + 1) * kChunkSize);
+				for (size_t page = chunk * kChunkSize; page < chunk_end; page += kPageInstances)
+				{
+					size_t page_count = std::min(kPageInstances, chunk_end - page);
+					ComputeInstanceMatrices(streams, page, page_count, instances.view_projection, scratch.data());
+					StreamingCopyNoFence(instances.matrices.data() + page * kFloatsPerInstance, scratch.data(), page_count * kFloatsPerInstance * sizeof(float));
+				}
+				StreamingFence();
+			}
+		}
+
+		state.SetItemsProcessed(state.iterations() * count);
+	}
+}
+
+BENCHMARK(BM_InstanceMatrices)->Arg(64 << 10)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
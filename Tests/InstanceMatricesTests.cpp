@@ -0,0 +1,130 @@
+#include "Resource/InstanceMatrices.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+using namespace FrameDX12;
+
+namespace
+{
+	constexpr size_t kFloatsPerInstance = 32;
+
+	struct Instances
+	{
+		std::vector<float> streams[kInstanceStreamCount];
+
+		Instances(size_t count)
+		{
+			size_t padded = (count + 3) / 4 * 4;
+			for (int stream = 0; stream < kInstanceStreamCount; stream++)
+			{
+				bool is_one = stream == 6 || stream >= 7; // Rotation w and scale
+				streams[stream].assign(padded, is_one ? 1.0f : 0.0f);
+			}
+		}
+
+		void Set(size_t index, const float position[3], const float rotation[4], const float scale[3])
+		{
+			for (int idx = 0; idx < 3; idx++) streams[idx][index] = position[idx];
+			for (int idx = 0; idx < 4; idx++) streams[3 + idx][index] = rotation[idx];
+			for (int idx = 0; idx < 3; idx++) streams[7 + idx][index] = scale[idx];
+		}
+
+		void Compute(size_t first, size_t count, const float view_projection[4][4], float* matrices) const
+		{
+			const float* pointers[kInstanceStreamCount];
+			for (int stream = 0; stream < kInstanceStreamCount; stream++)
+				pointers[stream] = streams[stream].data();
+			ComputeInstanceMatrices(pointers, first, count, view_projection, matrices);
+		}
+	};
+
+	constexpr float kIdentity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+
+	// Row c of a transposed matrix is column c of the original, so this is the row vector (point, 1) times the original
+	void Transform(const float* transposed, const float point[3], float result[4])
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			const float* row = transposed + column * 4;
+			result[column] = row[0] * point[0] + row[1] * point[1] + row[2] * point[2] + row[3];
+		}
+	}
+}
+
+TEST(InstanceMatrices, ScalesRotatesThenTranslates)
+{
+	Instances instances(1);
+	float half_sqrt2 = std::sqrt(0.5f);
+	const float position[3] = { 10, 20, 30 };
+	const float rotation[4] = { 0, 0, half_sqrt2, half_sqrt2 }; // 90 degrees around Z
+	const float scale[3] = { 2, 3, 4 };
+	instances.Set(0, position, rotation, scale);
+
+	std::vector<float> matrices(kFloatsPerInstance);
+	instances.Compute(0, 1, kIdentity, matrices.data());
+
+	// X goes to Y after the rotation
+	const float point[3] = { 1, 0, 0 };
+	float result[4];
+	Transform(matrices.data(), point, result);
+	EXPECT_NEAR(result[0], 10, 1e-5f);
+	EXPECT_NEAR(result[1], 22, 1e-5f);
+	EXPECT_NEAR(result[2], 30, 1e-5f);
+	EXPECT_NEAR(result[3], 1, 1e-5f);
+
+	// With an identity view projection both matrices are the same
+	for (size_t idx = 0; idx < 16; idx++)
+		EXPECT_NEAR(matrices[idx], matrices[16 + idx], 1e-5f);
+}
+
+TEST(InstanceMatrices, WVPIsWorldTimesViewProjection)
+{
+	Instances instances(4);
+	const float position[3] = { 1, -2, 3 };
+	const float rotation[4] = { 0.5f, 0.5f, 0.5f, 0.5f };
+	const float scale[3] = { 1, 2, 0.5f };
+	instances.Set(2, position, rotation, scale);
+
+	float view_projection[4][4];
+	for (int row = 0; row < 4; row++)
+		for (int column = 0; column < 4; column++)
+			view_projection[row][column] = float(row * 4 + column) * 0.25f - 1.0f;
+
+	std::vector<float> matrices(4 * kFloatsPerInstance);
+	instances.Compute(0, 4, view_projection, matrices.data());
+
+	const float* world = matrices.data() + 2 * kFloatsPerInstance;
+	const float* wvp = world + 16;
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			float expected = 0;
+			for (int k = 0; k < 4; k++)
+				expected += world[k * 4 + row] * view_projection[k][column];
+			EXPECT_NEAR(wvp[column * 4 + row], expected, 1e-4f);
+		}
+	}
+}
+
+TEST(InstanceMatrices, WritesOnlyTheRequestedInstances)
+{
+	Instances instances(12);
+	for (size_t idx = 0; idx < 12; idx++)
+	{
+		const float position[3] = { float(idx), 0, 0 };
+		const float rotation[4] = { 0, 0, 0, 1 };
+		const float scale[3] = { 1, 1, 1 };
+		instances.Set(idx, position, rotation, scale);
+	}
+
+	// Starting at 4 and ending in the middle of a group of 4
+	std::vector<float> matrices(6 * kFloatsPerInstance, -7.0f);
+	instances.Compute(4, 5, kIdentity, matrices.data());
+
+	for (size_t instance = 0; instance < 5; instance++)
+		EXPECT_EQ(matrices[instance * kFloatsPerInstance + 3], float(4 + instance)); // Translation x
+	for (size_t idx = 5 * kFloatsPerInstance; idx < matrices.size(); idx++)
+		EXPECT_EQ(matrices[idx], -7.0f);
+}
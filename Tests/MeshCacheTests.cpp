@@ -0,0 +1,160 @@
+#include "Resource/MeshCache.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+using namespace FrameDX12;
+
+namespace
+{
+	struct TestMesh
+	{
+		std::vector<float> vertices; // 3 floats per vertex
+		std::vector<uint32_t> indices;
+		float center[3] = { 1, 2, 3 };
+		float extents[3] = { 4, 5, 6 };
+
+		explicit TestMesh(uint32_t vertex_count, float seed = 0.0f)
+		{
+			for (uint32_t idx = 0; idx < vertex_count * 3; idx++)
+				vertices.push_back(seed + idx);
+			for (uint32_t idx = 0; idx < vertex_count; idx++)
+				indices.push_back(vertex_count - 1 - idx);
+		}
+
+		bool Write(const std::string& path, const MeshCacheKey& key) const
+		{
+			return MeshCacheFile::Write(path, key, vertices.data(), vertices.size() / 3, indices.data(), indices.size(), center, extents);
+		}
+	};
+
+	class MeshCache : public testing::Test
+	{
+	protected:
+		void SetUp() override
+		{
+			mDirectory = std::filesystem::temp_directory_path() / ("FrameDX12MeshCacheTest" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())));
+			std::filesystem::remove_all(mDirectory);
+			std::filesystem::create_directories(mDirectory);
+			mPath = (mDirectory / "mesh.obj.Default.meshcache").string();
+		}
+
+		void TearDown() override
+		{
+			std::filesystem::remove_all(mDirectory);
+		}
+
+		size_t CountFiles() const
+		{
+			return std::distance(std::filesystem::directory_iterator(mDirectory), std::filesystem::directory_iterator());
+		}
+
+		std::filesystem::path mDirectory;
+		std::string mPath;
+		MeshCacheKey mKey = { 0x1234, "Default", 12, 0xABCD, 7 };
+	};
+}
+
+TEST_F(MeshCache, ReadsWhatWasWritten)
+{
+	TestMesh mesh(100);
+	ASSERT_TRUE(mesh.Write(mPath, mKey));
+	EXPECT_EQ(CountFiles(), 1u); // No temporary file left
+
+	MeshCacheFile cache;
+	ASSERT_TRUE(cache.Open(mPath, mKey));
+	ASSERT_EQ(cache.GetVertexCount(), 100u);
+	ASSERT_EQ(cache.GetIndexCount(), 100u);
+	EXPECT_EQ(memcmp(cache.GetVertexData(), mesh.vertices.data(), mesh.vertices.size() * sizeof(float)), 0);
+	EXPECT_EQ(memcmp(cache.GetIndexData(), mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t)), 0);
+	EXPECT_EQ(cache.GetBoundsCenter()[2], 3.0f);
+	EXPECT_EQ(cache.GetBoundsExtents()[0], 4.0f);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(cache.GetVertexData()) % 16, 0u);
+}
+
+TEST_F(MeshCache, RejectsAnyKeyMismatch)
+{
+	TestMesh mesh(10);
+	ASSERT_TRUE(mesh.Write(mPath, mKey));
+
+	std::vector<MeshCacheKey> keys(5, mKey);
+	keys[0].source_hash++;
+	keys[1].layout_name = "Other";
+	keys[2].vertex_size = 16;
+	keys[3].layout_hash++; // Same name and size, different elements
+	keys[4].options_hash++;
+
+	for (const MeshCacheKey& key : keys)
+	{
+		MeshCacheFile cache;
+		EXPECT_FALSE(cache.Open(mPath, key));
+	}
+
+	MeshCacheFile cache;
+	EXPECT_FALSE(cache.Open(mPath + ".missing", mKey));
+}
+
+TEST_F(MeshCache, RejectsTruncatedFiles)
+{
+	TestMesh mesh(1000);
+	ASSERT_TRUE(mesh.Write(mPath, mKey));
+	std::filesystem::resize_file(mPath, std::filesystem::file_size(mPath) - 4);
+
+	MeshCacheFile cache;
+	EXPECT_FALSE(cache.Open(mPath, mKey));
+
+	std::filesystem::resize_file(mPath, 8);
+	EXPECT_FALSE(cache.Open(mPath, mKey));
+}
+
+TEST_F(MeshCache, MappingOutlivesMovesAndRewrites)
+{
+	TestMesh mesh(50);
+	ASSERT_TRUE(mesh.Write(mPath, mKey));
+
+	MeshCacheFile opened;
+	ASSERT_TRUE(opened.Open(mPath, mKey));
+	const void* vertex_data = opened.GetVertexData();
+
+	// Like a Mesh being moved, the data stays where it was
+	MeshCacheFile moved = std::move(opened);
+	EXPECT_EQ(moved.GetVertexData(), vertex_data);
+
+	// A new cache replaces the file, the mapping keeps the old contents
+	TestMesh other(50, 1000.0f);
+	MeshCacheKey other_key = mKey;
+	other_key.source_hash++;
+	if (other.Write(mPath, other_key)) // Can fail on systems that don't allow replacing mapped files, the old cache is kept then
+	{
+		MeshCacheFile reopened;
+		EXPECT_TRUE(reopened.Open(mPath, other_key));
+	}
+	EXPECT_EQ(memcmp(moved.GetVertexData(), mesh.vertices.data(), mesh.vertices.size() * sizeof(float)), 0);
+}
+
+TEST_F(MeshCache, ConcurrentWritesLeaveAValidCache)
+{
+	constexpr int kWriters = 8;
+	std::vector<TestMesh> meshes;
+	for (int writer = 0; writer < kWriters; writer++)
+		meshes.emplace_back(20000, writer * 1e6f);
+
+	std::vector<std::thread> threads;
+	for (int writer = 0; writer < kWriters; writer++)
+		threads.emplace_back([&, writer]() { meshes[writer].Write(mPath, mKey); });
+	for (std::thread& thread : threads)
+		thread.join();
+
+	EXPECT_EQ(CountFiles(), 1u);
+
+	// Whole contents of one of them, never a mix
+	MeshCacheFile cache;
+	ASSERT_TRUE(cache.Open(mPath, mKey));
+	const float* vertices = static_cast<const float*>(cache.GetVertexData());
+	int writer = int(vertices[0] / 1e6f);
+	ASSERT_GE(writer, 0);
+	ASSERT_LT(writer, kWriters);
+	EXPECT_EQ(memcmp(vertices, meshes[writer].vertices.data(), meshes[writer].vertices.size() * sizeof(float)), 0);
+}
@@ -0,0 +1,113 @@
+#include "Resource/MeshOptimizer.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <random>
+
+using namespace FrameDX12;
+
+namespace
+{
+	struct Grid
+	{
+		std::vector<uint32_t> indices;
+		std::vector<float> positions;
+		uint32_t vertex_count;
+	};
+
+	// A flat grid of size x size quads, with the triangles shuffled like a badly exported mesh
+	Grid MakeShuffledGrid(uint32_t size)
+	{
+		Grid grid;
+		uint32_t side = size + 1;
+		grid.vertex_count = side * side;
+		for (uint32_t y = 0; y < side; y++)
+			for (uint32_t x = 0; x < side; x++)
+				grid.positions.insert(grid.positions.end(), { float(x), float(y), 0.0f });
+
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				uint32_t corner = y * side + x;
+				triangles.push_back({ corner, corner + 1, corner + side });
+				triangles.push_back({ corner + 1, corner + side + 1, corner + side });
+			}
+		}
+
+		std::mt19937 random(7);
+		std::shuffle(triangles.begin(), triangles.end(), random);
+		for (const auto& triangle : triangles)
+			grid.indices.insert(grid.indices.end(), triangle.begin(), triangle.end());
+		return grid;
+	}
+
+	// Each triangle rotated so its smallest index goes first, which keeps the winding, then sorted
+	std::vector<std::array<uint32_t, 3>> CanonicalTriangles(const std::vector<uint32_t>& indices)
+	{
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (size_t idx = 0; idx < indices.size(); idx += 3)
+		{
+			std::array<uint32_t, 3> triangle = { indices[idx], indices[idx + 1], indices[idx + 2] };
+			std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+			triangles.push_back(triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+}
+
+TEST(MeshOptimizer, StatsOfKnownOrders)
+{
+	// Every vertex is a miss once, the second triangle reuses 2 of them
+	VertexCacheStats stats = ComputeVertexCacheStats({ 0, 1, 2, 2, 1, 3 }, 4);
+	EXPECT_EQ(stats.transformed_vertices, 4u);
+	EXPECT_FLOAT_EQ(stats.acmr, 2.0f);
+	EXPECT_FLOAT_EQ(stats.atvr, 1.0f);
+
+	// A cache of 3 can't keep vertex 0 around for the last triangle
+	stats = ComputeVertexCacheStats({ 0, 1, 2, 3, 4, 5, 0, 1, 2 }, 6, 3);
+	EXPECT_EQ(stats.transformed_vertices, 9u);
+	EXPECT_FLOAT_EQ(stats.acmr, 3.0f);
+	EXPECT_FLOAT_EQ(stats.atvr, 1.5f);
+}
+
+TEST(MeshOptimizer, VertexCacheOrderLowersTheACMR)
+{
+	Grid grid = MakeShuffledGrid(64);
+	auto triangles = CanonicalTriangles(grid.indices);
+
+	VertexCacheStats before = ComputeVertexCacheStats(grid.indices, grid.vertex_count);
+	OptimizeVertexCache(grid.indices, grid.vertex_count);
+	VertexCacheStats after = ComputeVertexCacheStats(grid.indices, grid.vertex_count);
+
+	// A shuffled grid misses almost every vertex, a good order on a regular grid gets under 0.8
+	EXPECT_GT(before.acmr, 2.0f);
+	EXPECT_LT(after.acmr, 0.8f);
+	EXPECT_LT(after.atvr, 1.6f);
+	EXPECT_EQ(CanonicalTriangles(grid.indices), triangles);
+}
+
+TEST(MeshOptimizer, OverdrawOrderStaysUnderTheThreshold)
+{
+	Grid grid = MakeShuffledGrid(32);
+	auto triangles = CanonicalTriangles(grid.indices);
+	OptimizeVertexCache(grid.indices, grid.vertex_count);
+	float acmr = ComputeVertexCacheStats(grid.indices, grid.vertex_count).acmr;
+
+	OptimizeOverdraw(grid.indices, grid.positions, 1.05f);
+
+	EXPECT_LE(ComputeVertexCacheStats(grid.indices, grid.vertex_count).acmr, acmr * 1.05f + 1e-5f);
+	EXPECT_EQ(CanonicalTriangles(grid.indices), triangles);
+}
+
+TEST(MeshOptimizer, FetchOrderFollowsTheFirstUse)
+{
+	// Vertex 4 is never used
+	std::vector<uint32_t> indices = { 3, 1, 0, 0, 1, 5, 2, 3, 5 };
+	std::vector<uint32_t> remap = OptimizeVertexFetch(indices, 6);
+
+	EXPECT_EQ(indices, (std::vector<uint32_t>{ 0, 1, 2, 2, 1, 3, 4, 0, 3 }));
+	EXPECT_EQ(remap, (std::vector<uint32_t>{ 2, 1, 4, 0, 5, 3 }));
+}
@@ -0,0 +1,72 @@
+#include "Resource/OBJParser.h"
+#include "OBJTestData.h"
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#ifdef FRAMEDX12_HAS_TINYOBJ
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+#endif
+
+using namespace FrameDX12;
+
+// Parsing of a generated OBJ of about 106MB from a file, like Mesh::LoadOBJ does
+// The first run of each one also pays for reading the file from disk, the rest find it on the OS cache
+// tinyobj, the parser ParseOBJ replaced, is only measured if the build finds tiny_obj_loader.h (set TINYOBJLOADER_INCLUDE_DIR)
+namespace
+{
+	const std::string& GetFile()
+	{
+		static std::string path = []()
+		{
+			std::filesystem::path file_path = std::filesystem::temp_directory_path() / "FrameDX12OBJParserBenchmark.obj";
+			std::ofstream file(file_path, std::ios::binary);
+			std::string text = GenerateGridOBJ(950, true);
+			file.write(text.data(), text.size());
+			return file_path.string();
+		}();
+		return path;
+	}
+
+	void BM_ParseOBJ(benchmark::State& state)
+	{
+		const std::string& path = GetFile();
+		uint32_t thread_count = state.range(0) ? (uint32_t)state.range(0) : std::max(1u, std::thread::hardware_concurrency());
+		size_t size = std::filesystem::file_size(path);
+
+		for (auto _ : state)
+		{
+			OBJData data;
+			std::string error;
+			if (!ParseOBJ(path, data, error, thread_count))
+				state.SkipWithError(error.c_str());
+			benchmark::DoNotOptimize(data.corners.data());
+		}
+		state.SetBytesProcessed(state.iterations() * size);
+	}
+
+#ifdef FRAMEDX12_HAS_TINYOBJ
+	void BM_TinyOBJ(benchmark::State& state)
+	{
+		const std::string& path = GetFile();
+		size_t size = std::filesystem::file_size(path);
+
+		for (auto _ : state)
+		{
+			tinyobj::attrib_t attrib;
+			std::vector<tinyobj::shape_t> shapes;
+			std::vector<tinyobj::material_t> materials;
+			std::string warning, error;
+			if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warning, &error, path.c_str()))
+				state.SkipWithError(error.c_str());
+			benchmark::DoNotOptimize(shapes.data());
+		}
+		state.SetBytesProcessed(state.iterations() * size);
+	}
+	BENCHMARK(BM_TinyOBJ)->Unit(benchmark::kMillisecond)->Iterations(3);
+#endif
+}
+
+// 0 is all the cores
+BENCHMARK(BM_ParseOBJ)->Arg(1)->Arg(0)->Unit(benchmark::kMillisecond)->Iterations(3);
@@ -0,0 +1,172 @@
+#include "Resource/OBJParser.h"
+#include "OBJTestData.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+
+using namespace FrameDX12;
+
+namespace
+{
+	bool Parse(const std::string& text, OBJData& data, uint32_t thread_count = 1)
+	{
+		std::string error;
+		bool parsed = ParseOBJ(text.data(), text.size(), data, error, thread_count);
+		EXPECT_EQ(parsed, error.empty()) << error;
+		return parsed;
+	}
+
+	std::vector<uint32_t> Positions(const OBJData& data)
+	{
+		std::vector<uint32_t> positions;
+		for (const OBJData::Corner& corner : data.corners)
+			positions.push_back(corner.position);
+		return positions;
+	}
+
+	void ExpectSameData(const OBJData& a, const OBJData& b)
+	{
+		EXPECT_EQ(a.positions, b.positions);
+		EXPECT_EQ(a.normals, b.normals);
+		EXPECT_EQ(a.texcoords, b.texcoords);
+		ASSERT_EQ(a.corners.size(), b.corners.size());
+		EXPECT_EQ(memcmp(a.corners.data(), b.corners.data(), a.corners.size() * sizeof(OBJData::Corner)), 0);
+	}
+}
+
+TEST(OBJParser, ParsesAttributesAndTriangulatesFans)
+{
+	OBJData data;
+	ASSERT_TRUE(Parse(
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 -1.5e1\n"
+		"vn 0 0 1\n"
+		"vt 0.5 0.25\nvt 1\n"
+		"f 1/1/1 2/2/1 3/1/1 4/2/1\n", data));
+
+	EXPECT_EQ(data.positions.size(), 12u);
+	EXPECT_FLOAT_EQ(data.positions[11], -15.0f);
+	EXPECT_EQ(data.normals, (std::vector<float>{ 0, 0, 1 }));
+	EXPECT_EQ(data.texcoords, (std::vector<float>{ 0.5f, 0.25f, 1, 0 })); // The missing v is 0
+
+	ASSERT_EQ(data.GetTriangleCount(), 2u);
+	EXPECT_EQ(Positions(data), (std::vector<uint32_t>{ 0, 1, 2, 0, 2, 3 }));
+	EXPECT_EQ(data.corners[1].texcoord, 1u);
+	EXPECT_EQ(data.corners[1].normal, 0u);
+}
+
+TEST(OBJParser, MissingAttributes)
+{
+	OBJData data;
+	ASSERT_TRUE(Parse("v 0 0 0\nv 1 0 0\nv 1 1 0\nvn 0 0 1\nf 1//1 2//1 3//1\nf 1 2 3\n", data));
+
+	ASSERT_EQ(data.GetTriangleCount(), 2u);
+	EXPECT_EQ(data.corners[0].texcoord, OBJData::kMissing);
+	EXPECT_EQ(data.corners[0].normal, 0u);
+	EXPECT_EQ(data.corners[3].normal, OBJData::kMissing);
+	EXPECT_EQ(data.corners[3].texcoord, OBJData::kMissing);
+}
+
+TEST(OBJParser, RelativeIndices)
+{
+	OBJData data;
+	ASSERT_TRUE(Parse(
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\n"
+		"vt 0 0\nvt 1 1\n"
+		"f -3/-2 -2/-1 -1/-1\n"
+		"v 0 1 0\n"
+		"f 1 -2 -1\n", data));
+
+	EXPECT_EQ(Positions(data), (std::vector<uint32_t>{ 0, 1, 2, 0, 2, 3 }));
+	EXPECT_EQ(data.corners[0].texcoord, 0u);
+	EXPECT_EQ(data.corners[1].texcoord, 1u);
+}
+
+TEST(OBJParser, CRLFCommentsAndOtherStatements)
+{
+	OBJData data;
+	ASSERT_TRUE(Parse(
+		"# Exported\r\n"
+		"mtllib scene.mtl\r\n"
+		"o object\r\n"
+		"g group\r\n"
+		"  v 0 0 0\r\n"
+		"v 1 0 0 # trailing comment\r\n"
+		"\r\n"
+		"v\t1 1 0\r\n"
+		"vn 0 0 1\r\n"
+		"usemtl material\r\n"
+		"s off\r\n"
+		"l 1 2\r\n"
+		"f 1//1 2//1 3//1 # comment\r\n"
+		"f 3//1 2//1 1//1", data)); // No newline at the end
+
+	EXPECT_EQ(data.positions.size(), 9u);
+	EXPECT_EQ(data.normals.size(), 3u);
+	EXPECT_EQ(Positions(data), (std::vector<uint32_t>{ 0, 1, 2, 2, 1, 0 }));
+}
+
+TEST(OBJParser, RejectsMalformedInput)
+{
+	const char* inputs[] =
+	{
+		"v 1 2\n",                                // Too few coordinates
+		"v 1 x 3\n",                              // Not a number
+		"v 0 0 0\nv 1 0 0\nf 1 2\n",              // Too few corners
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nf 0 1 2\n",   // Index 0
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 4\n",   // Past the end
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1/a 2 3\n", // Invalid texcoord
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nf -4 -2 -1\n", // Relative, past the start
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1//1 2//1 3//1\n", // Normal that doesn't exist
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1//-1 2//-1 3//-1\n", // Relative normal past the start, not a missing one
+	};
+
+	for (const char* input : inputs)
+	{
+		OBJData data;
+		std::string error;
+		EXPECT_FALSE(ParseOBJ(input, strlen(input), data, error, 1)) << input;
+		EXPECT_FALSE(error.empty()) << input;
+		EXPECT_TRUE(data.corners.empty()) << input;
+	}
+}
+
+TEST(OBJParser, MultipleChunksMatchASingleOne)
+{
+	// A few MB, so it's split in several chunks
+	std::string absolute = GenerateGridOBJ(250, false);
+	std::string relative = GenerateGridOBJ(250, true);
+	ASSERT_GT(absolute.size(), 3u * 1024 * 1024);
+
+	OBJData single;
+	ASSERT_TRUE(Parse(absolute, single, 1));
+	EXPECT_EQ(single.GetTriangleCount(), 249u * 249u * 2u);
+
+	for (const std::string* text : { &absolute, &relative })
+	{
+		for (uint32_t thread_count : { 1u, 2u, 3u, 8u })
+		{
+			OBJData data;
+			ASSERT_TRUE(Parse(*text, data, thread_count));
+			ExpectSameData(data, single);
+		}
+	}
+}
+
+TEST(OBJParser, ParsesFiles)
+{
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "FrameDX12OBJParserTest.obj";
+	{
+		std::ofstream file(path, std::ios::binary);
+		file << "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 3\n";
+	}
+
+	OBJData data;
+	std::string error;
+	EXPECT_TRUE(ParseOBJ(path.string(), data, error));
+	EXPECT_EQ(data.GetTriangleCount(), 1u);
+
+	std::filesystem::remove(path);
+	EXPECT_FALSE(ParseOBJ(path.string(), data, error));
+	EXPECT_FALSE(error.empty());
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Generated OBJ files for the parser tests and benchmarks
+namespace FrameDX12
+{
+	// A grid of grid_size x grid_size vertices with positions, normals and UVs, and a quad between each 4 neighbours
+	// The rows of vertices and the faces between them are interleaved, like on files written while walking a mesh, so relative
+	//  indices can be used. With relative_indices the faces use them, and the parsed data is the same as with the absolute ones
+	inline std::string GenerateGridOBJ(uint32_t grid_size, bool relative_indices)
+	{
+		std::string text = "# Generated grid\no grid\n";
+		char line[256];
+
+		auto corner = [&](uint32_t vertex, uint32_t vertex_count)
+		{
+			// 1 based, -1 is the last vertex read so far
+			long long index = relative_indices ? (long long)vertex - vertex_count : (long long)vertex + 1;
+			snprintf(line, sizeof(line), " %lld/%lld/%lld", index, index, index);
+			text += line;
+		};
+
+		for (uint32_t row = 0; row < grid_size; row++)
+		{
+			for (uint32_t column = 0; column < grid_size; column++)
+			{
+				float u = float(column) / grid_size, v = float(row) / grid_size;
+				snprintf(line, sizeof(line), "v %.4f %.4f %.4f\nvn 0 1 0\nvt %.4f %.4f\n", u * 100.0f, u * v, v * 100.0f, u, v);
+				text += line;
+			}
+
+			if (row == 0)
+				continue;
+
+			uint32_t vertex_count = (row + 1) * grid_size;
+			for (uint32_t column = 0; column + 1 < grid_size; column++)
+			{
+				uint32_t top_left = (row - 1) * grid_size + column;
+				uint32_t bottom_left = row * grid_size + column;
+				text += "f";
+				corner(top_left, vertex_count);
+				corner(bottom_left, vertex_count);
+				corner(bottom_left + 1, vertex_count);
+				corner(top_left + 1, vertex_count);
+				text += "\n";
+			}
+		}
+		return text;
+	}
+}
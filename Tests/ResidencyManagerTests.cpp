@@ -0,0 +1,171 @@
+#include "Resource/ResidencyManager.h"
+#include <gtest/gtest.h>
+
+using namespace FrameDX12;
+
+namespace
+{
+	constexpr uint32_t kFramesInFlight = 2;
+	constexpr uint64_t kMB = 1024 * 1024;
+
+	// Records the calls the device would do, and reports the usage the OS would see
+	struct FakeDevice
+	{
+		std::vector<std::vector<void*>> evict_calls;
+		std::vector<std::vector<void*>> make_resident_calls;
+		ResidencyManager::Budget os_budget = { UINT64_MAX, 0 };
+
+		ResidencyManager MakeManager(bool query_budget = false)
+		{
+			std::function<ResidencyManager::Budget()> query;
+			if (query_budget)
+				query = [this]() { return os_budget; };
+
+			return ResidencyManager(kFramesInFlight, query,
+				[this](const std::vector<void*>& pageables) { evict_calls.push_back(pageables); },
+				[this](const std::vector<void*>& pageables) { make_resident_calls.push_back(pageables); });
+		}
+	};
+
+	void* Pageable(uintptr_t id) { return reinterpret_cast<void*>(id); }
+}
+
+TEST(ResidencyManager, EvictsLeastRecentlyUsedOverBudget)
+{
+	FakeDevice device;
+	ResidencyManager manager = device.MakeManager();
+
+	auto* old_object = manager.Register(Pageable(1), 4 * kMB);
+	manager.AdvanceFrame(1);
+	auto* newer_object = manager.Register(Pageable(2), 4 * kMB);
+	manager.AdvanceFrame(10);
+
+	manager.SetBudget(6 * kMB);
+	manager.PrepareSubmit();
+
+	ASSERT_EQ(device.evict_calls.size(), 1u);
+	EXPECT_EQ(device.evict_calls[0], std::vector<void*>{ Pageable(1) });
+	EXPECT_FALSE(old_object->resident);
+	EXPECT_TRUE(newer_object->resident);
+
+	auto stats = manager.GetStats();
+	EXPECT_EQ(stats.resident_bytes, 4 * kMB);
+	EXPECT_EQ(stats.evicted_bytes, 4 * kMB);
+	EXPECT_EQ(stats.evictions, 1u);
+}
+
+TEST(ResidencyManager, KeepsObjectsUsedByFramesInFlight)
+{
+	FakeDevice device;
+	ResidencyManager manager = device.MakeManager();
+
+	auto* object = manager.Register(Pageable(1), 4 * kMB);
+	manager.AdvanceFrame(10);
+	manager.MarkUsed(object);
+	manager.AdvanceFrame(10 + kFramesInFlight);
+
+	manager.SetBudget(kMB);
+	manager.PrepareSubmit();
+
+	EXPECT_TRUE(device.evict_calls.empty());
+	EXPECT_TRUE(object->resident);
+}
+
+TEST(ResidencyManager, RestoresUsedObjectsInOneCall)
+{
+	FakeDevice device;
+	ResidencyManager manager = device.MakeManager();
+
+	auto* a = manager.Register(Pageable(1), kMB);
+	auto* b = manager.Register(Pageable(2), kMB);
+	manager.AdvanceFrame(10);
+	manager.SetBudget(kMB / 2);
+	manager.PrepareSubmit();
+	ASSERT_FALSE(a->resident);
+	ASSERT_FALSE(b->resident);
+
+	manager.SetBudget(0);
+	manager.MarkUsed(a);
+	manager.MarkUsed(b);
+	manager.MarkUsed(a);
+	manager.PrepareSubmit();
+
+	ASSERT_EQ(device.make_resident_calls.size(), 1u);
+	EXPECT_EQ(device.make_resident_calls[0].size(), 2u);
+	EXPECT_TRUE(a->resident);
+	EXPECT_TRUE(b->resident);
+
+	auto stats = manager.GetStats();
+	EXPECT_EQ(stats.resident_bytes, 2 * kMB);
+	EXPECT_EQ(stats.evicted_bytes, 0u);
+	EXPECT_EQ(stats.restores, 2u);
+}
+
+TEST(ResidencyManager, MakesRoomForRestoredObjects)
+{
+	FakeDevice device;
+	ResidencyManager manager = device.MakeManager();
+
+	auto* unused = manager.Register(Pageable(1), 2 * kMB);
+	auto* needed = manager.Register(Pageable(2), 2 * kMB);
+	manager.AdvanceFrame(10);
+	manager.SetBudget(3 * kMB);
+	manager.MarkUsed(unused); // Keeps unused resident this time, so needed is the one evicted
+	manager.PrepareSubmit();
+	ASSERT_FALSE(needed->resident);
+
+	manager.AdvanceFrame(20);
+	manager.MarkUsed(needed);
+	manager.PrepareSubmit();
+
+	// Everything happens on the same submit, evicting first so the budget is never exceeded
+	ASSERT_EQ(device.evict_calls.size(), 2u);
+	EXPECT_EQ(device.evict_calls[1], std::vector<void*>{ Pageable(1) });
+	ASSERT_EQ(device.make_resident_calls.size(), 1u);
+	EXPECT_EQ(device.make_resident_calls[0], std::vector<void*>{ Pageable(2) });
+	EXPECT_FALSE(unused->resident);
+	EXPECT_TRUE(needed->resident);
+}
+
+TEST(ResidencyManager, FollowsTheOSBudget)
+{
+	FakeDevice device;
+	ResidencyManager manager = device.MakeManager(true);
+
+	manager.Register(Pageable(1), 4 * kMB);
+	manager.Register(Pageable(2), 4 * kMB);
+
+	// The usage includes memory the manager doesn't own
+	device.os_budget = { 10 * kMB, 12 * kMB };
+	manager.AdvanceFrame(10);
+	manager.PrepareSubmit();
+
+	ASSERT_EQ(device.evict_calls.size(), 1u);
+	EXPECT_EQ(device.evict_calls[0].size(), 1u);
+	EXPECT_EQ(manager.GetStats().budget_bytes, 10 * kMB);
+
+	// Until the next query, what was evicted counts as freed
+	manager.PrepareSubmit();
+	EXPECT_EQ(device.evict_calls.size(), 1u);
+}
+
+TEST(ResidencyManager, UnregisterDropsPendingRestores)
+{
+	FakeDevice device;
+	ResidencyManager manager = device.MakeManager();
+
+	auto* object = manager.Register(Pageable(1), kMB);
+	manager.AdvanceFrame(10);
+	manager.SetBudget(kMB / 2);
+	manager.PrepareSubmit();
+
+	manager.MarkUsed(object);
+	manager.Unregister(object);
+	manager.PrepareSubmit();
+
+	EXPECT_TRUE(device.make_resident_calls.empty());
+	auto stats = manager.GetStats();
+	EXPECT_EQ(stats.objects_count, 0u);
+	EXPECT_EQ(stats.resident_bytes, 0u);
+	EXPECT_EQ(stats.evicted_bytes, 0u);
+}
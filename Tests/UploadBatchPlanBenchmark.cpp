@@ -0,0 +1,65 @@
+#include "Resource/UploadBatchPlan.h"
+#include "Core/StreamingCopy.h"
+#include <benchmark/benchmark.h>
+#include <random>
+
+using namespace FrameDX12;
+
+// Plans and packs a batch the way UploadBatch::Record does : many small copies to a few buffers added in random order, sorted,
+//  merged into runs and streamed to the staging memory. Only the CPU side, the CopyBufferRegion calls are counted but not recorded
+namespace
+{
+	struct Copy
+	{
+		const void* destination;
+		uint64_t destination_offset;
+		const void* data;
+		uint64_t size_in_bytes;
+	};
+
+	void BM_BuildUploadBatch(benchmark::State& state)
+	{
+		const size_t copies_count = state.range(0);
+		const size_t destinations_count = state.range(1);
+		const uint64_t copy_size = state.range(2);
+
+		// Every destination gets its ranges back to back, with a hole every 8 copies so there's more than one run per buffer
+		std::vector<uint8_t> source(copy_size);
+		std::vector<Copy> added;
+		std::vector<uint64_t> next_offset(destinations_count, 0);
+		std::mt19937 random(42);
+		for (size_t idx = 0; idx < copies_count; idx++)
+		{
+			size_t destination = random() % destinations_count;
+			uint64_t offset = next_offset[destination];
+			next_offset[destination] += copy_size * ((idx % 8 == 7) ? 2 : 1);
+			added.push_back({ reinterpret_cast<const void*>((destination + 1) * 4096), offset, source.data(), copy_size });
+		}
+		std::shuffle(added.begin(), added.end(), random);
+
+		std::vector<uint8_t> staging(copies_count * copy_size);
+		std::vector<Copy> copies;
+		uint32_t runs = 0;
+		for (auto _ : state)
+		{
+			copies = added;
+			SortCopies(copies);
+			runs = ForEachCopyRun(copies, [&](size_t first, size_t end, uint64_t staging_offset, uint64_t)
+			{
+				uint8_t* packed = staging.data() + staging_offset;
+				for (size_t idx = first; idx < end; idx++)
+				{
+					StreamingCopyNoFence(packed, copies[idx].data, copies[idx].size_in_bytes);
+					packed += copies[idx].size_in_bytes;
+				}
+			});
+			StreamingFence();
+			benchmark::DoNotOptimize(staging.data());
+		}
+		state.SetItemsProcessed(state.iterations() * copies_count);
+		state.SetBytesProcessed(state.iterations() * copies_count * copy_size);
+		state.counters["runs"] = runs;
+	}
+}
+
+BENCHMARK(BM_BuildUploadBatch)->ArgsProduct({ { 1000, 100000 }, { 16, 1024 }, { 64, 4096 } })->Unit(benchmark::kMicrosecond)->UseRealTime();
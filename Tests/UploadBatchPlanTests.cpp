@@ -0,0 +1,46 @@
+#include "Resource/UploadBatchPlan.h"
+#include <gtest/gtest.h>
+#include <tuple>
+
+using namespace FrameDX12;
+
+namespace
+{
+	struct Copy
+	{
+		const void* destination;
+		uint64_t destination_offset;
+		uint64_t size_in_bytes;
+	};
+
+	const void* Buffer(uintptr_t id) { return reinterpret_cast<const void*>(id); }
+}
+
+TEST(UploadBatchPlan, MergesContiguousRangesOfTheSameBuffer)
+{
+	std::vector<Copy> copies = {
+		{ Buffer(2), 0, 16 },
+		{ Buffer(1), 32, 16 },
+		{ Buffer(1), 0, 32 },
+		{ Buffer(1), 64, 8 }, // Hole before it
+		{ Buffer(2), 16, 16 },
+	};
+	SortCopies(copies);
+
+	std::vector<std::tuple<size_t, size_t, uint64_t, uint64_t>> runs;
+	uint32_t count = ForEachCopyRun(copies, [&](size_t first, size_t end, uint64_t staging_offset, uint64_t run_size)
+	{
+		runs.emplace_back(first, end, staging_offset, run_size);
+	});
+
+	ASSERT_EQ(count, 3u);
+	EXPECT_EQ(runs[0], std::make_tuple(size_t(0), size_t(2), uint64_t(0), uint64_t(48)));
+	EXPECT_EQ(runs[1], std::make_tuple(size_t(2), size_t(3), uint64_t(48), uint64_t(8)));
+	EXPECT_EQ(runs[2], std::make_tuple(size_t(3), size_t(5), uint64_t(56), uint64_t(32)));
+}
+
+TEST(UploadBatchPlan, EmptyBatchHasNoRuns)
+{
+	std::vector<Copy> copies;
+	EXPECT_EQ(ForEachCopyRun(copies, [](size_t, size_t, uint64_t, uint64_t) { FAIL(); }), 0u);
+}
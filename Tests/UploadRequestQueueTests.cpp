@@ -0,0 +1,88 @@
+#include "Resource/UploadRequestQueue.h"
+#include <gtest/gtest.h>
+
+using namespace FrameDX12;
+
+namespace
+{
+	constexpr int kHigh = 0;
+	constexpr int kNormal = 1;
+	constexpr int kLow = 2;
+}
+
+TEST(UploadRequestQueue, TakesUpToTheBudgetInPriorityOrder)
+{
+	UploadRequestQueue<int> queue;
+	queue.Push(kLow, 10, 1);
+	queue.Push(kNormal, 10, 2);
+	queue.Push(kHigh, 10, 3);
+	queue.Push(kNormal, 10, 4);
+
+	std::vector<int> taken;
+	EXPECT_EQ(queue.Take(25, false, taken), 20u);
+	EXPECT_EQ(taken, (std::vector<int>{ 3, 2 }));
+	EXPECT_EQ(queue.GetCount(), 2u);
+	EXPECT_EQ(queue.GetPendingBytes(), 20u);
+}
+
+TEST(UploadRequestQueue, LowerPrioritiesWaitForTheHigherOnes)
+{
+	UploadRequestQueue<int> queue;
+	queue.Push(kHigh, 10, 1);
+	queue.Push(kHigh, 100, 2);
+	queue.Push(kLow, 1, 3);
+
+	// The low priority one would fit, but the high priority one that doesn't goes first
+	std::vector<int> taken;
+	queue.Take(50, false, taken);
+	EXPECT_EQ(taken, std::vector<int>{ 1 });
+}
+
+TEST(UploadRequestQueue, AlwaysTakesOneRequest)
+{
+	UploadRequestQueue<int> queue;
+	queue.Push(kNormal, 1000, 1);
+	queue.Push(kNormal, 1000, 2);
+
+	std::vector<int> taken;
+	EXPECT_EQ(queue.Take(10, false, taken), 1000u);
+	EXPECT_EQ(taken, std::vector<int>{ 1 });
+
+	taken.clear();
+	EXPECT_EQ(queue.Take(10, true, taken), 1000u);
+	EXPECT_EQ(taken, std::vector<int>{ 2 });
+	EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(UploadRequestQueue, TakeUntilLeavesTheLaterRequests)
+{
+	UploadRequestQueue<int> queue;
+	queue.Push(kHigh, 10, 1);
+	queue.Push(kNormal, 10, 2);
+	queue.Push(kNormal, 10, 3);
+	queue.Push(kNormal, 10, 4);
+	queue.Push(kLow, 10, 5);
+
+	std::vector<int> taken;
+	EXPECT_EQ(queue.TakeUntil([](int request) { return request == 3; }, taken), 30u);
+	EXPECT_EQ(taken, (std::vector<int>{ 1, 2, 3 }));
+	EXPECT_EQ(queue.GetCount(), 2u);
+
+	// The budget doesn't matter
+	taken.clear();
+	queue.TakeUntil([](int request) { return request == 5; }, taken);
+	EXPECT_EQ(taken, (std::vector<int>{ 4, 5 }));
+	EXPECT_TRUE(queue.IsEmpty());
+	EXPECT_EQ(queue.GetPendingBytes(), 0u);
+}
+
+TEST(UploadRequestQueue, TakeUntilWithoutMatchTakesNothing)
+{
+	UploadRequestQueue<int> queue;
+	queue.Push(kHigh, 10, 1);
+
+	std::vector<int> taken;
+	EXPECT_EQ(queue.TakeUntil([](int request) { return request == 7; }, taken), 0u);
+	EXPECT_TRUE(taken.empty());
+	EXPECT_EQ(queue.GetCount(), 1u);
+}
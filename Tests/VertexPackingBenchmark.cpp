@@ -0,0 +1,98 @@
+#include "Resource/VertexPacking.h"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace FrameDX12;
+
+// Conversion of 1M vertices to the default and the quantized layouts. Batch is VertexDesc::AppendVertices, a single loop with the
+//  element writes inlined. PerVertex is VertexDesc::AppendVertex, a call through a std::function per vertex
+namespace
+{
+	constexpr size_t kVertexCount = 1 << 20;
+
+	// Laid out like CPUVertex, which needs DirectXMath
+	struct Vertex
+	{
+		struct { float x, y, z; } position;
+		struct { float x, y, z; } normal;
+		struct { float x, y, z, w; } tangent;
+		struct { float x, y, z; } bitangent;
+		struct { float x, y; } uv;
+	};
+
+	using FloatPacking = VertexPacking<VertexElement<VertexSemantic::Position, VertexFormat::Float3>,
+									   VertexElement<VertexSemantic::Normal  , VertexFormat::Float3>,
+									   VertexElement<VertexSemantic::Tangent , VertexFormat::Float4>,
+									   VertexElement<VertexSemantic::UV      , VertexFormat::Float2>>;
+
+	using QuantizedPacking = VertexPacking<VertexElement<VertexSemantic::PositionBitangentSign, VertexFormat::SNorm16x4>,
+										   VertexElement<VertexSemantic::Normal, VertexFormat::Octahedral16>,
+										   VertexElement<VertexSemantic::Tangent, VertexFormat::Octahedral16>,
+										   VertexElement<VertexSemantic::UV, VertexFormat::Half2>>;
+
+	const std::vector<Vertex>& GetVertices()
+	{
+		static std::vector<Vertex> vertices;
+		if (vertices.empty())
+		{
+			std::mt19937 random(42);
+			std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+			vertices.resize(kVertexCount);
+			for (Vertex& vertex : vertices)
+			{
+				vertex.position = { value(random), value(random), value(random) };
+				float nx = value(random), ny = value(random), nz = value(random);
+				float length = std::sqrt(nx * nx + ny * ny + nz * nz) + 1e-6f;
+				vertex.normal = { nx / length, ny / length, nz / length };
+				// Any unit vector orthogonal to the normal
+				vertex.tangent = { vertex.normal.y, -vertex.normal.x, 0.0f, value(random) };
+				length = std::sqrt(vertex.tangent.x * vertex.tangent.x + vertex.tangent.y * vertex.tangent.y) + 1e-6f;
+				vertex.tangent.x /= length;
+				vertex.tangent.y /= length;
+				vertex.uv = { value(random), value(random) };
+			}
+		}
+		return vertices;
+	}
+
+	template<typename Packing>
+	void BM_Convert(benchmark::State& state)
+	{
+		const std::vector<Vertex>& vertices = GetVertices();
+		std::vector<uint8_t> output(vertices.size() * Packing::kVertexSize);
+
+		bool batch = state.range(0) != 0;
+		std::function<void* (void*, const Vertex&)> append_vertex = [](void* output, const Vertex& vertex) -> void*
+		{
+			Packing::Convert(&vertex, 1, output);
+			return static_cast<uint8_t*>(output) + Packing::kVertexSize;
+		};
+
+		for (auto _ : state)
+		{
+			if (batch)
+			{
+				Packing::Convert(vertices.data(), vertices.size(), output.data());
+			}
+			else
+			{
+				void* write = output.data();
+				for (const Vertex& vertex : vertices)
+					write = append_vertex(write, vertex);
+			}
+			benchmark::DoNotOptimize(output.data());
+			benchmark::ClobberMemory();
+		}
+		state.SetItemsProcessed(state.iterations() * vertices.size());
+		state.SetBytesProcessed(state.iterations() * output.size());
+	}
+
+	void BM_ConvertFloat(benchmark::State& state) { BM_Convert<FloatPacking>(state); }
+	void BM_ConvertQuantized(benchmark::State& state) { BM_Convert<QuantizedPacking>(state); }
+}
+
+BENCHMARK(BM_ConvertFloat)->ArgName("batch")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ConvertQuantized)->ArgName("batch")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
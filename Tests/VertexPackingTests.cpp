@@ -0,0 +1,130 @@
+#include "Resource/VertexPacking.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+using namespace FrameDX12;
+
+namespace
+{
+	// Laid out like CPUVertex, which needs DirectXMath
+	struct Vertex
+	{
+		struct { float x, y, z; } position;
+		struct { float x, y, z; } normal;
+		struct { float x, y, z, w; } tangent;
+		struct { float x, y, z; } bitangent;
+		struct { float x, y; } uv;
+	};
+
+	using FloatPacking = VertexPacking<VertexElement<VertexSemantic::Position, VertexFormat::Float3>,
+									   VertexElement<VertexSemantic::Normal  , VertexFormat::Float3>,
+									   VertexElement<VertexSemantic::Tangent , VertexFormat::Float4>,
+									   VertexElement<VertexSemantic::UV      , VertexFormat::Float2>>;
+
+	// The same as QuantizedVertexLayout<PositionFormat::SNorm16, UVFormat::UNorm16>
+	using QuantizedPacking = VertexPacking<VertexElement<VertexSemantic::PositionBitangentSign, VertexFormat::SNorm16x4>,
+										   VertexElement<VertexSemantic::Normal, VertexFormat::Octahedral16>,
+										   VertexElement<VertexSemantic::Tangent, VertexFormat::Octahedral16>,
+										   VertexElement<VertexSemantic::UV, VertexFormat::UNorm16x2>>;
+
+	Vertex MakeVertex(float bitangent_sign)
+	{
+		Vertex vertex = {};
+		vertex.position = { 0.25f, -0.5f, 0.75f };
+		vertex.normal = { 0.0f, 0.6f, 0.8f };
+		vertex.tangent = { 1.0f, 0.0f, 0.0f, bitangent_sign };
+		vertex.uv = { 0.125f, 0.875f };
+		return vertex;
+	}
+}
+
+TEST(VertexPacking, OffsetsAndSize)
+{
+	static_assert(FloatPacking::kVertexSize == 48);
+	static_assert(FloatPacking::kOffsets == std::array<uint32_t, 4>{ 0, 12, 24, 40 });
+	static_assert(FloatPacking::kIsLossless);
+
+	static_assert(QuantizedPacking::kVertexSize == 20);
+	static_assert(QuantizedPacking::kOffsets == std::array<uint32_t, 4>{ 0, 8, 12, 16 });
+	static_assert(!QuantizedPacking::kIsLossless);
+}
+
+TEST(VertexPacking, FloatLayoutIsACopy)
+{
+	Vertex vertex = MakeVertex(-1.0f);
+	float packed[12];
+	FloatPacking::Convert(&vertex, 1, packed);
+
+	const float expected[12] = { 0.25f, -0.5f, 0.75f,  0.0f, 0.6f, 0.8f,  1.0f, 0.0f, 0.0f, -1.0f,  0.125f, 0.875f };
+	EXPECT_EQ(memcmp(packed, expected, sizeof(expected)), 0);
+
+	Vertex read = {};
+	FloatPacking::Read(packed, read);
+	EXPECT_EQ(memcmp(&read, &vertex, sizeof(vertex)), 0);
+}
+
+TEST(VertexPacking, QuantizedBytes)
+{
+	Vertex vertex = MakeVertex(-1.0f);
+	uint8_t packed[20];
+	QuantizedPacking::Convert(&vertex, 1, packed);
+
+	int16_t position[4];
+	memcpy(position, packed, sizeof(position));
+	EXPECT_EQ(position[0], FloatToSNorm16(0.25f));
+	EXPECT_EQ(position[1], FloatToSNorm16(-0.5f));
+	EXPECT_EQ(position[2], FloatToSNorm16(0.75f));
+	EXPECT_EQ(position[3], -32767);
+
+	int16_t normal[2], tangent[2];
+	EncodeOctahedral(&vertex.normal.x, normal);
+	EncodeOctahedral(&vertex.tangent.x, tangent);
+	EXPECT_EQ(memcmp(packed + 8, normal, sizeof(normal)), 0);
+	EXPECT_EQ(memcmp(packed + 12, tangent, sizeof(tangent)), 0);
+
+	uint16_t uv[2];
+	memcpy(uv, packed + 16, sizeof(uv));
+	EXPECT_EQ(uv[0], FloatToUNorm16(0.125f));
+	EXPECT_EQ(uv[1], FloatToUNorm16(0.875f));
+}
+
+TEST(VertexPacking, QuantizedRoundTrip)
+{
+	for (float sign : { -1.0f, 1.0f })
+	{
+		std::vector<Vertex> vertices(3, MakeVertex(sign));
+		std::vector<uint8_t> packed(vertices.size() * QuantizedPacking::kVertexSize);
+		QuantizedPacking::Convert(vertices.data(), vertices.size(), packed.data());
+
+		Vertex read = {};
+		QuantizedPacking::Read(packed.data() + 2 * QuantizedPacking::kVertexSize, read);
+		const Vertex& original = vertices[2];
+		EXPECT_NEAR(read.position.x, original.position.x, 1e-4f);
+		EXPECT_NEAR(read.position.y, original.position.y, 1e-4f);
+		EXPECT_NEAR(read.position.z, original.position.z, 1e-4f);
+		EXPECT_NEAR(read.normal.y, original.normal.y, 1e-3f);
+		EXPECT_NEAR(read.normal.z, original.normal.z, 1e-3f);
+		EXPECT_NEAR(read.tangent.x, original.tangent.x, 1e-3f);
+		EXPECT_EQ(read.tangent.w, sign);
+		EXPECT_NEAR(read.uv.x, original.uv.x, 1e-4f);
+		EXPECT_NEAR(read.uv.y, original.uv.y, 1e-4f);
+	}
+}
+
+TEST(VertexPacking, SemanticIndex)
+{
+	// A second set of UVs on UV1, with the same data as UV0 since the vertex only has one
+	using TwoUVs = VertexPacking<VertexElement<VertexSemantic::Position, VertexFormat::Float3>,
+								 VertexElement<VertexSemantic::UV, VertexFormat::Float2>,
+								 VertexElement<VertexSemantic::UV, VertexFormat::Half2, 1>>;
+	static_assert(!TwoUVs::kHasDuplicateSemantics);
+	static_assert(TwoUVs::kVertexSize == 24);
+	EXPECT_EQ(TwoUVs::GetName(), "POSITION_Float3_UV_Float2_UV1_Half2");
+
+	// POSITION is the name of both position semantics, so these two only differ on the index
+	using TwoPositions = VertexPacking<VertexElement<VertexSemantic::Position, VertexFormat::Float3>,
+									   VertexElement<VertexSemantic::PositionBitangentSign, VertexFormat::Half4, 1>>;
+	static_assert(!TwoPositions::kHasDuplicateSemantics);
+	EXPECT_EQ(TwoPositions::GetName(), "POSITION_Float3_POSITION1_Half4");
+}
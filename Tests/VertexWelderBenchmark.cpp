@@ -0,0 +1,57 @@
+#include "Resource/VertexWelder.h"
+#include "OBJTestData.h"
+#include <benchmark/benchmark.h>
+
+using namespace FrameDX12;
+
+// Welding of a generated grid with 1M corners. Indexed has the attributes shared between corners, like most OBJs, PerCorner has a normal
+//  and texcoord per corner, which only the tolerance pass can merge
+namespace
+{
+	const OBJData& GetGrid(bool per_corner)
+	{
+		static OBJData grids[2];
+		OBJData& grid = grids[per_corner];
+		if (grid.corners.empty())
+		{
+			std::string text = GenerateGridOBJ(410, false);
+			std::string error;
+			ParseOBJ(text.data(), text.size(), grid, error, 1);
+
+			if (per_corner)
+			{
+				std::vector<float> normals, texcoords;
+				for (uint32_t idx = 0; idx < grid.corners.size(); idx++)
+				{
+					OBJData::Corner& corner = grid.corners[idx];
+					normals.insert(normals.end(), grid.normals.begin() + 3 * corner.normal, grid.normals.begin() + 3 * corner.normal + 3);
+					texcoords.insert(texcoords.end(), grid.texcoords.begin() + 2 * corner.texcoord, grid.texcoords.begin() + 2 * corner.texcoord + 2);
+					corner.normal = idx;
+					corner.texcoord = idx;
+				}
+				grid.normals = std::move(normals);
+				grid.texcoords = std::move(texcoords);
+			}
+		}
+		return grid;
+	}
+
+	void BM_WeldOBJ(benchmark::State& state)
+	{
+		const OBJData& grid = GetGrid(state.range(0) != 0);
+		float tolerance = state.range(1) ? 1e-5f : 0.0f;
+
+		std::vector<OBJData::Corner> vertices;
+		std::vector<uint32_t> indices;
+		for (auto _ : state)
+		{
+			WeldOBJ(grid, vertices, indices, tolerance);
+			benchmark::DoNotOptimize(indices.data());
+		}
+		state.counters["vertices"] = vertices.size();
+		state.SetItemsProcessed(state.iterations() * grid.corners.size());
+	}
+}
+
+// Per corner attributes, tolerance on
+BENCHMARK(BM_WeldOBJ)->ArgNames({ "per_corner", "tolerance" })->Args({ 0, 0 })->Args({ 0, 1 })->Args({ 1, 0 })->Args({ 1, 1 })->Unit(benchmark::kMillisecond);
@@ -0,0 +1,105 @@
+#include "Resource/VertexWelder.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+
+using namespace FrameDX12;
+
+namespace
+{
+	constexpr uint32_t kMissing = OBJData::kMissing;
+
+	// A quad as 2 triangles, each corner with its own normal and texcoord, as some exporters write them
+	OBJData PerCornerQuad(float jitter)
+	{
+		OBJData obj;
+		obj.positions = { 0, 0, 0,  1, 0, 0,  1, 1, 0,  0, 1, 0 };
+		const uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+		for (uint32_t corner = 0; corner < 6; corner++)
+		{
+			uint32_t position = quad[corner];
+			float offset = corner % 2 ? jitter : 0.0f;
+			obj.normals.insert(obj.normals.end(), { offset, 0, 1 });
+			obj.texcoords.insert(obj.texcoords.end(), { obj.positions[3 * position] + offset, obj.positions[3 * position + 1] });
+			obj.corners.push_back({ position, corner, corner });
+		}
+		return obj;
+	}
+}
+
+TEST(VertexWelder, WeldsSameIndexTriplets)
+{
+	OBJData obj;
+	obj.positions = { 0, 0, 0,  1, 0, 0,  1, 1, 0,  0, 1, 0 };
+	obj.normals = { 0, 0, 1 };
+	obj.corners = { { 0, 0, kMissing }, { 1, 0, kMissing }, { 2, 0, kMissing }, { 0, 0, kMissing }, { 2, 0, kMissing }, { 3, kMissing, kMissing } };
+
+	std::vector<OBJData::Corner> vertices;
+	std::vector<uint32_t> indices;
+	WeldOBJ(obj, vertices, indices);
+
+	EXPECT_EQ(vertices.size(), 4u);
+	EXPECT_EQ(indices, (std::vector<uint32_t>{ 0, 1, 2, 0, 2, 3 }));
+	EXPECT_EQ(vertices[3].normal, kMissing);
+}
+
+TEST(VertexWelder, WithoutToleranceKeepsDifferentIndices)
+{
+	OBJData obj = PerCornerQuad(0.0f);
+
+	std::vector<OBJData::Corner> vertices;
+	std::vector<uint32_t> indices;
+	WeldOBJ(obj, vertices, indices);
+	EXPECT_EQ(vertices.size(), 6u);
+}
+
+TEST(VertexWelder, ToleranceMergesEveryAttribute)
+{
+	OBJData obj = PerCornerQuad(1e-5f);
+	obj.positions[3] += 1e-5f; // Position 1 a bit off, and repeated as 4
+	obj.positions.insert(obj.positions.end(), { 1, 0, 0 });
+	obj.corners[1].position = 4;
+
+	std::vector<OBJData::Corner> vertices;
+	std::vector<uint32_t> indices;
+	WeldOBJ(obj, vertices, indices, 1e-4f);
+
+	ASSERT_EQ(vertices.size(), 4u);
+	EXPECT_EQ(indices, (std::vector<uint32_t>{ 0, 1, 2, 0, 2, 3 }));
+	for (const OBJData::Corner& vertex : vertices)
+		EXPECT_EQ(vertex.normal, 0u);
+}
+
+TEST(VertexWelder, ToleranceKeepsValuesFurtherApart)
+{
+	OBJData obj = PerCornerQuad(0.01f);
+
+	std::vector<OBJData::Corner> vertices;
+	std::vector<uint32_t> indices;
+	WeldOBJ(obj, vertices, indices, 1e-4f);
+
+	// Corners 2 and 4 merge. 0 and 3 share the position, but 3 has the offset normal and texcoord
+	EXPECT_EQ(vertices.size(), 5u);
+	EXPECT_EQ(indices[2], indices[4]);
+	EXPECT_NE(indices[0], indices[3]);
+}
+
+TEST(VertexWelder, HugeAndInvalidValuesDontOverflowTheCells)
+{
+	// Values way past the int32 range once divided by the tolerance, and NaN, on both the SSE and the scalar paths
+	float huge = 1e30f;
+	float nan = std::numeric_limits<float>::quiet_NaN();
+	OBJData obj;
+	obj.positions = { huge, -huge, huge,  huge, -huge, huge,  -huge, huge, 0,  nan, 0, 0,  huge, 0, 0 };
+	obj.corners = { { 0, kMissing, kMissing }, { 1, kMissing, kMissing }, { 2, kMissing, kMissing },
+					{ 3, kMissing, kMissing }, { 4, kMissing, kMissing }, { 3, kMissing, kMissing } };
+
+	std::vector<OBJData::Corner> vertices;
+	std::vector<uint32_t> indices;
+	WeldOBJ(obj, vertices, indices, 1e-6f);
+
+	// The same huge position merges, NaN never matches anything but its own index
+	EXPECT_EQ(indices[0], indices[1]);
+	EXPECT_EQ(indices[3], indices[5]);
+	EXPECT_EQ(vertices.size(), 4u);
+}